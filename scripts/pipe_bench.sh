@@ -0,0 +1,120 @@
+#!/bin/bash
+#
+# Throughput of multi-stage command chains through files and pipes
+#
+set -e
+
+SIZE=256
+COILS=8
+STAGES=4
+REPS=3
+
+helpstr=$(cat <<- EOF
+-x size of phantom (default: $SIZE)
+-s number of coils (default: $COILS)
+-n number of FFT stages (default: $STAGES)
+-r repetitions (default: $REPS)
+-h help
+EOF
+)
+
+usage="Usage: $0 [-h] [-x size] [-s coils] [-n stages] [-r reps]"
+
+while getopts "hx:s:n:r:" opt; do
+        case $opt in
+	h)
+		echo "$usage"
+		echo
+		echo "$helpstr"
+		exit 0
+	;;
+	x)
+		SIZE=$OPTARG
+	;;
+	s)
+		COILS=$OPTARG
+	;;
+	n)
+		STAGES=$OPTARG
+	;;
+	r)
+		REPS=$OPTARG
+	;;
+        \?)
+        	echo "$usage" >&2
+		exit 1
+        ;;
+        esac
+done
+
+shift $((OPTIND - 1))
+
+
+if [ ! -e $TOOLBOX_PATH/bart ] ; then
+        echo "\$TOOLBOX_PATH is not set correctly!" >&2
+	exit 1
+fi
+
+export PATH=$TOOLBOX_PATH:$PATH
+
+
+WORKDIR=`mktemp -d 2>/dev/null || mktemp -d -t 'mytmpdir'`
+trap 'rm -rf "$WORKDIR"' EXIT
+cd $WORKDIR
+
+bart phantom -x$SIZE -s$COILS -k ksp
+
+
+# chain of alternating forward and inverse FFTs followed by scale and rss
+
+chain_files()
+{
+	bart copy ksp s0
+
+	for i in $(seq 1 $STAGES) ; do
+		bart fft $([ $((i % 2)) -eq 1 ] && echo -i) -u 3 s$((i - 1)) s$i
+	done
+
+	bart scale 2. s$STAGES t
+	bart rss 8 t out_files
+}
+
+chain_pipes()
+{
+	cmd="bart copy ksp -"
+
+	for i in $(seq 1 $STAGES) ; do
+		cmd="$cmd | bart fft $([ $((i % 2)) -eq 1 ] && echo -i) -u 3 - -"
+	done
+
+	eval "$cmd | bart scale 2. - - | bart rss 8 - out_pipes"
+}
+
+run()
+{
+	local best=
+
+	for r in $(seq 1 $REPS) ; do
+
+		start=$(date +%s.%N)
+		$1
+		end=$(date +%s.%N)
+
+		best=$(echo "$start $end $best" | awk '{ t = $2 - $1; if ($3 != "" && $3 < t) t = $3; print t }')
+	done
+
+	echo $best
+}
+
+
+MB=$(echo "$SIZE $COILS" | awk '{ print $1 * $1 * $2 * 8 / 1048576. }')
+NUM=$((STAGES + 3))
+
+echo "Array: ${SIZE}x${SIZE}x${COILS} (${MB} MB), ${NUM} stages"
+
+tf=$(run chain_files)
+tp=$(run chain_pipes)
+
+bart nrmse -t 0. out_files out_pipes > /dev/null
+
+echo "$tf $tp $MB $NUM" | awk '{ printf("files: %8.3f s %10.1f MB/s\npipes: %8.3f s %10.1f MB/s\n", $1, $3 * $4 / $1, $2, $3 * $4 / $2) }'
@@ -15,19 +15,32 @@
 #include <libgen.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdbool.h>
+#include <complex.h>
+#include <signal.h>
+#include <fcntl.h>
 
 #ifdef _WIN32
 #include "win/fmemopen.h"
 #include "win/basename_patch.h"
+#else
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
 #endif
 
 #include "misc/io.h"
+#include "misc/mmio.h"
 #include "misc/misc.h"
 #include "misc/opts.h"
 #include "misc/version.h"
 #include "misc/debug.h"
 #include "misc/cppmap.h"
 
+#include "num/mem.h"
+
+#include "noncart/nufft.h"
+
 #ifdef USE_CUDA
 #include "num/gpuops.h"
 #endif
@@ -47,7 +60,7 @@
 extern FILE* bart_output;	// src/misc.c
 
 
-static void bart_exit_cleanup(void)
+static void bart_command_cleanup(void)
 {
 	if (NULL != command_line)
 		XFREE(command_line);
@@ -56,6 +69,19 @@ static void bart_exit_cleanup(void)
 
 	opt_free_strdup();
 
+	// do not keep the memory of one request for the next
+
+	memcache_cpu_clear();
+}
+
+
+static void bart_exit_cleanup(void)
+{
+	debug_print_memcache_cpu(DP_DEBUG1);
+
+	bart_command_cleanup();
+	nufft_cache_clear();
+
 #ifdef FFTWTHREADS
 	MANGLE(fftwf_cleanup_threads)();
 #endif
@@ -92,8 +118,18 @@ static void usage(void)
 	}
 
 	printf("\n");
+#ifndef _WIN32
+	printf("\nServer mode: bart --server <socket>\n");
+	printf("             bart --client <socket> <command> ...\n");
+#endif
 }
 
+
+#ifndef _WIN32
+static int bart_server(const char* path);
+static int bart_client(const char* path, int argc, char* argv[argc]);
+#endif
+
 int main_bart(int argc, char* argv[argc])
 {
 	char* bn = basename(argv[0]);
@@ -106,6 +142,14 @@ int main_bart(int argc, char* argv[argc])
 			return 1;
 		}
 
+#ifndef _WIN32
+		if ((3 == argc) && (0 == strcmp(argv[1], "--server")))
+			return bart_server(argv[2]);
+
+		if ((4 <= argc) && (0 == strcmp(argv[1], "--client")))
+			return bart_client(argv[2], argc - 3, argv + 3);
+#endif
+
 		const char* tpath[] = {
 #ifdef TOOLBOX_PATH_OVERRIDE
 			getenv("TOOLBOX_PATH"),
@@ -168,7 +212,7 @@ int main_bart(int argc, char* argv[argc])
 
 
 
-int bart_command(int len, char* buf, int argc, char* argv[])
+static int bart_command_internal(int len, char* buf, int argc, char* argv[], bool warm)
 {
 	int save = debug_level;
 
@@ -180,7 +224,14 @@ int bart_command(int len, char* buf, int argc, char* argv[])
 
 	int ret = error_catcher(main_bart, argc, argv);
 
-	bart_exit_cleanup();
+	pipe_cleanup(0 != ret);
+
+	// in server mode, FFTW and GPU state is kept for the next command
+
+	if (warm)
+		bart_command_cleanup();
+	else
+		bart_exit_cleanup();
 
 	debug_level = save;
 
@@ -200,3 +251,419 @@ int bart_command(int len, char* buf, int argc, char* argv[])
 
 
 
+
+
+int bart_command(int len, char* buf, int argc, char* argv[])
+{
+	return bart_command_internal(len, buf, argc, argv, false);
+}
+
+
+
+#ifndef _WIN32
+/*
+ * Server mode
+ *
+ * The server executes command lines received over a local socket
+ * in one long-running process. Kaiser-Bessel tables, FFTW plans
+ * and wisdom, and GPU memory are kept warm between requests, and
+ * in-memory files (*.mem) can be used to pass data from one request
+ * to the next without touching the disk.
+ *
+ * A request consists of the working directory of the client and the
+ * arguments, each terminated by '\0'. The reply is the return value
+ * in the first line followed by the output of the command.
+ *
+ * Commands run with the permissions of the server in the directory
+ * given by the client, which has to be an absolute path. The socket
+ * is therefore only accessible to the user running the server.
+ * Failing requests are reported to the client and do not stop
+ * the server.
+ */
+
+static int send_all(int fd, const char* buf, size_t len)
+{
+	while (len > 0) {
+
+		ssize_t r = send(fd, buf, len, 0);
+
+		if (-1 == r) {
+
+			if (EINTR == errno)
+				continue;
+
+			return -1;
+		}
+
+		buf += r;
+		len -= r;
+	}
+
+	return 0;
+}
+
+
+static char* recv_all(int fd, size_t* len)
+{
+	size_t max = 4096;
+	char* buf = xmalloc(max + 1);
+
+	*len = 0;
+
+	while (true) {
+
+		if (*len == max) {
+
+			max *= 2;
+			buf = realloc(buf, max + 1);
+
+			if (NULL == buf)
+				error("memory out\n");
+		}
+
+		ssize_t r = recv(fd, buf + *len, max - *len, 0);
+
+		if (-1 == r) {
+
+			if (EINTR == errno)
+				continue;
+
+			xfree(buf);
+			return NULL;
+		}
+
+		if (0 == r)
+			break;
+
+		*len += r;
+	}
+
+	buf[*len] = '\0';
+
+	return buf;
+}
+
+
+static int socket_address(struct sockaddr_un* addr, const char* path)
+{
+	memset(addr, 0, sizeof *addr);
+	addr->sun_family = AF_UNIX;
+
+	if (strlen(path) >= sizeof(addr->sun_path))
+		error("server: socket path too long: %s\n", path);
+
+	strcpy(addr->sun_path, path);
+
+	int fd;
+
+	if (-1 == (fd = socket(AF_UNIX, SOCK_STREAM, 0)))
+		error("server: creating socket failed: %s\n", strerror(errno));
+
+	return fd;
+}
+
+
+
+struct server_stats_s {
+
+	int N;
+	int max;
+	double* latency;
+
+	int C;
+	struct {
+
+		char name[32];
+		long n;
+		double sum;
+		double min;
+		double max;
+
+	} cmd[64];
+};
+
+
+static void server_stats_add(struct server_stats_s* st, const char* name, double t)
+{
+	if (st->N == st->max) {
+
+		st->max = MAX(1024, 2 * st->max);
+		st->latency = realloc(st->latency, (size_t)st->max * sizeof(double));
+
+		if (NULL == st->latency)
+			error("memory out\n");
+	}
+
+	st->latency[st->N++] = t;
+
+	int i = 0;
+
+	while ((i < st->C) && (0 != strncmp(st->cmd[i].name, name, sizeof(st->cmd[i].name) - 1)))
+		i++;
+
+	if (i == st->C) {
+
+		if (i == (int)ARRAY_SIZE(st->cmd))
+			return;
+
+		snprintf(st->cmd[i].name, sizeof(st->cmd[i].name), "%s", name);
+		st->cmd[i].n = 0;
+		st->cmd[i].sum = 0.;
+		st->cmd[i].min = t;
+		st->cmd[i].max = t;
+		st->C++;
+	}
+
+	st->cmd[i].n++;
+	st->cmd[i].sum += t;
+	st->cmd[i].min = MIN(st->cmd[i].min, t);
+	st->cmd[i].max = MAX(st->cmd[i].max, t);
+}
+
+
+static int cmp_double(const void* a, const void* b)
+{
+	double x = *(const double*)a;
+	double y = *(const double*)b;
+
+	return (x > y) - (x < y);
+}
+
+
+static void server_stats_print(const struct server_stats_s* st, int len, char buf[len])
+{
+	int pos = snprintf(buf, len, "Requests: %d\n", st->N);
+
+	if (0 == st->N)
+		return;
+
+	double sorted[st->N];
+	memcpy(sorted, st->latency, (size_t)st->N * sizeof(double));
+	qsort(sorted, (size_t)st->N, sizeof(double), cmp_double);
+
+	double sum = 0.;
+
+	for (int i = 0; i < st->N; i++)
+		sum += sorted[i];
+
+#define PCT(p) (1.E3 * sorted[MIN(st->N - 1, (int)((p) * st->N))])
+
+	pos += snprintf(buf + pos, MAX(0, len - pos), "Latency [ms]: mean %.2f min %.2f p50 %.2f p90 %.2f p99 %.2f max %.2f\n",
+			1.E3 * sum / st->N, 1.E3 * sorted[0], PCT(0.5), PCT(0.9), PCT(0.99), 1.E3 * sorted[st->N - 1]);
+#undef PCT
+
+	pos += snprintf(buf + pos, MAX(0, len - pos), "%-16s %8s %10s %10s %10s\n", "command", "n", "mean", "min", "max");
+
+	for (int i = 0; i < st->C; i++)
+		pos += snprintf(buf + pos, MAX(0, len - pos), "%-16s %8ld %10.2f %10.2f %10.2f\n", st->cmd[i].name,
+			st->cmd[i].n, 1.E3 * st->cmd[i].sum / st->cmd[i].n, 1.E3 * st->cmd[i].min, 1.E3 * st->cmd[i].max);
+}
+
+
+
+static int bart_server(const char* path)
+{
+	struct sockaddr_un addr;
+	int sfd = socket_address(&addr, path);
+
+	unlink(path);
+
+	if (-1 == bind(sfd, (struct sockaddr*)&addr, sizeof addr))
+		error("server: binding to %s failed: %s\n", path, strerror(errno));
+
+	if (-1 == chmod(path, S_IRUSR | S_IWUSR))
+		error("server: %s: %s\n", path, strerror(errno));
+
+	if (-1 == listen(sfd, 16))
+		error("server: listening on %s failed: %s\n", path, strerror(errno));
+
+	// requests are executed in the working directory of the client
+
+	int wd;
+
+	if (-1 == (wd = open(".", O_RDONLY)))
+		error("server: %s\n", strerror(errno));
+
+	signal(SIGPIPE, SIG_IGN);
+
+	debug_printf(DP_INFO, "Server listening on %s\n", path);
+
+	struct server_stats_s stats = { 0 };
+	enum { OUTPUT_SIZE = 1 << 16 };
+	char* output = xmalloc(OUTPUT_SIZE);
+
+	nufft_cache_keep();
+
+	bool quit = false;
+
+	while (!quit) {
+
+		int cfd;
+
+		if (-1 == (cfd = accept(sfd, NULL, NULL))) {
+
+			if (EINTR != errno)
+				debug_printf(DP_WARN, "server: accept failed: %s\n", strerror(errno));
+
+			continue;
+		}
+
+		size_t len;
+		char* req = recv_all(cfd, &len);
+
+		if (NULL == req) {
+
+			debug_printf(DP_WARN, "server: receiving request failed: %s\n", strerror(errno));
+			close(cfd);
+			continue;
+		}
+
+		// output of commands is collected in a buffer that grows as needed
+
+		char* cmd_output = NULL;
+		size_t cmd_output_size = 0;
+
+		int argc = -1;
+
+		for (size_t i = 0; i < len; i++)
+			if ('\0' == req[i])
+				argc++;
+
+		char* argv[MAX(argc, 0) + 1];
+
+		char* p = req + strlen(req) + 1;
+
+		for (int i = 0; i < argc; i++) {
+
+			argv[i] = p;
+			p += strlen(p) + 1;
+		}
+
+		argv[MAX(argc, 0)] = NULL;
+
+		int ret = -1;
+		output[0] = '\0';
+
+		if ((0 >= argc) || ('\0' != req[len - 1])) {
+
+			debug_printf(DP_WARN, "server: invalid request\n");
+
+		} else if (0 == strcmp(argv[0], "--stats")) {
+
+			server_stats_print(&stats, OUTPUT_SIZE, output);
+			ret = 0;
+
+		} else if (0 == strcmp(argv[0], "--quit")) {
+
+			quit = true;
+			ret = 0;
+
+		} else if (('/' != req[0]) || (-1 == chdir(req))) {
+
+			snprintf(output, OUTPUT_SIZE, "server: cannot change to directory %s\n", req);
+			debug_printf(DP_WARN, "%s", output);
+
+		} else if (NULL == (bart_output = open_memstream(&cmd_output, &cmd_output_size))) {
+
+			snprintf(output, OUTPUT_SIZE, "server: %s\n", strerror(errno));
+			debug_printf(DP_WARN, "%s", output);
+
+			if (-1 == fchdir(wd))
+				error("server: %s\n", strerror(errno));
+
+		} else {
+
+			double start = timestamp();
+
+			ret = bart_command_internal(0, NULL, argc, argv, true);
+
+			double t = timestamp() - start;
+
+			server_stats_add(&stats, argv[0], t);
+
+			debug_printf(DP_INFO, "server: %s: %.2f ms (%d)\n", argv[0], 1.E3 * t, ret);
+
+			if (-1 == fchdir(wd))
+				error("server: %s\n", strerror(errno));
+		}
+
+		char head[32];
+		snprintf(head, sizeof head, "%d\n", ret);
+
+		const char* reply = (NULL != cmd_output) ? cmd_output : output;
+
+		if ((-1 == send_all(cfd, head, strlen(head))) || (-1 == send_all(cfd, reply, strlen(reply))))
+			debug_printf(DP_WARN, "server: sending reply failed: %s\n", strerror(errno));
+
+		close(cfd);
+		xfree(req);
+		free(cmd_output);
+	}
+
+	server_stats_print(&stats, OUTPUT_SIZE, output);
+	debug_printf(DP_INFO, "%s", output);
+
+	xfree(output);
+	xfree(stats.latency);
+
+	close(wd);
+	close(sfd);
+	unlink(path);
+
+	bart_exit_cleanup();
+
+	return 0;
+}
+
+
+static int bart_client(const char* path, int argc, char* argv[argc])
+{
+	struct sockaddr_un addr;
+	int fd = socket_address(&addr, path);
+
+	// wait for the server to come up
+
+	for (int i = 0; -1 == connect(fd, (struct sockaddr*)&addr, sizeof addr); i++) {
+
+		if ((100 == i) || ((ENOENT != errno) && (ECONNREFUSED != errno)))
+			error("client: connecting to %s failed: %s\n", path, strerror(errno));
+
+		usleep(50000);
+	}
+
+	char cwd[4096];
+
+	if (NULL == getcwd(cwd, sizeof cwd))
+		error("client: %s\n", strerror(errno));
+
+	bool ok = (0 == send_all(fd, cwd, strlen(cwd) + 1));
+
+	for (int i = 0; i < argc; i++)
+		ok = ok && (0 == send_all(fd, argv[i], strlen(argv[i]) + 1));
+
+	if (!ok)
+		error("client: sending failed: %s\n", strerror(errno));
+
+	shutdown(fd, SHUT_WR);
+
+	size_t len;
+	char* rep = recv_all(fd, &len);
+
+	if (NULL == rep)
+		error("client: receiving failed: %s\n", strerror(errno));
+
+	close(fd);
+
+	int ret = -1;
+	int pos = 0;
+
+	if (1 != sscanf(rep, "%d\n%n", &ret, &pos))
+		error("client: invalid reply\n");
+
+	fputs(rep + pos, stdout);
+
+	xfree(rep);
+
+	return ret;
+}
+#endif
@@ -21,6 +21,8 @@
 #include "num/ops_p.h"
 #include "num/mdfft.h"
 #include "num/fft.h"
+#include "num/mem.h"
+#include "num/numa.h"
 
 #include "wavelet/wavthresh.h"
 
@@ -507,6 +509,21 @@ static double bench_fft(long scale)
 
 
 
+static double bench_small_fft(long scale)
+{
+	long dims[DIMS] = { 1, 8, 8, 1, 1, 256 * scale, 1, 32 };
+	return bench_generic_fft(dims, 6ul);
+}
+
+
+static double bench_small_fft_strided(long scale)
+{
+	long dims[DIMS] = { 6, 16, 5, 16, 1, 32 * scale, 1, 8 };
+	return bench_generic_fft(dims, 10ul);
+}
+
+
+
 
 static double bench_generic_fftmod(long dims[DIMS], unsigned long flags)
 {
@@ -576,6 +593,47 @@ static double bench_zsmul(long scale)
 }
 
 
+static double bench_generic_stream(long scale, bool numa)
+{
+	bool old = numa_policy;
+	numa_policy = numa;
+
+	// new arrays are placed by first touch
+	memcache_cpu_clear();
+
+	long dims[DIMS] = { 128, 128, 1, 1, 256 * scale, 1, 1, 1 };
+
+	complex float* x = md_alloc(DIMS, dims, CFL_SIZE);
+	complex float* y = md_alloc(DIMS, dims, CFL_SIZE);
+
+	md_clear(DIMS, dims, x, CFL_SIZE);
+	md_clear(DIMS, dims, y, CFL_SIZE);
+
+	double tic = timestamp();
+
+	for (int i = 0; i < 10; i++)
+		md_zaxpy(DIMS, dims, y, 0.5, x);
+
+	double toc = timestamp();
+
+	md_free(x);
+	md_free(y);
+
+	numa_policy = old;
+
+	return toc - tic;
+}
+
+static double bench_stream_numa(long scale)
+{
+	return bench_generic_stream(scale, true);
+}
+
+static double bench_stream(long scale)
+{
+	return bench_generic_stream(scale, false);
+}
+
 
 
 enum bench_indices { REPETITION_IND, SCALE_IND, THREADS_IND, TESTS_IND, BENCH_DIMS };
@@ -641,7 +699,11 @@ const struct benchmark_s {
 	{ bench_wavelet,	"wavelet soft thresh" },
 	{ bench_mdfft,		"(MD-)FFT" },
 	{ bench_fft,		"FFT" },
+	{ bench_small_fft,	"small FFTs" },
+	{ bench_small_fft_strided, "small FFTs, strided" },
 	{ bench_fftmod,		"fftmod" },
+	{ bench_stream,		"stream (md_zaxpy)" },
+	{ bench_stream_numa,	"stream (md_zaxpy), NUMA" },
 };
 
 
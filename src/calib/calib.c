@@ -32,6 +32,7 @@
 #include "num/flpmath.h"
 #include "num/linalg.h"
 #include "num/lapack.h"
+#include "num/eig-batch.h"
 #include "num/casorati.h"
 #include "num/rand.h"
 
@@ -82,6 +83,21 @@ static void eigen_herm3(int M, int N, float val[M], complex float matrix[N][N],
 
 
 
+/*
+ * Orthogonal iteration started from the eigenvectors of a neighboring
+ * point, which are passed in and returned in vecs.
+ */
+static void eigen_herm3_warm(int M, int N, float val[M], complex float vecs[M][N], complex float matrix[N][N], int num_orthiter)
+{
+	for (int li = 0; li < N; li++)
+		for (int lj = 0; lj < li; lj++)
+			matrix[lj][li] = conj(matrix[li][lj]);
+
+	orthiter_noinit(M, N, num_orthiter, val, vecs, matrix);
+}
+
+
+
 static void md_scurve(int N, const long dims[N], float* dst, const float* src)
 {
 	float* tmp1 = md_alloc_sameplace(N, dims, FL_SIZE, src);
@@ -417,10 +433,133 @@ void calone(const struct ecalib_conf* conf, const long cov_dims[4], complex floa
 
 
 
+/*
+ * Full eigen decomposition for all points with the batched solver.
+ * Points are processed in chunks to limit the memory for the
+ * unpacked covariance matrices.
+ */
+static void eigenmaps_batch(const long out_dims[DIMS], complex float* optr, complex float* eptr, const complex float* imgcov2, const bool* msk)
+{
+	long channels = out_dims[3];
+	long maps = out_dims[4];
+
+	long size = md_calc_size(3, out_dims);
+
+	enum { CHUNK = 4096 };
+
+	long (*pts)[CHUNK] = TYPE_ALLOC(long[CHUNK]);
+	float (*val)[CHUNK][channels] = TYPE_ALLOC(float[CHUNK][channels]);
+	complex float (*cov)[CHUNK][channels][channels] = TYPE_ALLOC(complex float[CHUNK][channels][channels]);
+
+	for (long p0 = 0; p0 < size; ) {
+
+		long n = 0;
+
+		for (; (p0 < size) && (n < CHUNK); p0++)
+			if (!msk || msk[p0])
+				(*pts)[n++] = p0;
+
+#pragma omp parallel for
+		for (long b = 0; b < n; b++) {
+
+			complex float tmp[channels * (channels + 1) / 2];
+
+			for (long l = 0; l < channels * (channels + 1) / 2; l++)
+				tmp[l] = imgcov2[l * size + (*pts)[b]];
+
+			unpack_tri_matrix(channels, (*cov)[b], tmp);
+		}
+
+		batch_eig(channels, n, *val, *cov);
+
+#pragma omp parallel for
+		for (long b = 0; b < n; b++) {
+
+			for (long u = 0; u < maps; u++) {
+
+				long ru = channels - 1 - u;
+
+				for (long v = 0; v < channels; v++)
+					optr[(u * channels + v) * size + (*pts)[b]] = (*cov)[b][ru][v];
+
+				if (NULL != eptr)
+					eptr[u * size + (*pts)[b]] = (*val)[b][ru];
+			}
+		}
+	}
+
+	xfree(pts);
+	xfree(val);
+	xfree(cov);
+}
+
+
+
+/*
+ * Orthogonal iteration along lines in the first dimension. Only the
+ * first point of each line starts from scratch, all other points
+ * start from the result of the previous point, which is already
+ * close, and use only warm_orthiter iterations.
+ */
+static void eigenmaps_warm(const long out_dims[DIMS], complex float* optr, complex float* eptr, const complex float* imgcov2, const bool* msk, int num_orthiter, int warm_orthiter)
+{
+	long channels = out_dims[3];
+	long maps = out_dims[4];
+
+	long xx = out_dims[0];
+	long yy = out_dims[1];
+	long zz = out_dims[2];
+
+#pragma omp parallel for collapse(2)
+	for (long k = 0; k < zz; k++) {
+		for (long j = 0; j < yy; j++) {
+
+			bool warm = false;
+			complex float vecs[maps][channels];
+
+			for (long i = 0; i < xx; i++) {
+
+				if (msk && !msk[i + xx * (j + yy * k)])
+					continue;
+
+				float val[maps];
+				complex float cov[channels][channels];
+
+				complex float tmp[channels * (channels + 1) / 2];
+
+				for (long l = 0; l < channels * (channels + 1) / 2; l++)
+					tmp[l] = imgcov2[((l * zz + k) * yy + j) * xx + i];
+
+				unpack_tri_matrix(channels, cov, tmp);
+
+				if (!warm)
+					mat_identity(maps, channels, vecs);
+
+				eigen_herm3_warm(maps, channels, val, vecs, cov, warm ? warm_orthiter : num_orthiter);
+
+				warm = true;
+
+				for (long u = 0; u < maps; u++) {
+
+					long ru = maps - 1 - u;
+
+					for (long v = 0; v < channels; v++)
+						optr[((((u * channels + v) * zz + k) * yy + j) * xx + i)] = vecs[ru][v];
+
+					if (NULL != eptr)
+						eptr[((u * zz + k) * yy + j) * xx + i] = val[ru];
+				}
+			}
+		}
+	}
+}
+
+
+
 /* calculate point-wise maps 
  *
  */
-void eigenmaps(const long out_dims[DIMS], complex float* optr, complex float* eptr, const complex float* imgcov2, const long msk_dims[3], const bool* msk, bool orthiter, int num_orthiter, bool ecal_usegpu)
+void eigenmaps(const long out_dims[DIMS], complex float* optr, complex float* eptr, const complex float* imgcov2, const long msk_dims[3], const bool* msk, bool orthiter, int num_orthiter, int warm_orthiter, bool ecal_usegpu)
 {
 #ifdef USE_CUDA
 	if (ecal_usegpu) {
@@ -456,6 +595,18 @@ void eigenmaps(const long out_dims[DIMS], complex float* optr, complex float* ep
 
 	md_clear(5, out_dims, optr, CFL_SIZE);
 
+	if (!orthiter && (channels <= EIG_BATCH_MAX)) {
+
+		eigenmaps_batch(out_dims, optr, eptr, imgcov2, msk);
+		return;
+	}
+
+	if (orthiter && (warm_orthiter > 0)) {
+
+		eigenmaps_warm(out_dims, optr, eptr, imgcov2, msk, num_orthiter, warm_orthiter);
+		return;
+	}
+
 #pragma omp parallel for collapse(3)
 	for (long k = 0; k < zz; k++) {
 		for (long j = 0; j < yy; j++) {
@@ -502,6 +653,255 @@ void eigenmaps(const long out_dims[DIMS], complex float* optr, complex float* ep
 
 
 
+static void caltwo_grid(const struct ecalib_conf* conf, const long out_dims[DIMS], complex float* out_data, complex float* emaps, const long cov_dims[4], const complex float* in_data, const long msk_dims[3], const bool* msk)
+{
+	long covbig_dims[4] = { out_dims[0], out_dims[1], out_dims[2], cov_dims[3] };
+
+	complex float* imgcov2 = md_alloc(4, covbig_dims, CFL_SIZE);
+
+	debug_printf(DP_DEBUG1, "Resize...\n");
+
+	sinc_zeropad(4, covbig_dims, imgcov2, cov_dims, in_data);
+
+	debug_printf(DP_DEBUG1, "Point-wise eigen-decomposition...\n");
+
+	eigenmaps(out_dims, out_data, emaps, imgcov2, msk_dims, msk, conf->orthiter, conf->num_orthiter, conf->warm_orthiter, conf->usegpu);
+
+	md_free(imgcov2);
+}
+
+
+
+/*
+ * Periodic linear interpolation along dimension d, where the center
+ * of both grids (index n / 2) is at the same position, as for the
+ * centered FFT used by sinc_zeropad().
+ */
+static void interp_linear_dim(int D, const long odims[D], complex float* out, const long idims[D], const complex float* in, int d)
+{
+	long inner = md_calc_size(d, idims);
+	long outer = md_calc_size(D - d - 1, idims + d + 1);
+
+	long ni = idims[d];
+	long no = odims[d];
+
+#pragma omp parallel for collapse(2)
+	for (long o = 0; o < outer; o++) {
+		for (long x = 0; x < no; x++) {
+
+			double t = (double)(x - no / 2) * (double)ni / (double)no + (double)(ni / 2);
+			long i0 = (long)floor(t);
+			float w = t - (double)i0;
+
+			i0 = ((i0 % ni) + ni) % ni;
+			long i1 = (i0 + 1) % ni;
+
+			const complex float* a = in + (o * ni + i0) * inner;
+			const complex float* b = in + (o * ni + i1) * inner;
+			complex float* c = out + (o * no + x) * inner;
+
+			for (long l = 0; l < inner; l++)
+				c[l] = (1. - w) * a[l] + w * b[l];
+		}
+	}
+}
+
+
+static void interp_linear(int D, const long odims[D], complex float* out, const long idims[D], const complex float* in)
+{
+	long tdims[D];
+	md_copy_dims(D, tdims, idims);
+
+	complex float* tmp = md_alloc(D, idims, CFL_SIZE);
+	md_copy(D, idims, tmp, in, CFL_SIZE);
+
+	for (int d = 0; d < D; d++) {
+
+		if (odims[d] == tdims[d])
+			continue;
+
+		long ndims[D];
+		md_copy_dims(D, ndims, tdims);
+		ndims[d] = odims[d];
+
+		complex float* tmp2 = md_alloc(D, ndims, CFL_SIZE);
+
+		interp_linear_dim(D, ndims, tmp2, tdims, tmp, d);
+
+		md_free(tmp);
+		tmp = tmp2;
+		md_copy_dims(D, tdims, ndims);
+	}
+
+	md_copy(D, odims, out, tmp, CFL_SIZE);
+	md_free(tmp);
+}
+
+
+
+/*
+ * Dominant eigenvector of the covariance averaged over the image.
+ * It is used as phase reference for the maps on the coarse grid.
+ */
+static void maps_phase_reference(long channels, complex float ref[channels], const long cov_dims[4], const complex float* imgcov)
+{
+	long cosize = channels * (channels + 1) / 2;
+	long size = md_calc_size(3, cov_dims);
+
+	complex float tmp[cosize];
+
+	for (long l = 0; l < cosize; l++) {
+
+		tmp[l] = 0.;
+
+		for (long p = 0; p < size; p++)
+			tmp[l] += imgcov[l * size + p];
+	}
+
+	complex float cov[channels][channels];
+	float val[channels];
+
+	unpack_tri_matrix(channels, cov, tmp);
+	lapack_eig(channels, val, cov);
+
+	for (long v = 0; v < channels; v++)
+		ref[v] = cov[channels - 1][v];
+}
+
+
+
+/*
+ * Relative error of maps b against maps a, weighted by the eigenvalues
+ * of a. The error is insensitive to a phase offset at each point.
+ */
+static float maps_error(const long dims[DIMS], const complex float* a, const complex float* b, const complex float* ev)
+{
+	long size = md_calc_size(3, dims);
+	long channels = dims[3];
+	long maps = dims[4];
+
+	double err = 0.;
+	double nrm = 0.;
+
+	for (long u = 0; u < maps; u++) {
+
+		for (long p = 0; p < size; p++) {
+
+			double w = MAX(0., crealf(ev[u * size + p]));
+
+			double na = 0.;
+			double nb = 0.;
+			complex double ip = 0.;
+
+			for (long v = 0; v < channels; v++) {
+
+				complex float x = a[(u * channels + v) * size + p];
+				complex float y = b[(u * channels + v) * size + p];
+
+				na += crealf(x * conjf(x));
+				nb += crealf(y * conjf(y));
+				ip += x * conjf(y);
+			}
+
+			err += w * MAX(0., na + nb - 2. * cabs(ip));
+			nrm += w * na;
+		}
+	}
+
+	return (0. == nrm) ? 0. : sqrt(err / nrm);
+}
+
+
+
+/*
+ * Compute the maps on a grid decimated by conf->coarse and interpolate
+ * them to the full resolution. As the eigenvectors have an arbitrary
+ * phase at each point, the phase is aligned to a common reference
+ * before interpolation, and the interpolated maps are normalized
+ * again.
+ */
+static void caltwo_coarse(const struct ecalib_conf* conf, const long out_dims[DIMS], complex float* out_data, complex float* emaps, const long cov_dims[4], const complex float* in_data)
+{
+	long channels = out_dims[3];
+
+	long co_dims[DIMS];
+	md_copy_dims(DIMS, co_dims, out_dims);
+
+	for (int i = 0; i < 3; i++) {
+
+		if (1 == out_dims[i])
+			continue;
+
+		long n = (out_dims[i] / conf->coarse + 1) & ~1L;
+
+		co_dims[i] = MIN(out_dims[i], MAX(cov_dims[i], n));
+	}
+
+	debug_printf(DP_DEBUG1, "Coarse grid: %ldx%ldx%ld\n", co_dims[0], co_dims[1], co_dims[2]);
+
+	long ev_dims[DIMS];
+	md_select_dims(DIMS, ~COIL_FLAG, ev_dims, out_dims);
+
+	long co_ev_dims[DIMS];
+	md_select_dims(DIMS, ~COIL_FLAG, co_ev_dims, co_dims);
+
+	complex float* co_maps = md_alloc(DIMS, co_dims, CFL_SIZE);
+	complex float* co_ev = md_alloc(DIMS, co_ev_dims, CFL_SIZE);
+
+	caltwo_grid(conf, co_dims, co_maps, co_ev, cov_dims, in_data, NULL, NULL);
+
+	complex float ref[channels];
+	maps_phase_reference(channels, ref, cov_dims, in_data);
+
+	fixphase2(DIMS, co_dims, COIL_DIM, ref, co_maps, co_maps);
+
+	debug_printf(DP_DEBUG1, "Interpolate...\n");
+
+	interp_linear(DIMS, out_dims, out_data, co_dims, co_maps);
+
+	if (NULL != emaps)
+		interp_linear(DIMS, ev_dims, emaps, co_ev_dims, co_ev);
+
+	md_free(co_maps);
+	md_free(co_ev);
+
+	long size = md_calc_size(3, out_dims);
+
+#pragma omp parallel for collapse(2)
+	for (long u = 0; u < out_dims[4]; u++) {
+		for (long p = 0; p < size; p++) {
+
+			float nrm = 0.;
+
+			for (long v = 0; v < channels; v++)
+				nrm += powf(cabsf(out_data[(u * channels + v) * size + p]), 2.);
+
+			if (0. == nrm)
+				continue;
+
+			nrm = 1. / sqrtf(nrm);
+
+			for (long v = 0; v < channels; v++)
+				out_data[(u * channels + v) * size + p] *= nrm;
+		}
+	}
+
+	if (conf->coarse_check) {
+
+		complex float* maps = md_alloc(DIMS, out_dims, CFL_SIZE);
+		complex float* ev = md_alloc(DIMS, ev_dims, CFL_SIZE);
+
+		caltwo_grid(conf, out_dims, maps, ev, cov_dims, in_data, NULL, NULL);
+
+		debug_printf(DP_INFO, "Coarse grid maps: relative error %e\n", maps_error(out_dims, maps, out_data, ev));
+
+		md_free(maps);
+		md_free(ev);
+	}
+}
+
+
+
 void caltwo(const struct ecalib_conf* conf, const long out_dims[DIMS], complex float* out_data, complex float* emaps, const long in_dims[4], complex float* in_data, const long msk_dims[3], const bool* msk)
 {
 	long xx = out_dims[0];
@@ -520,7 +920,6 @@ void caltwo(const struct ecalib_conf* conf, const long out_dims[DIMS], complex f
 	assert(in_dims[3] == cosize);
 
 	long cov_dims[4] = { xh, yh, zh, cosize };
-	long covbig_dims[4] = { xx, yy, zz, cosize };
 
 	assert(((xx == 1) && (xh == 1)) || (xx >= xh));
 	assert(((yy == 1) && (yh == 1)) || (yy >= yh));
@@ -530,17 +929,10 @@ void caltwo(const struct ecalib_conf* conf, const long out_dims[DIMS], complex f
 	assert((1 == yh) || (0 == yh % 2));
 	assert((1 == zh) || (0 == zh % 2));
 
-	complex float* imgcov2 = md_alloc(4, covbig_dims, CFL_SIZE);
-
-	debug_printf(DP_DEBUG1, "Resize...\n");
-
-	sinc_zeropad(4, covbig_dims, imgcov2, cov_dims, in_data);
-
-	debug_printf(DP_DEBUG1, "Point-wise eigen-decomposition...\n");
-
-	eigenmaps(out_dims, out_data, emaps, imgcov2, msk_dims, msk, conf->orthiter, conf->num_orthiter, conf->usegpu);
-
-	md_free(imgcov2);
+	if ((conf->coarse > 1) && (NULL == msk) && !conf->usegpu)
+		caltwo_coarse(conf, out_dims, out_data, emaps, cov_dims, in_data);
+	else
+		caltwo_grid(conf, out_dims, out_data, emaps, cov_dims, in_data, msk_dims, msk);
 }
 
 
@@ -577,6 +969,9 @@ const struct ecalib_conf ecalib_defaults = {
 	.rotphase = true,
 	.var = -1.,
 	.automate = false,
+	.warm_orthiter = 0,
+	.coarse = 1,
+	.coarse_check = false,
 };
 
 
@@ -867,8 +1262,21 @@ void compute_imgcov(const long cov_dims[4], complex float* imgcov, const long ns
 
 	long m2str[5] = { mstr[2], mstr[3], mstr[4], mstr[1], mstr[0] };
 
+	// kernels are zero outside the center
+
+	long kpos[5] = { 0 };
+	long opos[5] = { 0 };
+	long kdims[5];
+	md_copy_dims(5, kdims, imgkern_dims);
+
+	for (int i = 0; i < 3; i++) {
+
+		kdims[i] = MIN(nskerns_dims[i], imgkern_dims[i]);
+		kpos[i] = imgkern_dims[i] / 2 - kdims[i] / 2;
+	}
+
 	ifftmod(5, imgkern_dims, FFT_FLAGS, imgkern1, imgkern1);
-	ifft2(5, imgkern_dims, FFT_FLAGS, m2str, imgkern2, istr, imgkern1);
+	ifft_pruned2(5, imgkern_dims, FFT_FLAGS, kpos, kdims, opos, imgkern_dims, m2str, imgkern2, istr, imgkern1);
 
 	float scalesq = (kx * ky * kz) * (xh * yh * zh); // second part for FFT scaling
 
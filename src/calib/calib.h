@@ -26,6 +26,9 @@ struct ecalib_conf {
 	_Bool rotphase;
 	float var;
 	_Bool automate;
+	int warm_orthiter;
+	long coarse;
+	_Bool coarse_check;
 };
 
 extern const struct ecalib_conf ecalib_defaults;
@@ -35,7 +38,7 @@ extern void calib(const struct ecalib_conf* conf, const long out_dims[DIMS], _Co
 
 extern void calib2(const struct ecalib_conf* conf, const long out_dims[DIMS], _Complex float* out_data, _Complex float* eptr, int SN, float svals[__VLA2(SN)], const long calreg_dims[DIMS], const _Complex float* data, const long msk_dims[3], const _Bool* msk);
 
-extern void eigenmaps(const long out_dims[DIMS], _Complex float* out_data, _Complex float* eptr, const _Complex float* imgcov, const long msk_dims[3], const _Bool* msk, _Bool orthiter, int num_orthiter, _Bool usegpu);
+extern void eigenmaps(const long out_dims[DIMS], _Complex float* out_data, _Complex float* eptr, const _Complex float* imgcov, const long msk_dims[3], const _Bool* msk, _Bool orthiter, int num_orthiter, int warm_orthiter, _Bool usegpu);
 
 
 extern void crop_sens(const long dims[DIMS], _Complex float* ptr, bool soft, float crth, const _Complex float* map);
@@ -14,6 +14,7 @@
 #include "num/casorati.h"
 #include "num/lapack.h"
 #include "num/linalg.h"
+#include "num/blas.h"
 
 #include "misc/misc.h"
 #include "misc/mri.h"
@@ -154,23 +155,102 @@ static void circular_patch_mask(const long kdims[3], int channels, complex float
 }
 #endif
 
-void covariance_function(const long kdims[3], int N, complex float cov[N][N], const long calreg_dims[4], const complex float* data)
+/**
+ *	Compute the covariance (Gram) matrix A^H A of the calibration
+ *	matrix A without building A explicitly. Rows of A (patch
+ *	positions) are processed in slabs along the outermost dimension,
+ *	so that at most about max_block elements of A exist at a time.
+ *	The products are accumulated in parallel over column blocks.
+ */
+void covariance_function2(const long kdims[3], int N, complex float cov[N][N], const long calreg_dims[4], const complex float* data, long max_block)
 {
+	long kernel_dims[4];
+	md_copy_dims(3, kernel_dims, kdims);
+	kernel_dims[3] = calreg_dims[3];
+
 	long calmat_dims[2];
-#if 1
-	complex float* cm = calibration_matrix(calmat_dims, kdims, calreg_dims, data);
-#else
-	long channels = calreg_dims[3];
-	complex float msk[channels * md_calc_size(3, kdims)];
-	circular_patch_mask(kdims, channels, msk);
-	complex float* cm = calibration_matrix_mask2(calmat_dims, kdims, msk, calreg_dims, data);
-#endif
-	int L = calmat_dims[0];
+	casorati_dims(4, calmat_dims, kernel_dims, calreg_dims);
+
 	assert(N == calmat_dims[1]);
 
-	gram_matrix(N, cov, L, MD_CAST_ARRAY2(const complex float, 2, calmat_dims, cm, 0, 1));
+	long pdims[3];
+
+	for (int i = 0; i < 3; i++)
+		pdims[i] = calreg_dims[i] - kdims[i] + 1;
+
+	// slabs along the outermost dimension with more than one patch
+
+	int d = 2;
+
+	while ((d > 0) && (1 == pdims[d]))
+		d--;
+
+	long rows = md_calc_size(d, pdims);
+	long slab = MIN(pdims[d], MAX(1, max_block / (rows * N)));
+
+	long calreg_strs[4];
+	md_calc_strides(4, calreg_strs, calreg_dims, CFL_SIZE);
+
+	complex float* cm = md_alloc_sameplace(2, MD_DIMS(rows * slab, N), CFL_SIZE, data);
+
+	for (int j = 0; j < N; j++)
+		for (int i = 0; i < N; i++)
+			cov[j][i] = 0.;
+
+	enum { CALMAT_COLUMN_BLOCK = 64 };
+
+	long nblocks = (N + CALMAT_COLUMN_BLOCK - 1) / CALMAT_COLUMN_BLOCK;
+
+	for (long p = 0; p < pdims[d]; p += slab) {
+
+		long sub_dims[4];
+		md_copy_dims(4, sub_dims, calreg_dims);
+		sub_dims[d] = MIN(slab, pdims[d] - p) + kdims[d] - 1;
+
+		long sub_calmat_dims[2];
+		casorati_dims(4, sub_calmat_dims, kernel_dims, sub_dims);
+
+		long L = sub_calmat_dims[0];
+
+		casorati_matrix(4, kernel_dims, sub_calmat_dims, cm, sub_dims, calreg_strs, (const void*)data + p * calreg_strs[d]);
+
+		// upper triangle: cov[j][i] += sum_l conj(A(l, i)) A(l, j) for i <= j
+
+#pragma omp parallel for
+		for (long b = 0; b < nblocks; b++) {
+
+			long j0 = b * CALMAT_COLUMN_BLOCK;
+			long j1 = MIN(N, j0 + CALMAT_COLUMN_BLOCK);
+
+			blas_cgemm('C', 'N', j1, j1 - j0, L, 1., L, cm, L, cm + j0 * L, 1., N, &cov[j0][0]);
+		}
+	}
 
 	md_free(cm);
+
+	// same layout as gram_matrix
+
+	for (int j = 0; j < N; j++) {
+
+		for (int i = 0; i < j; i++) {
+
+			complex float val = cov[j][i];
+
+			cov[i][j] = val;
+			cov[j][i] = conjf(val);
+		}
+
+		cov[j][j] = crealf(cov[j][j]);
+	}
+}
+
+
+
+void covariance_function(const long kdims[3], int N, complex float cov[N][N], const long calreg_dims[4], const complex float* data)
+{
+	enum { CALMAT_BLOCK_SIZE = 1 << 22 };
+
+	covariance_function2(kdims, N, cov, calreg_dims, data, CALMAT_BLOCK_SIZE);
 }
 
 
@@ -46,7 +46,23 @@ void walsh(const long bsize[3], const long dims[DIMS], complex float* sens, cons
 	kdims[2] = MIN(bsize[2], dims[2]);
 
 	md_resize_center(DIMS, dims1, sens, caldims, data, CFL_SIZE);
-	ifftc(DIMS, dims1, FFT_FLAGS, sens, sens);
+
+	// calibration data is zero outside the center
+
+	long cpos[DIMS] = { 0 };
+	long opos[DIMS] = { 0 };
+	long cdims[DIMS];
+	md_copy_dims(DIMS, cdims, dims1);
+
+	for (int i = 0; i < 3; i++) {
+
+		cdims[i] = MIN(caldims[i], dims1[i]);
+		cpos[i] = dims1[i] / 2 - cdims[i] / 2;
+	}
+
+	ifftmod(DIMS, dims1, FFT_FLAGS, sens, sens);
+	ifft_pruned(DIMS, dims1, FFT_FLAGS, cpos, cdims, opos, dims1, sens, sens);
+	ifftmod(DIMS, dims1, FFT_FLAGS, sens, sens);
 
 	long odims[DIMS];
 	md_copy_dims(DIMS, odims, dims1);
@@ -72,7 +72,9 @@ int main_cc(int argc, char* argv[argc])
 
 	long in_dims[DIMS];
 
-	complex float* in_data = load_cfl(in_file, DIMS, in_dims);
+	struct cfl_stream_s* in = stream_load_cfl(in_file, DIMS, in_dims);
+
+	long zero_pos[DIMS] = { 0 };
 
 	assert(1 == in_dims[MAPS_DIM]);
 	long channels = in_dims[COIL_DIM];
@@ -94,11 +96,33 @@ int main_cc(int argc, char* argv[argc])
 	if (all) {
 
 		md_copy_dims(DIMS, caldims, in_dims);
-		cal_data = in_data;
+		cal_data = md_alloc(DIMS, caldims, CFL_SIZE);
+
+		stream_read_cfl(in, DIMS, caldims, zero_pos, cal_data);
 
 	} else {
-		
-		cal_data = extract_calib(caldims, calsize, in_dims, in_data, false);
+
+		// only read the center (as in extract_calib)
+
+		long ctr_dims[DIMS];
+		long ctr_pos[DIMS];
+
+		md_copy_dims(DIMS, ctr_dims, in_dims);
+		md_set_dims(DIMS, ctr_pos, 0);
+
+		for (int i = 1; i < 3; i++) {
+
+			ctr_dims[i] = MIN(calsize[i], in_dims[i]);
+			ctr_pos[i] = (in_dims[i] - ctr_dims[i]) / 2;
+		}
+
+		complex float* ctr_data = md_alloc(DIMS, ctr_dims, CFL_SIZE);
+
+		stream_read_cfl(in, DIMS, ctr_dims, ctr_pos, ctr_data);
+
+		cal_data = extract_calib(caldims, calsize, ctr_dims, ctr_data, false);
+
+		md_free(ctr_data);
 	}
 
 	if (0. == md_znorm(DIMS, caldims, cal_data))
@@ -115,8 +139,7 @@ int main_cc(int argc, char* argv[argc])
 	case ECC: ecc(out_dims, out_data, caldims, cal_data); break;
 	}
 
-	if (!all)
-		md_free(cal_data);
+	md_free(cal_data);
 
 
 	if (proj) {
@@ -127,11 +150,7 @@ int main_cc(int argc, char* argv[argc])
 		md_copy_dims(DIMS, trans_dims, in_dims);
 		trans_dims[COIL_DIM] = P;
 
-		complex float* trans_data = create_cfl(out_file, DIMS, trans_dims);
-
-		long fake_trans_dims[DIMS];
-		md_select_dims(DIMS, ~COIL_FLAG, fake_trans_dims, in_dims);
-		fake_trans_dims[MAPS_DIM] = P;
+		struct cfl_stream_s* trans = stream_create_cfl(out_file, DIMS, trans_dims);
 
 		long out2_dims[DIMS];
 		md_copy_dims(DIMS, out2_dims, out_dims);
@@ -139,14 +158,6 @@ int main_cc(int argc, char* argv[argc])
 
 		if (SCC != cc_type) {
 
-			complex float* in2_data = anon_cfl(NULL, DIMS, in_dims);
-
-			ifftuc(DIMS, in_dims, READ_FLAG, in2_data, in_data);
-
-			unmap_cfl(DIMS, in_dims, in_data);
-			in_data = in2_data;
-
-
 			complex float* out2 = anon_cfl(NULL, DIMS, out2_dims);
 			align_ro(out2_dims, out2, out_data);
 
@@ -154,25 +165,54 @@ int main_cc(int argc, char* argv[argc])
 			out_data = out2;
 		}
 
-		md_zmatmulc(DIMS, fake_trans_dims, trans_data, out2_dims, out_data, in_dims, in_data);
+		// project slab by slab
 
-		if (SCC != cc_type) {
+		long slab_dims[DIMS];
+		stream_slab_dims(DIMS, slab_dims, in_dims, READ_FLAG | COIL_FLAG | MAPS_FLAG);
 
-			fftuc(DIMS, trans_dims, READ_FLAG, trans_data, trans_data);
+		long tslab_dims[DIMS];
+		md_copy_dims(DIMS, tslab_dims, slab_dims);
+		tslab_dims[COIL_DIM] = P;
 
-			unmap_cfl(DIMS, out2_dims, out_data);
+		long fake_trans_dims[DIMS];
+		md_select_dims(DIMS, ~COIL_FLAG, fake_trans_dims, slab_dims);
+		fake_trans_dims[MAPS_DIM] = P;
+
+		complex float* in_slab = md_alloc(DIMS, slab_dims, CFL_SIZE);
+		complex float* trans_slab = md_alloc(DIMS, tslab_dims, CFL_SIZE);
+
+		long pos[DIMS];
+		md_set_dims(DIMS, pos, 0);
 
-		} else {
+		do {
+			stream_read_cfl(in, DIMS, slab_dims, pos, in_slab);
 
+			if (SCC != cc_type)
+				ifftuc(DIMS, slab_dims, READ_FLAG, in_slab, in_slab);
+
+			md_zmatmulc(DIMS, fake_trans_dims, trans_slab, out2_dims, out_data, slab_dims, in_slab);
+
+			if (SCC != cc_type)
+				fftuc(DIMS, tslab_dims, READ_FLAG, trans_slab, trans_slab);
+
+			stream_write_cfl(trans, DIMS, tslab_dims, pos, trans_slab);
+
+		} while (stream_next(DIMS, in_dims, slab_dims, pos));
+
+		md_free(in_slab);
+		md_free(trans_slab);
+
+		if (SCC != cc_type)
+			unmap_cfl(DIMS, out2_dims, out_data);
+		else
 			unmap_cfl(DIMS, out_dims, out_data);
-		}
 
-		unmap_cfl(DIMS, trans_dims, trans_data);
-		unmap_cfl(DIMS, in_dims, in_data);
+		stream_close_cfl(trans);
+		stream_close_cfl(in);
 
 	} else {
 
-		unmap_cfl(DIMS, in_dims, in_data);
+		stream_close_cfl(in);
 		unmap_cfl(DIMS, out_dims, out_data);
 	}
 
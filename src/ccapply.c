@@ -65,7 +65,7 @@ int main_ccapply(int argc, char* argv[argc])
 	long in_dims[DIMS];
 	long cc_dims[DIMS];
 
-	complex float* in_data = load_cfl(ksp_file, DIMS, in_dims);
+	struct cfl_stream_s* in = stream_load_cfl(ksp_file, DIMS, in_dims);
 	complex float* cc_data = load_cfl(cc_file, DIMS, cc_dims);
 
 	assert(1 == in_dims[MAPS_DIM]);
@@ -81,7 +81,16 @@ int main_ccapply(int argc, char* argv[argc])
 	md_select_dims(DIMS, ~COIL_FLAG, out_dims, in_dims);
 	out_dims[COIL_DIM] = forward ? P : channels;
 	
-	complex float* out_data = create_cfl(out_file, DIMS, out_dims);
+	struct cfl_stream_s* out = stream_create_cfl(out_file, DIMS, out_dims);
+
+	// process the data in slabs which contain all channels and the full readout
+
+	long slab_dims[DIMS];
+	stream_slab_dims(DIMS, slab_dims, in_dims, READ_FLAG | COIL_FLAG | MAPS_FLAG);
+
+	long oslab_dims[DIMS];
+	md_copy_dims(DIMS, oslab_dims, slab_dims);
+	oslab_dims[COIL_DIM] = out_dims[COIL_DIM];
 
 	// transpose for the matrix multiplication
 	long trp_dims[DIMS];
@@ -90,14 +99,14 @@ int main_ccapply(int argc, char* argv[argc])
 
 		debug_printf(DP_DEBUG1, "Compressing to %ld virtual coils...\n", P);
 
-		md_transpose_dims(DIMS, COIL_DIM, MAPS_DIM, trp_dims, out_dims);
-		trp_dims[MAPS_DIM] = out_dims[COIL_DIM];
+		md_transpose_dims(DIMS, COIL_DIM, MAPS_DIM, trp_dims, oslab_dims);
+		trp_dims[MAPS_DIM] = oslab_dims[COIL_DIM];
 
 	} else {
 
 		debug_printf(DP_DEBUG1, "Uncompressing channels...\n");
 
-		md_transpose_dims(DIMS, COIL_DIM, MAPS_DIM, trp_dims, in_dims);
+		md_transpose_dims(DIMS, COIL_DIM, MAPS_DIM, trp_dims, slab_dims);
 	}
 
 	long cc2_dims[DIMS];
@@ -106,17 +115,6 @@ int main_ccapply(int argc, char* argv[argc])
 
 	if (SCC != cc_type) {
 
-		if (do_fft) {
-
-			complex float* in2_data = anon_cfl(NULL, DIMS, in_dims);
-
-			ifftuc(DIMS, in_dims, READ_FLAG, in2_data, in_data);
-
-			unmap_cfl(DIMS, in_dims, in_data);
-
-			in_data = in2_data;
-		}
-
 		complex float* cc2_data = anon_cfl(NULL, DIMS, cc2_dims);
 
 		align_ro(cc2_dims, cc2_data, cc_data);
@@ -126,25 +124,40 @@ int main_ccapply(int argc, char* argv[argc])
 		cc_data = cc2_data;
 	}
 
-	if (forward)
-		md_zmatmulc(DIMS, trp_dims, out_data, cc2_dims, cc_data, in_dims, in_data);
-	else
-		md_zmatmul(DIMS, out_dims, out_data, cc2_dims, cc_data, trp_dims, in_data);
+	complex float* in_data = md_alloc(DIMS, slab_dims, CFL_SIZE);
+	complex float* out_data = md_alloc(DIMS, oslab_dims, CFL_SIZE);
 
-	if (SCC != cc_type) {
+	long pos[DIMS];
+	md_set_dims(DIMS, pos, 0);
 
-		if (do_fft)
-			fftuc(DIMS, out_dims, READ_FLAG, out_data, out_data);
+	do {
+		stream_read_cfl(in, DIMS, slab_dims, pos, in_data);
 
-		unmap_cfl(DIMS, cc2_dims, cc_data);
+		if ((SCC != cc_type) && do_fft)
+			ifftuc(DIMS, slab_dims, READ_FLAG, in_data, in_data);
 
-	} else {
+		if (forward)
+			md_zmatmulc(DIMS, trp_dims, out_data, cc2_dims, cc_data, slab_dims, in_data);
+		else
+			md_zmatmul(DIMS, oslab_dims, out_data, cc2_dims, cc_data, trp_dims, in_data);
+
+		if ((SCC != cc_type) && do_fft)
+			fftuc(DIMS, oslab_dims, READ_FLAG, out_data, out_data);
+
+		stream_write_cfl(out, DIMS, oslab_dims, pos, out_data);
+
+	} while (stream_next(DIMS, in_dims, slab_dims, pos));
 
+	md_free(in_data);
+	md_free(out_data);
+
+	if (SCC != cc_type)
+		unmap_cfl(DIMS, cc2_dims, cc_data);
+	else
 		unmap_cfl(DIMS, cc_dims, cc_data);
-	}
 
-	unmap_cfl(DIMS, in_dims, in_data);
-	unmap_cfl(DIMS, out_dims, out_data);
+	stream_close_cfl(in);
+	stream_close_cfl(out);
 
 	printf("Done.\n");
 
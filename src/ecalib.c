@@ -86,6 +86,9 @@ int main_ecalib(int argc, char* argv[argc])
 		OPT_INT('n', &conf.numsv, "", "()"),
 		OPT_FLOAT('v', &conf.var, "variance", "Variance of noise in data."),
 		OPT_SET('a', &conf.automate, "Automatically pick thresholds."),
+		OPTL_LONG(0, "coarse", &conf.coarse, "f", "compute maps on a grid decimated by f and interpolate"),
+		OPTL_SET(0, "coarse-check", &conf.coarse_check, "report error of coarse grid maps against full resolution maps"),
+		OPTL_INT(0, "orthiter-warm", &conf.warm_orthiter, "n", "start orthogonal iterations from the neighboring point and use n iterations"),
 		OPT_INT('d', &debug_level, "level", "Debug level"),
 	};
 
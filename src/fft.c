@@ -58,19 +58,33 @@ int main_fft(int argc, char* argv[argc])
 	num_init();
 
 	long dims[DIMS];
-	complex float* idata = load_cfl(in_file, DIMS, dims);
-	complex float* data = create_cfl(out_file, DIMS, dims);
+	struct cfl_stream_s* in = stream_load_cfl(in_file, DIMS, dims);
+	struct cfl_stream_s* out = stream_create_cfl(out_file, DIMS, dims);
 
+	long slab_dims[DIMS];
+	stream_slab_dims(DIMS, slab_dims, dims, flags);
 
-	md_copy(DIMS, dims, data, idata, sizeof(complex float));
-	unmap_cfl(DIMS, dims, idata);
+	complex float* data = md_alloc(DIMS, slab_dims, sizeof(complex float));
 
-	if (unitary)
-		fftscale(DIMS, dims, flags, data, data);
+	long pos[DIMS];
+	md_set_dims(DIMS, pos, 0);
 
-	(inv ? (center ? ifftc : ifft) : (center ? fftc : fft))(DIMS, dims, flags, data, data);
+	do {
+		stream_read_cfl(in, DIMS, slab_dims, pos, data);
 
-	unmap_cfl(DIMS, dims, data);
+		if (unitary)
+			fftscale(DIMS, slab_dims, flags, data, data);
+
+		(inv ? (center ? ifftc : ifft) : (center ? fftc : fft))(DIMS, slab_dims, flags, data, data);
+
+		stream_write_cfl(out, DIMS, slab_dims, pos, data);
+
+	} while (stream_next(DIMS, dims, slab_dims, pos));
+
+	md_free(data);
+
+	stream_close_cfl(in);
+	stream_close_cfl(out);
 
 	return 0;
 }
@@ -0,0 +1,115 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ */
+
+#include <stdbool.h>
+#include <complex.h>
+
+#include "num/multind.h"
+#include "num/fft.h"
+#include "num/init.h"
+
+#include "linops/linop.h"
+#include "linops/someops.h"
+
+#include "noncart/nufft.h"
+
+#include "misc/mmio.h"
+#include "misc/mri.h"
+#include "misc/opts.h"
+#include "misc/misc.h"
+#include "misc/debug.h"
+
+
+static const char help_str[] = "Measure FFTW plans for a reconstruction with pics and store them in the wisdom database.\n"
+				"The database is $BART_FFTW_WISDOM or $TOOLBOX_PATH/save/fftw/wisdom.\n"
+				"Plans are used by later runs with BART_USE_FFTW_WISDOM=1.";
+
+
+
+int main_fftwtune(int argc, char* argv[argc])
+{
+	const char* ksp_file = NULL;
+	const char* sens_file = NULL;
+
+	struct arg_s args[] = {
+
+		ARG_INFILE(true, &ksp_file, "kspace"),
+		ARG_INFILE(true, &sens_file, "sensitivities"),
+	};
+
+	const char* traj_file = NULL;
+	unsigned long loop_flags = 0UL;
+
+	struct nufft_conf_s nuconf = nufft_conf_defaults;
+	nuconf.toeplitz = true;
+	nuconf.lowmem = false;
+
+	const struct opt_s opts[] = {
+
+		OPT_INFILE('t', &traj_file, "file", "k-space trajectory"),
+		OPT_ULONG('L', &loop_flags, "flags", "batch-mode"),
+		OPTL_SET('U', "lowmem", &nuconf.lowmem, "Use low-mem mode of the nuFFT"),
+		OPTL_CLEAR(0, "no-toeplitz", &nuconf.toeplitz, "Turn off Toeplitz mode of nuFFT"),
+	};
+
+	cmdline(&argc, argv, ARRAY_SIZE(args), args, help_str, ARRAY_SIZE(opts), opts);
+
+	num_init();
+
+	use_fftw_wisdom = true;
+
+	long ksp_dims[DIMS];
+	long map_dims[DIMS];
+	long traj_dims[DIMS];
+
+	complex float* kspace = load_cfl(ksp_file, DIMS, ksp_dims);
+	complex float* maps = load_cfl(sens_file, DIMS, map_dims);
+	complex float* traj = (NULL != traj_file) ? load_cfl(traj_file, DIMS, traj_dims) : NULL;
+
+	// same operator dimensions as in pics
+
+	long max_dims[DIMS];
+	md_copy_dims(DIMS, max_dims, ksp_dims);
+	md_copy_dims(5, max_dims, map_dims);
+
+	long max1_dims[DIMS];
+	md_select_dims(DIMS, ~loop_flags, max1_dims, max_dims);
+
+	long coilim_dims[DIMS];
+	md_select_dims(DIMS, ~MAPS_FLAG, coilim_dims, max1_dims);
+
+	double start = timestamp();
+
+	const struct linop_s* op = NULL;
+
+	if (NULL == traj) {
+
+		op = linop_fft_create(DIMS, coilim_dims, FFT_FLAGS);
+
+	} else {
+
+		long ksp1_dims[DIMS];
+		md_select_dims(DIMS, ~loop_flags, ksp1_dims, ksp_dims);
+
+		long traj1_dims[DIMS];
+		md_select_dims(DIMS, ~loop_flags, traj1_dims, traj_dims);
+
+		op = nufft_create(DIMS, ksp1_dims, coilim_dims, traj1_dims, traj, NULL, nuconf);
+	}
+
+	linop_free(op);
+
+	fft_store_wisdom();
+
+	debug_printf(DP_INFO, "Planning time: %.2fs\n", timestamp() - start);
+
+	unmap_cfl(DIMS, ksp_dims, kspace);
+	unmap_cfl(DIMS, map_dims, maps);
+
+	if (NULL != traj)
+		unmap_cfl(DIMS, traj_dims, traj);
+
+	return 0;
+}
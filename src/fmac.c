@@ -62,20 +62,13 @@ int main_fmac(int argc, char* argv[argc])
 	long dims1[N];
 	long dims2[N];
 
-	complex float* data1 = load_cfl(in1_file, N, dims1);
-
-	complex float* data2 = NULL;
-	
-	if (NULL != in2_file) {
-
-		data2 = load_cfl(in2_file, N, dims2);
-
-	} else {
+	struct cfl_stream_s* in1 = stream_load_cfl(in1_file, N, dims1);
+	struct cfl_stream_s* in2 = NULL;
 
+	if (NULL != in2_file)
+		in2 = stream_load_cfl(in2_file, N, dims2);
+	else
 		md_singleton_dims(N, dims2);
-		data2 = md_alloc(N, dims2, CFL_SIZE);
-		md_zfill(N, dims2, data2, 1.);
-	}
 
 	long dims[N];
 	md_merge_dims(N, dims, dims1, dims2);
@@ -83,30 +76,74 @@ int main_fmac(int argc, char* argv[argc])
 	long dimso[N];
 	md_select_dims(N, ~squash, dimso, dims);
 
-	complex float* out = create_cfl(out_file, N, dimso);
+	struct cfl_stream_s* out = stream_create_cfl(out_file, N, dimso);
+
+	// squashed dimensions are reduced within one slab
 
-	if (clear) {
+	long slab_dims[N];
+	stream_slab_dims(N, slab_dims, dims, squash);
 
-		md_clear(N, dimso, out, CFL_SIZE);
-	}
+	long slab1_dims[N];
+	long slab2_dims[N];
+	long slabo_dims[N];
+
+	md_select_dims(N, md_nontriv_dims(N, dims1), slab1_dims, slab_dims);
+	md_select_dims(N, md_nontriv_dims(N, dims2), slab2_dims, slab_dims);
+	md_select_dims(N, ~squash, slabo_dims, slab_dims);
+
+	complex float* data1 = md_alloc(N, slab1_dims, CFL_SIZE);
+	complex float* data2 = md_alloc(N, slab2_dims, CFL_SIZE);
+	complex float* datao = md_alloc(N, slabo_dims, CFL_SIZE);
+
+	if (NULL == in2)
+		md_zfill(N, slab2_dims, data2, 1.);
 
 	long str1[N];
 	long str2[N];
 	long stro[N];
 
-	md_calc_strides(N, str1, dims1, CFL_SIZE);
-	md_calc_strides(N, str2, dims2, CFL_SIZE);
-	md_calc_strides(N, stro, dimso, CFL_SIZE);
+	md_calc_strides(N, str1, slab1_dims, CFL_SIZE);
+	md_calc_strides(N, str2, slab2_dims, CFL_SIZE);
+	md_calc_strides(N, stro, slabo_dims, CFL_SIZE);
 
-	(conj ? md_zfmacc2 : md_zfmac2)(N, dims, stro, out, str1, data1, str2, data2);
+	long pos[N];
+	md_set_dims(N, pos, 0);
 
-	unmap_cfl(N, dims1, data1);
-	unmap_cfl(N, dimso, out);
+	do {
+		long pos1[N];
+		long pos2[N];
 
-	if (NULL != in2_file)
-		unmap_cfl(N, dims2, data2);
-	else
-		md_free(data2);
+		for (int i = 0; i < N; i++) {
+
+			pos1[i] = (1 == dims1[i]) ? 0 : pos[i];
+			pos2[i] = (1 == dims2[i]) ? 0 : pos[i];
+		}
+
+		stream_read_cfl(in1, N, slab1_dims, pos1, data1);
+
+		if (NULL != in2)
+			stream_read_cfl(in2, N, slab2_dims, pos2, data2);
+
+		if (clear)
+			md_clear(N, slabo_dims, datao, CFL_SIZE);
+		else
+			stream_read_cfl(out, N, slabo_dims, pos, datao);
+
+		(conj ? md_zfmacc2 : md_zfmac2)(N, slab_dims, stro, datao, str1, data1, str2, data2);
+
+		stream_write_cfl(out, N, slabo_dims, pos, datao);
+
+	} while (stream_next(N, dims, slab_dims, pos));
+
+	md_free(data1);
+	md_free(data2);
+	md_free(datao);
+
+	stream_close_cfl(in1);
+	stream_close_cfl(out);
+
+	if (NULL != in2)
+		stream_close_cfl(in2);
 
 	return 0;
 }
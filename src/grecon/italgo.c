@@ -67,7 +67,7 @@ enum algo_t italgo_choose(int nr_penalties, const struct reg_s regs[nr_penalties
 }
 
 
-struct iter italgo_config(enum algo_t algo, int nr_penalties, const struct reg_s* regs, unsigned int maxiter, float step, bool hogwild, bool fast, const struct admm_conf admm, float scaling, bool warm_start)
+struct iter italgo_config(enum algo_t algo, int nr_penalties, const struct reg_s* regs, unsigned int maxiter, float step, bool hogwild, bool fast, const struct admm_conf admm, float scaling, bool warm_start, enum vec_storage storage, bool cg_pipelined)
 {
 	italgo_fun2_t italgo = NULL;
 	iter_conf* iconf = NULL;
@@ -88,6 +88,8 @@ struct iter italgo_config(enum algo_t algo, int nr_penalties, const struct reg_s
 			*cgconf = iter_conjgrad_defaults;
 			cgconf->maxiter = maxiter;
 			cgconf->l2lambda = (0 == nr_penalties) ? 0. : regs[0].lambda;
+			cgconf->storage = storage;
+			cgconf->pipelined = cg_pipelined;
 
 			PTR_ALLOC(struct iter_call_s, iter2_data);
 			SET_TYPEID(iter_call_s, iter2_data);
@@ -142,6 +144,7 @@ struct iter italgo_config(enum algo_t algo, int nr_penalties, const struct reg_s
 			mmconf->ABSTOL = 0.;
 			mmconf->RELTOL = 0.;
 			mmconf->do_warmstart = warm_start;
+			mmconf->storage = storage;
 			italgo = iter2_admm;
 			iconf = CAST_UP(PTR_PASS(mmconf));
 
@@ -19,10 +19,11 @@ struct iter {
 
 struct reg_s;
 enum algo_t;
+enum vec_storage;
 
 extern enum algo_t italgo_choose(int nr_penalties, const struct reg_s regs[nr_penalties]);
 
-extern struct iter italgo_config(enum algo_t algo, int nr_penalties, const struct reg_s* regs, unsigned int maxiter, float step, bool hogwild, bool fast, const struct admm_conf admm, float scaling, bool warm_start);
+extern struct iter italgo_config(enum algo_t algo, int nr_penalties, const struct reg_s* regs, unsigned int maxiter, float step, bool hogwild, bool fast, const struct admm_conf admm, float scaling, bool warm_start, enum vec_storage storage, bool cg_pipelined);
 
 extern void italgo_config_free(struct iter it);
 
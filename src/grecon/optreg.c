@@ -36,6 +36,7 @@
 #include "wavelet/wavthresh.h"
 
 #include "lowrank/lrthresh.h"
+#include "lowrank/batchsvd.h"
 
 #include "nn/tf_wrapper.h"
 
@@ -57,6 +58,9 @@ void help_reg(void)
 			"-R Q:C    \tl2-norm in image domain\n"
 			"-R I:B:C  \tl1-norm in image domain\n"
 			"-R W:A:B:C\tl1-wavelet\n"
+			"\t\tBART_WAVELET_TILE_SIZE limits the size of the\n"
+			"\t\twavelet temporaries by splitting dimensions which\n"
+			"\t\tare not in A or B (no effect for plain 2D/3D).\n"
 		        "-R N:A:B:C\tNormalized Iterative Hard Thresholding (NIHT), image domain\n"
 		        "\t\tC is an integer percentage, i.e. from 0-100\n"
 		        "-R H:A:B:C\tNIHT, wavelet domain\n"
@@ -254,6 +258,7 @@ bool opt_reg_init(struct opt_reg_s* ropts)
 	ropts->lambda = -1;
 	ropts->svars = 0;
 	ropts->sr = 0;
+	ropts->svd_conf = NULL;
 
 	return false;
 }
@@ -547,7 +552,8 @@ void opt_reg_configure(int N, const long img_dims[N], struct opt_reg_s* ropts, c
 			int remove_mean = 0;
 
 			trafos[nr] = linop_identity_create(DIMS, img_dims);
-			prox_ops[nr] = lrthresh_create(img_dims, randshift, regs[nr].xflags, (const long (*)[DIMS])blkdims, regs[nr].lambda, false, remove_mean, overlapping_blocks);
+			prox_ops[nr] = lrthresh_create2(img_dims, randshift, regs[nr].xflags, (const long (*)[DIMS])blkdims, regs[nr].lambda, false, remove_mean, overlapping_blocks,
+							(NULL != ropts->svd_conf) ? ropts->svd_conf : &batch_svd_conf_defaults);
 
 			if (use_gpu) {
 
@@ -14,6 +14,7 @@
 
 struct operator_p_s;
 struct linop_s;
+struct batch_svd_conf_s;
 
 
 struct reg_s {
@@ -36,6 +37,8 @@ struct opt_reg_s {
 	int r;
 	int svars;
 	int sr;
+
+	const struct batch_svd_conf_s* svd_conf;	// SVD used for LLR (NULL: full SVD)
 };
 
 
@@ -89,7 +89,29 @@ static complex float* estimate_phase(struct wdata wdata, unsigned long flags,
 	md_resize_center(N, dims, phase, cdims, center, CFL_SIZE);
 	md_free(center);
 
-	(center_fft ? ifftuc : ifftu)(N, dims, flags, phase, phase);
+	// only the center of k-space is non-zero
+
+	long cpos[N];
+	long opos[N];
+
+	for (unsigned int i = 0; i < N; i++) {
+
+		if (!MD_IS_SET(flags, i))
+			cdims[i] = dims[i];
+
+		cpos[i] = dims[i] / 2 - cdims[i] / 2;
+		opos[i] = 0;
+	}
+
+	if (center_fft)
+		ifftmod(N, dims, flags, phase, phase);
+
+	ifft_pruned(N, dims, flags, cpos, cdims, opos, dims, phase, phase);
+
+	if (center_fft)
+		ifftmod(N, dims, flags, phase, phase);
+
+	fftscale(N, dims, flags, phase, phase);
 	md_zphsr(N, dims, phase, phase);
 
 	return phase;
@@ -38,6 +38,7 @@
 #include <assert.h>
 
 #include "num/ops.h"
+#include "num/vecfuse.h"
 
 #include "misc/debug.h"
 #include "misc/misc.h"
@@ -118,6 +119,8 @@ struct cg_xupdate_s {
 
 	float cg_eps;
 
+	enum vec_storage storage;
+
 	struct admm_normaleq_data* ndata;
 
 	struct iter_monitor_s* monitor;
@@ -139,8 +142,8 @@ static void cg_xupdate(iter_op_data* _data, float rho, float* x, const float* rh
 	if (0. == eps)	// x should have been initialized already
 		return;
 
-	conjgrad(data->maxitercg, 0.,
-			data->cg_eps * eps, data->N, data->vops,
+	conjgrad2(data->maxitercg, 0.,
+			data->cg_eps * eps, data->N, data->vops, data->storage,
 			(struct iter_op_s){ admm_normaleq, CAST_UP(data->ndata) },
 			x, rhs,
 			data->monitor);
@@ -177,6 +180,12 @@ void admm(const struct admm_plan_s* plan,
 {
 	unsigned int num_funs = D;
 
+	// the scaled dual variables are only used in elementwise
+	// operations and may be stored in reduced precision
+
+	enum vec_storage ust = vec_storage_select(vops, plan->storage);
+
+	struct vec_fuse_s f;
 
 	float* rhs = vops->allocate(N);
 	float* s = vops->allocate(N);
@@ -186,12 +195,14 @@ void admm(const struct admm_plan_s* plan,
 	float* z[num_funs ?:1];
 	float* u[num_funs ?:1];
 	float* r[num_funs ?:1];
+	float uscale[num_funs ?:1];
 
 	for (unsigned int j = 0; j < num_funs; j++) {
 
 		z[j] = vops->allocate(z_dims[j]);
-		u[j] = vops->allocate(z_dims[j]);
+		u[j] = vec_storage_allocate(vops, ust, z_dims[j]);
 		r[j] = vops->allocate(z_dims[j]);
+		uscale[j] = 1.;
 	}
 
 
@@ -223,6 +234,7 @@ void admm(const struct admm_plan_s* plan,
 		.vops = vops,
 		.maxitercg = plan->maxitercg,
 		.cg_eps = plan->cg_eps,
+		.storage = plan->storage,
 		.ndata = &ndata,
 
 		.monitor = monitor,
@@ -270,7 +282,13 @@ void admm(const struct admm_plan_s* plan,
 			else
 				iter_op_p_call(plan->prox_ops[j], plan->lambda / rho, z[j], Gjx_plus_uj);
 
-			vops->sub(z_dims[j], u[j], Gjx_plus_uj, z[j]);
+			if (VEC_FP32 != ust)
+				uscale[j] = vec_storage_scale(ust, z_dims[j], vops->norm(z_dims[j], Gjx_plus_uj));
+
+			vec_fuse_init(&f, z_dims[j]);
+			vec_fuse_storage(&f, u[j], ust, uscale[j]);
+			vec_fuse_sub(&f, u[j], Gjx_plus_uj, z[j]);
+			vec_fuse_exec(vops, &f);
 
 			vops->del(Gjx_plus_uj);
 		}
@@ -280,7 +298,7 @@ void admm(const struct admm_plan_s* plan,
 		for (unsigned int j = 0; j < num_funs; j++) {
 
 			vops->clear(z_dims[j], z[j]);
-			vops->clear(z_dims[j], u[j]);
+			vops->clear(vec_storage_length(ust, z_dims[j]), u[j]);
 		}
 	}
 
@@ -294,7 +312,10 @@ void admm(const struct admm_plan_s* plan,
 
 		for (unsigned int j = 0; j < num_funs; j++) {
 
-			vops->sub(z_dims[j], r[j], z[j], u[j]);
+			vec_fuse_init(&f, z_dims[j]);
+			vec_fuse_storage(&f, u[j], ust, uscale[j]);
+			vec_fuse_sub(&f, r[j], z[j], u[j]);
+			vec_fuse_exec(vops, &f);
 
 			if (NULL != biases[j])
 				vops->add(z_dims[j], r[j], r[j], biases[j]);
@@ -337,6 +358,10 @@ void admm(const struct admm_plan_s* plan,
 
 			iter_op_call(plan->ops[j].forward, Gjx_plus_uj, x); // Gj(x)
 
+			// scale of uj (which is still zero) in reduced precision
+			if ((VEC_FP32 != ust) && (0 == i) && !plan->do_warmstart)
+				uscale[j] = vec_storage_scale(ust, z_dims[j], vops->norm(z_dims[j], Gjx_plus_uj));
+
 			// over-relaxation: Gjx_hat = alpha * Gj(x) + (1 - alpha) * (zj_old + bj)
 			if (!plan->fast) {
 
@@ -352,7 +377,10 @@ void admm(const struct admm_plan_s* plan,
 					vops->axpy(z_dims[j], Gjx_plus_uj, (1. - plan->alpha), biases[j]);
 			}
 
-			vops->add(z_dims[j], Gjx_plus_uj, Gjx_plus_uj, u[j]); // Gj(x) + uj
+			vec_fuse_init(&f, z_dims[j]);
+			vec_fuse_storage(&f, u[j], ust, uscale[j]);
+			vec_fuse_add(&f, Gjx_plus_uj, Gjx_plus_uj, u[j]); // Gj(x) + uj
+			vec_fuse_exec(vops, &f);
 
 			if (NULL != biases[j])
 				vops->sub(z_dims[j], Gjx_plus_uj, Gjx_plus_uj, biases[j]); // Gj(x) - bj + uj
@@ -363,9 +391,15 @@ void admm(const struct admm_plan_s* plan,
 			else
 				iter_op_p_call(plan->prox_ops[j], plan->lambda / rho, z[j], Gjx_plus_uj);
 
-			vops->sub(z_dims[j], u[j], Gjx_plus_uj, z[j]);
+			vec_fuse_init(&f, z_dims[j]);
+			vec_fuse_storage(&f, u[j], ust, uscale[j]);
+			vec_fuse_sub(&f, u[j], Gjx_plus_uj, z[j]);
 
-			vops->del(Gjx_plus_uj);
+			// single precision copy of uj for the adjoint below
+			if (!plan->fast && (VEC_FP32 != ust))
+				vec_fuse_copy(&f, Gjx_plus_uj, u[j]);
+
+			vec_fuse_exec(vops, &f);
 
 			if (!plan->fast) {
 
@@ -381,10 +415,11 @@ void admm(const struct admm_plan_s* plan,
 				vops->add(N, s, s, rhs);
 
 				// GH_usum += G_j^H uj (for updating eps_dual)
-				iter_op_call(plan->ops[j].adjoint, rhs, u[j]);
+				iter_op_call(plan->ops[j].adjoint, rhs, (VEC_FP32 != ust) ? Gjx_plus_uj : u[j]);
 				vops->add(N, GH_usum, GH_usum, rhs);
 			}
 
+			vops->del(Gjx_plus_uj);
 			vops->del(zj_old);
 		}
 
@@ -512,8 +547,15 @@ void admm(const struct admm_plan_s* plan,
 
 			rho = rho * sc;
 
-			for (unsigned int j = 0; j < num_funs; j++)
-				vops->smul(z_dims[j], 1. / sc, u[j], u[j]);
+			for (unsigned int j = 0; j < num_funs; j++) {
+
+				// in reduced precision, only the scale changes
+
+				if (VEC_FP32 == ust)
+					vops->smul(z_dims[j], 1. / sc, u[j], u[j]);
+				else
+					uscale[j] /= sc;
+			}
 		}
 	}
 
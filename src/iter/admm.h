@@ -10,6 +10,8 @@
 #include "misc/cppwrap.h"
 #include "misc/types.h"
 
+#include "num/vecfuse.h"
+
 #include "iter/monitor.h"
 #include "iter/italgos.h"
 
@@ -51,6 +53,8 @@ struct admm_op {
  * @param biases array of biases/offsets (size is num_funs)
  *
  * @param image_truth truth image for computing relMSE
+ *
+ * @param storage storage format of the scaled dual variables u_i and of the CG residual
  */
 struct admm_plan_s {
 
@@ -84,6 +88,8 @@ struct admm_plan_s {
 	const float* const* biases;
 
 	struct iter_op_p_s xupdate;
+
+	enum vec_storage storage;
 };
 
 
@@ -37,6 +37,8 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "num/vecfuse.h"
+
 #include "misc/misc.h"
 #include "misc/debug.h"
 
@@ -67,9 +69,14 @@ static void ravine(const struct vec_iter_s* vops, long N, float* ftp, float* xa,
 	ft = (1.f + sqrtf(1.f + 4.f * ft * ft)) / 2.f;
 	*ftp = ft;
 
-	vops->swap(N, xa, xb);
-	vops->axpy(N, xa, (1.f - tfo) / ft - 1.f, xa);
-	vops->axpy(N, xa, (tfo - 1.f) / ft + 1.f, xb);
+	struct vec_fuse_s f;
+	vec_fuse_init(&f, N);
+
+	vec_fuse_swap(&f, xa, xb);
+	vec_fuse_axpy(&f, xa, (1.f - tfo) / ft - 1.f, xa);
+	vec_fuse_axpy(&f, xa, (tfo - 1.f) / ft + 1.f, xb);
+
+	vec_fuse_exec(vops, &f);
 }
 
 
@@ -169,9 +176,18 @@ void ist(unsigned int maxiter, float epsilon, float tau, long N,
 
 
 		iter_op_call(op, r, x);		// r = A x
-		vops->xpay(N, -1., r, b);	// r = b - r = b - A x
 
-		itrdata.rsnew = vops->norm(N, r);
+		double rr;
+
+		struct vec_fuse_s f;
+		vec_fuse_init(&f, N);
+
+		vec_fuse_xpay(&f, -1., r, b);	// r = b - r = b - A x
+		vec_fuse_dot(&f, &rr, r, r);
+
+		vec_fuse_exec(vops, &f);
+
+		itrdata.rsnew = sqrt(rr);
 
 		debug_printf(DP_DEBUG3, "#It %03d: %f \n", itrdata.iter, itrdata.rsnew / itrdata.rsnot);
 
@@ -240,9 +256,18 @@ void fista(unsigned int maxiter, float epsilon, float tau,
 
 		ravine(vops, N, &ra, x, o);	// FISTA
 		iter_op_call(op, r, x);		// r = A x
-		vops->xpay(N, -1., r, b);	// r = b - r = b - A x
 
-		itrdata.rsnew = vops->norm(N, r);
+		double rr;
+
+		struct vec_fuse_s f;
+		vec_fuse_init(&f, N);
+
+		vec_fuse_xpay(&f, -1., r, b);	// r = b - r = b - A x
+		vec_fuse_dot(&f, &rr, r, r);
+
+		vec_fuse_exec(vops, &f);
+
+		itrdata.rsnew = sqrt(rr);
 
 		debug_printf(DP_DEBUG3, "#It %03d: %f   \n", itrdata.iter, itrdata.rsnew / itrdata.rsnot);
 
@@ -324,21 +349,58 @@ float conjgrad(unsigned int maxiter, float l2lambda, float epsilon,
 	float* x, const float* b,
 	struct iter_monitor_s* monitor)
 {
-	float* r = vops->allocate(N);
+	return conjgrad2(maxiter, l2lambda, epsilon, N, vops, VEC_FP32, linop, x, b, monitor);
+}
+
+
+/**
+ * Conjugate Gradient Descent with the residual stored in
+ * format 'storage' (see num/vecfuse.h). All other vectors are
+ * inputs or outputs of the operator and remain in single precision.
+ */
+float conjgrad2(unsigned int maxiter, float l2lambda, float epsilon,
+	long N,
+	const struct vec_iter_s* vops,
+	enum vec_storage storage,
+	struct iter_op_s linop,
+	float* x, const float* b,
+	struct iter_monitor_s* monitor)
+{
+	storage = vec_storage_select(vops, storage);
+
+	float* r = vec_storage_allocate(vops, storage, N);
 	float* p = vops->allocate(N);
 	float* Ap = vops->allocate(N);
 
+	struct vec_fuse_s f;
 
 	// The first calculation of the residual might not
 	// be necessary in some cases...
 
-	iter_op_call(linop, r, x);		// r = A x
-	vops->axpy(N, r, l2lambda, x);
+	iter_op_call(linop, Ap, x);		// Ap = A x
+
+	double rr;
+
+	vec_fuse_init(&f, N);
+
+	vec_fuse_axpy(&f, Ap, l2lambda, x);
+	vec_fuse_sub(&f, p, b, Ap);	// p = b - A x
+	vec_fuse_dot(&f, &rr, p, p);
 
-	vops->xpay(N, -1., r, b);	// r = b - r = b - A x
-	vops->copy(N, p, r);		// p = r
+	vec_fuse_exec(vops, &f);
 
-	float rsnot = (float)pow(vops->norm(N, r), 2.);
+	// the residual is stored scaled to its root mean square
+
+	float scale = vec_storage_scale(storage, N, sqrt(rr));
+
+	vec_fuse_init(&f, N);
+	vec_fuse_storage(&f, r, storage, scale);
+
+	vec_fuse_copy(&f, r, p);	// r = p
+
+	vec_fuse_exec(vops, &f);
+
+	float rsnot = rr;
 	float rsold = rsnot;
 	float rsnew = rsnot;
 
@@ -360,19 +422,33 @@ float conjgrad(unsigned int maxiter, float l2lambda, float epsilon,
 		debug_printf(DP_DEBUG3, "#%d: %f\n", i, (double)sqrtf(rsnew));
 
 		iter_op_call(linop, Ap, p);	// Ap = A p
-		vops->axpy(N, Ap, l2lambda, p);
 
-		float pAp = (float)vops->dot(N, p, Ap);
+		double dpAp;
+
+		vec_fuse_init(&f, N);
+
+		vec_fuse_axpy(&f, Ap, l2lambda, p);
+		vec_fuse_dot(&f, &dpAp, p, Ap);
+
+		vec_fuse_exec(vops, &f);
+
+		float pAp = (float)dpAp;
 
 		if (0. == pAp)
 			break;
 
 		float alpha = rsold / pAp;
 
-		vops->axpy(N, x, +alpha, p);
-		vops->axpy(N, r, -alpha, Ap);
+		vec_fuse_init(&f, N);
+		vec_fuse_storage(&f, r, storage, scale);
+
+		vec_fuse_axpy(&f, x, +alpha, p);
+		vec_fuse_axpy(&f, r, -alpha, Ap);
+		vec_fuse_dot(&f, &rr, r, r);
 
-		rsnew = pow(vops->norm(N, r), 2.);
+		vec_fuse_exec(vops, &f);
+
+		rsnew = rr;
 
 		float beta = rsnew / rsold;
 
@@ -381,7 +457,20 @@ float conjgrad(unsigned int maxiter, float l2lambda, float epsilon,
 		if (rsnew <= eps_squared)
 			break;
 
-		vops->xpay(N, beta, p, r);	// p = beta * p + r
+		float nscale = vec_storage_scale(storage, N, sqrt(rsnew));
+
+		vec_fuse_init(&f, N);
+		vec_fuse_storage(&f, r, storage, scale);
+
+		vec_fuse_xpay(&f, beta, p, r);	// p = beta * p + r
+
+		// rescale the stored residual (exact for powers of two)
+		if (nscale != scale)
+			vec_fuse_smul(&f, scale / nscale, r, r);
+
+		vec_fuse_exec(vops, &f);
+
+		scale = nscale;
 	}
 
 cleanup:
@@ -396,6 +485,134 @@ cleanup:
 
 
 
+/**
+ * Pipelined Conjugate Gradient Descent (Chronopoulos-Gear) to
+ * solve Ax = b for symmetric A
+ *
+ * Mathematically equivalent to conjgrad(), but with the recurrence
+ * s = A p, both inner products of an iteration depend only on r and
+ * A r. They are computed together in one pass, i.e. there is only
+ * one reduction per iteration. All vector updates are fused into
+ * a second pass.
+ *
+ * Chronopoulos AT, Gear CW. s-step iterative methods for symmetric
+ * linear systems. J Comput Appl Math 1989; 25:153-168.
+ */
+float conjgrad_pipelined(unsigned int maxiter, float l2lambda, float epsilon,
+	long N,
+	const struct vec_iter_s* vops,
+	struct iter_op_s linop,
+	float* x, const float* b,
+	struct iter_monitor_s* monitor)
+{
+	float* r = vops->allocate(N);
+	float* w = vops->allocate(N);
+	float* p = vops->allocate(N);
+	float* s = vops->allocate(N);
+
+	struct vec_fuse_s f;
+
+	iter_op_call(linop, w, x);		// w = A x
+
+	vec_fuse_init(&f, N);
+
+	vec_fuse_axpy(&f, w, l2lambda, x);
+	vec_fuse_sub(&f, r, b, w);	// r = b - A x
+
+	vec_fuse_exec(vops, &f);
+
+	double rr;
+	double wr;
+
+	iter_op_call(linop, w, r);		// w = A r
+
+	vec_fuse_init(&f, N);
+
+	vec_fuse_axpy(&f, w, l2lambda, r);
+	vec_fuse_dot(&f, &rr, r, r);
+	vec_fuse_dot(&f, &wr, w, r);
+
+	vec_fuse_exec(vops, &f);
+
+	float gamma = rr;
+	float delta = wr;
+	float gamma_old = gamma;
+	float alpha = 0.;
+
+	float eps_squared = pow(epsilon, 2.);
+
+
+	unsigned int i = 0;
+
+	if (0. == gamma) {
+
+		debug_printf(DP_DEBUG3, "CG: early out\n");
+		goto cleanup;
+	}
+
+	for (i = 0; i < maxiter; i++) {
+
+		iter_monitor(monitor, vops, x);
+
+		debug_printf(DP_DEBUG3, "#%d: %f\n", i, (double)sqrtf(gamma));
+
+		float beta = (0 == i) ? 0. : (gamma / gamma_old);
+		float pAp = (0 == i) ? delta : (delta - beta * gamma / alpha);	// p^T A p
+
+		if (0. == pAp)
+			break;
+
+		alpha = gamma / pAp;
+
+		vec_fuse_init(&f, N);
+
+		if (0 == i) {
+
+			vec_fuse_copy(&f, p, r);
+			vec_fuse_copy(&f, s, w);
+
+		} else {
+
+			vec_fuse_xpay(&f, beta, p, r);	// p = beta * p + r
+			vec_fuse_xpay(&f, beta, s, w);	// s = beta * s + w = A p
+		}
+
+		vec_fuse_axpy(&f, x, +alpha, p);
+		vec_fuse_axpy(&f, r, -alpha, s);
+
+		vec_fuse_exec(vops, &f);
+
+		iter_op_call(linop, w, r);	// w = A r
+
+		vec_fuse_init(&f, N);
+
+		vec_fuse_axpy(&f, w, l2lambda, r);
+		vec_fuse_dot(&f, &rr, r, r);
+		vec_fuse_dot(&f, &wr, w, r);
+
+		vec_fuse_exec(vops, &f);
+
+		gamma_old = gamma;
+		gamma = rr;
+		delta = wr;
+
+		if (gamma <= eps_squared)
+			break;
+	}
+
+cleanup:
+	vops->del(s);
+	vops->del(p);
+	vops->del(w);
+	vops->del(r);
+
+	debug_printf(DP_DEBUG2, "\t cg: %3d\n", i);
+
+	return sqrtf(gamma);
+}
+
+
+
 
 
 /**
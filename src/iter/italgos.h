@@ -98,6 +98,23 @@ float conjgrad(unsigned int maxiter, float l2lambda, float epsilon,
 	float* x, const float* b,
 	struct iter_monitor_s* monitor);
 
+enum vec_storage;
+
+float conjgrad2(unsigned int maxiter, float l2lambda, float epsilon,
+	long N,
+	const struct vec_iter_s* vops,
+	enum vec_storage storage,
+	struct iter_op_s linop,
+	float* x, const float* b,
+	struct iter_monitor_s* monitor);
+
+float conjgrad_pipelined(unsigned int maxiter, float l2lambda, float epsilon,
+	long N,
+	const struct vec_iter_s* vops,
+	struct iter_op_s linop,
+	float* x, const float* b,
+	struct iter_monitor_s* monitor);
+
 
 void landweber(unsigned int maxiter, float epsilon, float alpha,
 	long N, long M,
@@ -54,6 +54,9 @@ const struct iter_conjgrad_conf iter_conjgrad_defaults = {
 	.maxiter = 50,
 	.l2lambda = 0.,
 	.tol = 0.,
+
+	.storage = VEC_FP32,
+	.pipelined = false,
 };
 
 const struct iter_landweber_conf iter_landweber_defaults = {
@@ -118,6 +121,8 @@ const struct iter_admm_conf iter_admm_defaults = {
 	.tau = 2.,
 	.tau_max = 20,
 	.mu = 3,
+
+	.storage = VEC_FP32,
 };
 
 
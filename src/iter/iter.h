@@ -12,6 +12,8 @@ struct operator_p_s;
 
 #include "misc/types.h"
 
+#include "num/vecfuse.h"
+
 #ifndef ITER_CONF_S
 #define ITER_CONF_S
 typedef struct iter_conf_s { TYPEID* TYPEID; float alpha; } iter_conf;
@@ -36,6 +38,9 @@ struct iter_conjgrad_conf {
 	unsigned int maxiter;
 	float l2lambda;
 	float tol;
+
+	enum vec_storage storage;	// residual (standard variant)
+	_Bool pipelined;		// single reduction per iteration
 };
 
 
@@ -117,6 +122,8 @@ struct iter_admm_conf {
 	float cg_eps;
 
 	_Bool fast;
+
+	enum vec_storage storage;
 };
 
 
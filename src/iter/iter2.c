@@ -151,8 +151,12 @@ void iter2_conjgrad(const iter_conf* _conf,
 	if (checkeps(eps))
 		goto cleanup;
 
-	conjgrad(conf->maxiter, conf->INTERFACE.alpha * conf->l2lambda, eps * conf->tol, size, select_vecops(image_adj),
-			OPERATOR2ITOP(normaleq_op), image, image_adj, monitor);
+	if (conf->pipelined)
+		conjgrad_pipelined(conf->maxiter, conf->INTERFACE.alpha * conf->l2lambda, eps * conf->tol, size, select_vecops(image_adj),
+				OPERATOR2ITOP(normaleq_op), image, image_adj, monitor);
+	else
+		conjgrad2(conf->maxiter, conf->INTERFACE.alpha * conf->l2lambda, eps * conf->tol, size, select_vecops(image_adj),
+				conf->storage, OPERATOR2ITOP(normaleq_op), image, image_adj, monitor);
 
 cleanup:
 	;
@@ -415,6 +419,7 @@ void iter2_admm(const iter_conf* _conf,
 		.mu = conf->mu,
 		.fast = conf->fast,
 		.biases = biases,
+		.storage = conf->storage,
 	};
 
 
@@ -1,5 +1,7 @@
+#include <assert.h>
 
 #include "num/vecops.h"
+#include "num/vecfuse.h"
 #include "num/gpuops.h"
 
 #include "misc/misc.h"
@@ -23,3 +25,61 @@ const struct vec_iter_s* select_vecops(const float* x)
 #endif
 }
 
+
+
+/*
+ * Execute a recorded sequence of vector operations. On the CPU the
+ * sequence is fused into one pass, otherwise the operations are
+ * applied one after another.
+ */
+void vec_fuse_exec(const struct vec_iter_s* vops, const struct vec_fuse_s* f)
+{
+	if (&cpu_iter_ops == vops) {
+
+		vec_fuse_cpu(f);
+		return;
+	}
+
+	assert(0 == f->S);
+
+	long N = f->N;
+
+	for (int k = 0; k < f->K; k++) {
+
+		const struct vec_fop_s* o = &f->ops[k];
+
+		switch (o->op) {
+
+		case VEC_FOP_COPY: vops->copy(N, o->a, o->x); break;
+		case VEC_FOP_SWAP: vops->swap(N, o->a, (float*)o->x); break;
+		case VEC_FOP_SMUL: vops->smul(N, o->alpha, o->a, o->x); break;
+		case VEC_FOP_AXPY: vops->axpy(N, o->a, o->alpha, o->x); break;
+		case VEC_FOP_XPAY: vops->xpay(N, o->alpha, o->a, o->x); break;
+		case VEC_FOP_ADD: vops->add(N, o->a, o->x, o->y); break;
+		case VEC_FOP_SUB: vops->sub(N, o->a, o->x, o->y); break;
+		case VEC_FOP_DOT: *o->result = vops->dot(N, o->x, o->y); break;
+		}
+	}
+}
+
+
+
+/*
+ * Vectors in reduced precision are only supported on the CPU,
+ * elsewhere single precision is used.
+ */
+enum vec_storage vec_storage_select(const struct vec_iter_s* vops, enum vec_storage st)
+{
+	return (&cpu_iter_ops == vops) ? st : VEC_FP32;
+}
+
+
+/*
+ * Allocate a vector of N floats in storage format st. Vectors
+ * in reduced precision can only be used with vec_fuse_storage
+ * and released with vops->del.
+ */
+float* vec_storage_allocate(const struct vec_iter_s* vops, enum vec_storage st, long N)
+{
+	return vops->allocate(vec_storage_length(vec_storage_select(vops, st), N));
+}
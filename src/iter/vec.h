@@ -41,6 +41,13 @@ extern const struct vec_iter_s cpu_iter_ops;
 
 extern const struct vec_iter_s* select_vecops(const float* x);
 
+struct vec_fuse_s;
+extern void vec_fuse_exec(const struct vec_iter_s* vops, const struct vec_fuse_s* f);
+
+enum vec_storage;
+extern enum vec_storage vec_storage_select(const struct vec_iter_s* vops, enum vec_storage st);
+extern float* vec_storage_allocate(const struct vec_iter_s* vops, enum vec_storage st, long N);
+
 
 #endif
 
@@ -8,19 +8,27 @@
  *	2016 Martin Uecker <martin.uecker@med.uni-goettingen.de>
  */
 
+#define _GNU_SOURCE
 #include <math.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+#ifdef _WIN32
+#include "win/rand_r.h"
+#endif
 
 #include "misc/misc.h"
 
 #include "num/blas.h"
 #include "num/lapack.h"
 #include "num/linalg.h"
+#include "num/eig-batch.h"
 
 #include "batchsvd.h"
 
 
 
-void batch_svthresh(long M, long N, long num_blocks, float lambda, complex float dst[num_blocks][N][M])
+static void batch_svthresh_lapack(long M, long N, long num_blocks, float lambda, complex float dst[num_blocks][N][M])
 {
 #pragma omp parallel
     {
@@ -83,3 +91,324 @@ void batch_svthresh(long M, long N, long num_blocks, float lambda, complex float
     } // #pragma omp parallel
 }
 
+
+/*
+ * Singular value thresholding using the eigen decomposition of the
+ * smaller Gram matrix G, which is computed for groups of blocks with
+ * the batched eigensolver. With G = A^H A = V S^2 V^H, the result is
+ * A V diag(max(0, 1 - lambda / s)) V^H (and analogous for A A^H).
+ * G is computed and decomposed in double precision, as squaring the
+ * singular values would otherwise lose the small ones.
+ */
+static void batch_svthresh_gram(long M, long N, long num_blocks, float lambda, complex float dst[num_blocks][N][M])
+{
+	long K = MIN(M, N);
+
+	enum { CHUNK = 1024 };
+
+	long chunk = MIN(CHUNK, num_blocks);
+
+	complex double (*G)[chunk][K][K] = xmalloc(sizeof *G);
+	double (*val)[chunk][K] = xmalloc(sizeof *val);
+	bool (*zero)[chunk] = xmalloc(sizeof *zero);
+
+	for (long b0 = 0; b0 < num_blocks; b0 += chunk) {
+
+		long n = MIN(chunk, num_blocks - b0);
+
+#pragma omp parallel for
+		for (long b = 0; b < n; b++) {
+
+			const complex float (*A)[N][M] = &dst[b0 + b];
+
+			// upper triangle of G = A^H A or G = A A^H (column-major)
+
+			for (long j = 0; j < K; j++) {
+
+				for (long i = 0; i <= j; i++) {
+
+					complex double sum = 0.;
+
+					if (N <= M) {
+
+						for (long m = 0; m < M; m++)
+							sum += conj((*A)[i][m]) * (*A)[j][m];
+
+					} else {
+
+						for (long l = 0; l < N; l++)
+							sum += (*A)[l][i] * conj((*A)[l][j]);
+					}
+
+					(*G)[b][j][i] = sum;
+					(*G)[b][i][j] = conj(sum);
+				}
+			}
+
+			// lambda_max(G) <= max_i sum_j |G_ij|
+
+			double s_upperbound = 0.;
+
+			for (long i = 0; i < K; i++) {
+
+				double s = 0.;
+
+				for (long j = 0; j < K; j++)
+					s += cabs((*G)[b][j][i]);
+
+				s_upperbound = MAX(s_upperbound, s);
+			}
+
+			(*zero)[b] = (s_upperbound < lambda * lambda);
+		}
+
+		batch_eig_double(K, n, *val, *G);
+
+#pragma omp parallel for
+		for (long b = 0; b < n; b++) {
+
+			complex float (*A)[N][M] = &dst[b0 + b];
+
+			if ((*zero)[b]) {
+
+				mat_zero(N, M, *A);
+				continue;
+			}
+
+			// P = V diag(max(0, 1 - lambda / s)) V^H (column-major)
+
+			complex float (*P)[K][K] = xmalloc(sizeof *P);
+
+			for (long i = 0; i < K; i++)
+				for (long j = 0; j < K; j++)
+					(*P)[j][i] = 0.;
+
+			for (long k = 0; k < K; k++) {
+
+				double s = sqrt(MAX(0., (*val)[b][k]));
+
+				if (s <= lambda)
+					continue;
+
+				double f = 1. - lambda / s;
+
+				for (long j = 0; j < K; j++)
+					for (long i = 0; i < K; i++)
+						(*P)[j][i] += f * (*G)[b][k][i] * conj((*G)[b][k][j]);
+			}
+
+			complex float (*T)[N][M] = xmalloc(sizeof *T);
+
+			mat_copy(N, M, *T, *A);
+
+			if (N <= M)
+				blas_matrix_multiply(M, N, N, *A, *T, *P);
+			else
+				blas_matrix_multiply(M, N, M, *A, *P, *T);
+
+			xfree(T);
+			xfree(P);
+		}
+	}
+
+	xfree(G);
+	xfree(val);
+	xfree(zero);
+}
+
+
+void batch_svthresh(long M, long N, long num_blocks, float lambda, complex float dst[num_blocks][N][M])
+{
+	if (MIN(M, N) <= EIG_BATCH_MAX)
+		batch_svthresh_gram(M, N, num_blocks, lambda, dst);
+	else
+		batch_svthresh_lapack(M, N, num_blocks, lambda, dst);
+}
+
+
+
+
+const struct batch_svd_conf_s batch_svd_conf_defaults = {
+
+	.rank = 0,
+	.oversampling = 5,
+	.power_iter = 1,
+	.warmstart = false,
+};
+
+
+/*
+ * Orthonormalize the columns of Q with modified Gram-Schmidt. This is
+ * done twice for numerical stability. Columns which are (numerically)
+ * linearly dependent on previous columns are set to zero.
+ */
+static void orthonormalize(long M, long L, complex float Q[L][M])
+{
+	for (int k = 0; k < 2; k++) {
+
+		for (long i = 0; i < L; i++) {
+
+			float n0 = sqrtf(crealf(vec_dot(M, Q[i], Q[i])));
+
+			for (long j = 0; j < i; j++)
+				vec_saxpy(M, Q[i], -vec_dot(M, Q[i], Q[j]), Q[j]);
+
+			float n = sqrtf(crealf(vec_dot(M, Q[i], Q[i])));
+
+			float sc = (n > 1.E-5 * n0) ? (1. / n) : 0.;
+
+			for (long m = 0; m < M; m++)
+				Q[i][m] *= sc;
+		}
+	}
+}
+
+
+/*
+ * Singular value thresholding of a single block with a randomized SVD:
+ * the range of A is approximated by the span of A Omega with L columns
+ * (refined with power iterations) and the SVD is computed for the
+ * projection of A onto this subspace.
+ *
+ * Returns the number of singular values above the threshold or -1
+ * if all L singular values are above the threshold, i.e. if the
+ * subspace might be too small.
+ *
+ * Halko N, Martinsson PG, Tropp JA. Finding structure with randomness:
+ * Probabilistic algorithms for constructing approximate matrix
+ * decompositions. SIAM Review 2011;53:217-288.
+ */
+static long rsvthresh(long M, long N, long L, int power_iter, float lambda, complex float A[N][M], const complex float Omega[L][N], complex float V[L][N])
+{
+	complex float (*Q)[L][M] = xmalloc(sizeof *Q);
+	complex float (*W)[L][M] = xmalloc(sizeof *W);
+	complex float (*Z)[L][N] = xmalloc(sizeof *Z);
+	complex float (*B)[N][L] = xmalloc(sizeof *B);
+	complex float (*U)[L][L] = xmalloc(sizeof *U);
+	complex float (*VT)[N][L] = xmalloc(sizeof *VT);
+	float (*S)[L] = xmalloc(sizeof *S);
+
+	// Q = orth(A Omega)
+
+	blas_matrix_multiply(M, L, N, *Q, A, Omega);
+	orthonormalize(M, L, *Q);
+
+	for (int i = 0; i < power_iter; i++) {
+
+		// Z = orth(A^H Q), Q = orth(A Z)
+
+		blas_cgemm('C', 'N', N, L, M, 1., M, &A[0][0], M, &(*Q)[0][0], 0., N, &(*Z)[0][0]);
+		orthonormalize(N, L, *Z);
+
+		blas_matrix_multiply(M, L, N, *Q, A, *Z);
+		orthonormalize(M, L, *Q);
+	}
+
+	// B = Q^H A
+
+	blas_cgemm('C', 'N', L, N, M, 1., M, &(*Q)[0][0], M, &A[0][0], 0., L, &(*B)[0][0]);
+
+	lapack_svd_econ(L, N, *U, *VT, *S, *B);
+
+	long rank = 0;
+
+	while ((rank < L) && ((*S)[rank] > lambda))
+		rank++;
+
+	if (rank < L) {
+
+		if (NULL != V)
+			for (long i = 0; i < rank; i++)
+				for (long j = 0; j < N; j++)
+					V[i][j] = conjf((*VT)[j][i]);
+
+		// soft threshold
+
+		for (long i = 0; i < L; i++)
+			for (long j = 0; j < N; j++)
+				(*VT)[j][i] *= ((*S)[i] < lambda) ? 0. : ((*S)[i] - lambda);
+
+		// A = (Q U) S VT
+
+		blas_matrix_multiply(M, L, L, *W, *Q, *U);
+		blas_matrix_multiply(M, N, L, A, *W, *VT);
+	}
+
+	xfree(Q);
+	xfree(W);
+	xfree(Z);
+	xfree(B);
+	xfree(U);
+	xfree(VT);
+	xfree(S);
+
+	return (rank < L) ? rank : -1;
+}
+
+
+/**
+ * Singular value thresholding for a batch of matrices using a
+ * randomized SVD. The size of the subspace is adapted per block:
+ * it starts with the rank found in the previous call (or conf->rank)
+ * plus oversampling and is doubled if all singular values in the
+ * subspace are above the threshold. If the subspace would exceed half
+ * of the smaller matrix dimension, the full SVD is used instead.
+ *
+ * @param rank - number of singular values above the threshold per block (in/out, may be NULL)
+ * @param basis - right singular vectors from the previous call used as start vectors (in/out, may be NULL)
+ */
+void batch_svthresh_rand(const struct batch_svd_conf_s* conf, long M, long N, long num_blocks, float lambda, complex float dst[num_blocks][N][M], long rank[num_blocks], complex float basis[num_blocks][(N > M) ? M : N][N])
+{
+	long minMN = MIN(M, N);
+
+#pragma omp parallel for
+	for (long b = 0; b < num_blocks; b++) {
+
+		long r0 = ((NULL != rank) && (0 < rank[b])) ? rank[b] : conf->rank;
+		long L = MAX(1, r0 + conf->oversampling);
+		long r = -1;
+
+		while ((-1 == r) && (2 * L <= minMN)) {
+
+			complex float (*Omega)[L][N] = xmalloc(sizeof *Omega);
+
+			// start with the previous singular subspace, if available
+
+			long k = 0;
+
+			if ((NULL != basis) && (NULL != rank))
+				for (; k < MIN(L, rank[b]); k++)
+					for (long j = 0; j < N; j++)
+						(*Omega)[k][j] = basis[b][k][j];
+
+			// the previous subspace replaces the power iterations
+
+			int power_iter = (0 < k) ? 0 : conf->power_iter;
+
+			unsigned int seed = b + 1;
+
+			for (; k < L; k++)
+				for (long j = 0; j < N; j++)
+					(*Omega)[k][j] = (rand_r(&seed) / (float)RAND_MAX - 0.5)
+							+ 1.i * (rand_r(&seed) / (float)RAND_MAX - 0.5);
+
+			r = rsvthresh(M, N, L, power_iter, lambda, dst[b], *Omega, (NULL != basis) ? basis[b] : NULL);
+
+			xfree(Omega);
+
+			L *= 2;
+		}
+
+		if (-1 == r) {
+
+			batch_svthresh(M, N, 1, lambda, &dst[b]);
+
+			// start again with a small subspace next time
+
+			r = 0;
+		}
+
+		if (NULL != rank)
+			rank[b] = r;
+	}
+}
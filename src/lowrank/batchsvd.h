@@ -1,6 +1,17 @@
 
 #include <complex.h>
 
+struct batch_svd_conf_s {
+
+	long rank;		// initial rank for the randomized SVD (0: full SVD)
+	long oversampling;
+	int power_iter;
+	_Bool warmstart;
+};
+
+extern const struct batch_svd_conf_s batch_svd_conf_defaults;
+
 extern void batch_svthresh(long M, long N, long num_blocks, float lambda, complex float dst[num_blocks][N][M]);
+extern void batch_svthresh_rand(const struct batch_svd_conf_s* conf, long M, long N, long num_blocks, float lambda, complex float dst[num_blocks][N][M], long rank[num_blocks], complex float basis[num_blocks][(N > M) ? M : N][N]);
 
 
@@ -57,13 +57,25 @@ struct lrthresh_data_s {
 	long blkdims[MAX_LEV][DIMS];
 
 	bool overlapping_blocks;
+
+	struct batch_svd_conf_s svd_conf;
+	struct lrthresh_svd_state_s* svd_state;
+};
+
+// ranks and singular subspaces per block from the previous application
+
+struct lrthresh_svd_state_s {
+
+	long num_blocks[MAX_LEV];
+	long* rank[MAX_LEV];
+	complex float* basis[MAX_LEV];
 };
 
 static DEF_TYPEID(lrthresh_data_s);
 
 
 
-static struct lrthresh_data_s* lrthresh_create_data(const long dims_decom[DIMS], bool randshift, unsigned long mflags, const long blkdims[MAX_LEV][DIMS], float lambda, bool noise, int remove_mean, bool overlapping_blocks);
+static struct lrthresh_data_s* lrthresh_create_data(const long dims_decom[DIMS], bool randshift, unsigned long mflags, const long blkdims[MAX_LEV][DIMS], float lambda, bool noise, int remove_mean, bool overlapping_blocks, const struct batch_svd_conf_s* svd_conf);
 static void lrthresh_free_data(const operator_data_t* data);
 static void lrthresh_apply(const operator_data_t* _data, float lambda, complex float* dst, const complex float* src);
 
@@ -80,7 +92,19 @@ static void lrthresh_apply(const operator_data_t* _data, float lambda, complex f
  */
 const struct operator_p_s* lrthresh_create(const long dims_lev[DIMS], bool randshift, unsigned long mflags, const long blkdims[MAX_LEV][DIMS], float lambda, bool noise, int remove_mean, bool overlapping_blocks)
 {
-	struct lrthresh_data_s* data = lrthresh_create_data(dims_lev, randshift, mflags, blkdims, lambda, noise, remove_mean, overlapping_blocks);
+	return lrthresh_create2(dims_lev, randshift, mflags, blkdims, lambda, noise, remove_mean, overlapping_blocks, &batch_svd_conf_defaults);
+}
+
+
+/**
+ * Intialize lrthresh operator with a selectable SVD
+ *
+ * @param svd_conf - use a randomized SVD if svd_conf->rank > 0
+ *
+ */
+const struct operator_p_s* lrthresh_create2(const long dims_lev[DIMS], bool randshift, unsigned long mflags, const long blkdims[MAX_LEV][DIMS], float lambda, bool noise, int remove_mean, bool overlapping_blocks, const struct batch_svd_conf_s* svd_conf)
+{
+	struct lrthresh_data_s* data = lrthresh_create_data(dims_lev, randshift, mflags, blkdims, lambda, noise, remove_mean, overlapping_blocks, svd_conf);
 
 	return operator_p_create(DIMS, dims_lev, DIMS, dims_lev, CAST_UP(data), lrthresh_apply, lrthresh_free_data);
 }
@@ -96,7 +120,7 @@ const struct operator_p_s* lrthresh_create(const long dims_lev[DIMS], bool rands
  * @param blkdims - contains block dimensions for all levels
  *
  */
-static struct lrthresh_data_s* lrthresh_create_data(const long dims_decom[DIMS], bool randshift, unsigned long mflags, const long blkdims[MAX_LEV][DIMS], float lambda, bool noise, int remove_mean, bool overlapping_blocks)
+static struct lrthresh_data_s* lrthresh_create_data(const long dims_decom[DIMS], bool randshift, unsigned long mflags, const long blkdims[MAX_LEV][DIMS], float lambda, bool noise, int remove_mean, bool overlapping_blocks, const struct batch_svd_conf_s* svd_conf)
 {
 	PTR_ALLOC(struct lrthresh_data_s, data);
 	SET_TYPEID(lrthresh_data_s, data);
@@ -109,6 +133,27 @@ static struct lrthresh_data_s* lrthresh_create_data(const long dims_decom[DIMS],
 
 	data->overlapping_blocks = overlapping_blocks;
 
+	data->svd_conf = *svd_conf;
+
+	// the state is stored per block, which moves with random shifts
+
+	if (randshift && data->svd_conf.warmstart) {
+
+		debug_printf(DP_WARN, "LLR warm start disabled with random shifts.\n");
+		data->svd_conf.warmstart = false;
+	}
+
+	PTR_ALLOC(struct lrthresh_svd_state_s, svd_state);
+
+	for (int l = 0; l < MAX_LEV; l++) {
+
+		(*svd_state).num_blocks[l] = 0;
+		(*svd_state).rank[l] = NULL;
+		(*svd_state).basis[l] = NULL;
+	}
+
+	data->svd_state = PTR_PASS(svd_state);
+
 	// level dimensions
 	md_copy_dims(DIMS, data->dims_decom, dims_decom);
 	md_calc_strides(DIMS, data->strs_lev, dims_decom, CFL_SIZE);
@@ -135,7 +180,72 @@ static struct lrthresh_data_s* lrthresh_create_data(const long dims_decom[DIMS],
  */
 static void lrthresh_free_data(const operator_data_t* _data)
 {
-	xfree(CAST_DOWN(lrthresh_data_s, _data));
+	auto data = CAST_DOWN(lrthresh_data_s, _data);
+
+	for (int l = 0; l < MAX_LEV; l++) {
+
+		xfree(data->svd_state->rank[l]);
+		xfree(data->svd_state->basis[l]);
+	}
+
+	xfree(data->svd_state);
+	xfree(data);
+}
+
+
+
+/*
+ * Singular value thresholding with the randomized SVD. The ranks and
+ * subspaces of the previous application are reused as start values.
+ * If the operator is applied concurrently (e.g. in batch mode), only
+ * one application can own the state and the others start from scratch.
+ * With random shifts, the blocks differ between applications and the
+ * state is not reused.
+ */
+static void lrthresh_svthresh_rand(const struct lrthresh_data_s* data, int l, long M, long N, long num_blocks, float lambda, complex float* mat)
+{
+	struct lrthresh_svd_state_s* state = data->svd_state;
+
+	long* rank = NULL;
+	complex float* basis = NULL;
+
+#pragma omp critical (lrthresh_svd_state)
+	if (!data->randshift && (state->num_blocks[l] == num_blocks)) {
+
+		rank = state->rank[l];
+		basis = state->basis[l];
+
+		state->rank[l] = NULL;
+		state->basis[l] = NULL;
+	}
+
+	if (NULL == rank) {
+
+		rank = xmalloc((size_t)num_blocks * sizeof(long));
+
+		for (long b = 0; b < num_blocks; b++)
+			rank[b] = 0;
+
+		if (data->svd_conf.warmstart)
+			basis = xmalloc((size_t)(num_blocks * MIN(M, N) * N) * CFL_SIZE);
+	}
+
+	batch_svthresh_rand(&data->svd_conf, M, N, num_blocks, lambda, *(complex float (*)[num_blocks][N][M])mat,
+			rank, (void*)basis);
+
+#pragma omp critical (lrthresh_svd_state)
+	if (NULL == state->rank[l]) {
+
+		state->num_blocks[l] = num_blocks;
+		state->rank[l] = rank;
+		state->basis[l] = basis;
+
+		rank = NULL;
+		basis = NULL;
+	}
+
+	xfree(rank);
+	xfree(basis);
 }
 
 
@@ -253,7 +363,10 @@ static void lrthresh_apply(const operator_data_t* _data, float mu, complex float
 
 		debug_printf(DP_DEBUG4, "M=%d, N=%d, B=%d, num_blocks=%d, img_size=%d, blk_size=%d\n", M, N, B, num_blocks, img_size, blk_size);
 
-		batch_svthresh(M, N, num_blocks, lambda * GWIDTH(M, N, B), *(complex float (*)[mat2_dims[1]][M][N])tmp_mat2);
+		if (0 < data->svd_conf.rank)
+			lrthresh_svthresh_rand(data, l, M, N, num_blocks, lambda * GWIDTH(M, N, B), tmp_mat2);
+		else
+			batch_svthresh(M, N, num_blocks, lambda * GWIDTH(M, N, B), *(complex float (*)[mat2_dims[1]][M][N])tmp_mat2);
 		//	for ( int b = 0; b < mat_dims[1]; b++ )
 		//	svthresh(M, N, lambda * GWIDTH(M, N, B), tmp_mat, tmp_mat);
 
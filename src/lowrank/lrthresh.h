@@ -13,10 +13,12 @@
 #endif
 
 struct operator_p_s;
+struct batch_svd_conf_s;
 
 
 // Low rank thresholding for arbitrary block sizes
 extern const struct operator_p_s* lrthresh_create(const long dims_lev[DIMS], _Bool randshift, unsigned long mflags, const long blkdims[MAX_LEV][DIMS], float lambda, _Bool noise, int remove_mean, _Bool overlapping_blocks);
+extern const struct operator_p_s* lrthresh_create2(const long dims_lev[DIMS], _Bool randshift, unsigned long mflags, const long blkdims[MAX_LEV][DIMS], float lambda, _Bool noise, int remove_mean, _Bool overlapping_blocks, const struct batch_svd_conf_s* svd_conf);
 
 // Returns nuclear norm using lrthresh operator
 extern float lrnucnorm(const struct operator_p_s* op, const complex float* src);
@@ -104,7 +104,7 @@ static void io_register(const char* name, bool output, bool input, bool open)
 			new = false;
 			if (iop->open) {
 
-				if (output || iop->output)
+				if ((output || iop->output) && (FILE_TYPE_PIPE != file_type(name)))
 					debug_printf(DP_WARN, "Overwriting file: %s\n", name);
 			} else {
 
@@ -319,6 +319,45 @@ int write_cfl_header(int fd, const char* filename, int n, const long dimensions[
 }
 
 
+/**
+ * Writes a header for data which follows directly in the same stream
+ *
+ * The header is padded with zeros to IO_STREAM_HEADER_SIZE bytes,
+ * so that the reader does not have to wait for the end of the
+ * stream and can consume the data while it is produced.
+ */
+int write_stream_header(int fd, int n, const long dimensions[n])
+{
+	char header[IO_STREAM_HEADER_SIZE] = { 0 };
+	size_t max = sizeof(header) - 1;
+	size_t pos = 0;
+
+	pos += snprintf(header, max, "# Dimensions\n");
+
+	for (int i = 0; (i < n) && (pos < max); i++)
+		pos += snprintf(header + pos, max - pos, "%ld ", dimensions[i]);
+
+	if (pos < max)
+		pos += snprintf(header + pos, max - pos, "\n# Data\n-\n");
+
+	if (pos >= max)
+		return -1;
+
+	// optional information is dropped if it does not fit
+
+	if ((NULL != command_line) && (pos + strlen(command_line) + 12 < max))
+		pos += snprintf(header + pos, max - pos, "# Command\n%s\n", command_line);
+
+	if (pos + strlen(bart_version) + 16 < max)
+		pos += snprintf(header + pos, max - pos, "# Creator\nBART %s\n", bart_version);
+
+	if ((ssize_t)sizeof(header) != write(fd, header, sizeof(header)))
+		return -1;
+
+	return 0;
+}
+
+
 
 int read_cfl_header(int fd, char** file, int n, long dimensions[n])
 {
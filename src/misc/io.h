@@ -2,6 +2,8 @@
 #include "misc/cppwrap.h"
 
 
+#define IO_STREAM_HEADER_SIZE 4096
+
 enum file_types_e {
 	FILE_TYPE_CFL, FILE_TYPE_RA, FILE_TYPE_COO, FILE_TYPE_SHM, FILE_TYPE_PIPE, FILE_TYPE_MEM,
 };
@@ -15,6 +17,7 @@ extern int write_coo(int fd, int n, const long dimensions[__VLA(n)]);
 extern int read_coo(int fd, int n, long dimensions[__VLA(n)]);
 
 extern int write_cfl_header(int fd, const char* filename, int n, const long dimensions[__VLA(n)]);
+extern int write_stream_header(int fd, int n, const long dimensions[__VLA(n)]);
 extern int read_cfl_header(int fd, char** file, int D, long dimensions[__VLA(D)]);
 
 extern int write_multi_cfl_header(int fd, const char* filename, long num_ele, int D, int n[D], const long* dimensions[D]);
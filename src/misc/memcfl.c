@@ -45,8 +45,25 @@ void memcfl_register(const char* name, int D, const long dims[D], complex float*
 	memcfl_list = PTR_PASS(mem);
 }
 
+static struct memcfl* memcfl_find(const char* name)
+{
+	struct memcfl* mem = memcfl_list;
+
+	while ((NULL != mem) && (0 != strcmp(mem->name, name)))
+		mem = mem->next;
+
+	return mem;
+}
+
 complex float* memcfl_create(const char* name, int D, const long dims[D])
 {
+	// replace old data unless it is still in use
+
+	struct memcfl* old = memcfl_find(name);
+
+	if ((NULL != old) && (0 == old->refcount))
+		memcfl_unlink(name);
+
 	complex float* data = xmalloc(io_calc_size(D, dims, sizeof(complex float)));
 	memcfl_register(name, D, dims, data, true);
 	return data;
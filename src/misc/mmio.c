@@ -248,35 +248,123 @@ complex float* create_zcoo(const char* name, int D, const long dimensions[D])
 }
 
 
-static complex float* create_pipe(int pfd, int D, const long dimensions[D])
+static bool pipe_used[2] = { false, false };
+
+static void pipe_once(bool write)
 {
-	static bool once_w = false;
+	if (pipe_used[write])
+		error(write ? "writing two inputs to pipe is not supported\n" : "reading two inputs from pipe is not supported\n");
+
+	pipe_used[write] = true;
+}
+
 
-	if (once_w)
-		error("writing two inputs to pipe is not supported\n");
+/*
+ * The shared memory segment of an output pipe is unlinked by the
+ * reader directly after opening it. The writer only removes it
+ * if the command fails.
+ */
+static char pipe_shm_name[64] = "";
 
-	once_w = true;
+/**
+ * Remove the shared memory segment of an output pipe if the
+ * command failed, and allow the next command in this process
+ * to use pipes again.
+ *
+ * @param failed the command did not complete
+ */
+void pipe_cleanup(bool failed)
+{
+	if (failed && ('\0' != pipe_shm_name[0])) {
 
-	char filename[] = "bart-XXXXXX";
+		if (0 == shm_unlink(pipe_shm_name))
+			debug_printf(DP_DEBUG1, "Removed shared memory for pipe: %s\n", pipe_shm_name);
+	}
 
-	int fd = mkstemp(filename);
+	pipe_shm_name[0] = '\0';
 
-	debug_printf(DP_DEBUG1, "Temp file for pipe: %s\n", filename);
+	pipe_used[0] = false;
+	pipe_used[1] = false;
+}
+
+
+static complex float* create_pipe_shm(char filename[64], int D, const long dimensions[D])
+{
+	// the data is passed in a shared memory segment to avoid disk I/O
+
+	static int count = 0;
+
+	snprintf(filename, 64, "/bart-%ld-%d.shm", (long)getpid(), count++);
+
+	int fd;
+
+	if (-1 == (fd = shm_open(filename, O_RDWR|O_CREAT|O_EXCL, S_IRUSR|S_IWUSR)))
+		return NULL;
 
 	long T;
+	off_t header_size;
+
+	if (   (-1 == write_ra(fd, D, dimensions))
+	    || (-1 == (T = io_calc_size(D, dimensions, sizeof(complex float))))
+	    || (-1 == (header_size = lseek(fd, 0, SEEK_CUR)))
+#ifdef __linux__
+	    // make sure the segment fits into memory
+	    || (0 != posix_fallocate(fd, 0, header_size + T))
+#endif
+	   ) {
 
-	if (-1 == (T = io_calc_size(D, dimensions, sizeof(complex float))))
-		error("temp cfl %s\n", filename);
+		close(fd);
+		shm_unlink(filename);
 
-	err_assert(T > 0);
+		return NULL;
+	}
 
 	complex float* ptr;
 
-	if (NULL == (ptr = create_data(fd, 0, T)))
-		error("temp cfl %s\n", filename);
+	strcpy(pipe_shm_name, filename);
+
+	if (NULL == (ptr = create_data(fd, header_size, T)))
+		error("shm cfl %s\n", filename);
 
 	if (-1 == close(fd))
-		io_error("temp cfl %s\n", filename);
+		io_error("shm cfl %s\n", filename);
+
+	return ptr;
+}
+
+
+static complex float* create_pipe(int pfd, int D, const long dimensions[D])
+{
+	pipe_once(true);
+
+	char filename[64];
+	complex float* ptr;
+
+	if (NULL != (ptr = create_pipe_shm(filename, D, dimensions))) {
+
+		debug_printf(DP_DEBUG1, "Shared memory for pipe: %s\n", filename);
+
+	} else {
+
+		strcpy(filename, "bart-XXXXXX");
+
+		int fd = mkstemp(filename);
+
+		debug_printf(DP_DEBUG1, "Temp file for pipe: %s\n", filename);
+
+		long T;
+
+		if (-1 == (T = io_calc_size(D, dimensions, sizeof(complex float))))
+			error("temp cfl %s\n", filename);
+
+		err_assert(T > 0);
+
+		if (NULL == (ptr = create_data(fd, 0, T)))
+			error("temp cfl %s\n", filename);
+
+		if (-1 == close(fd))
+			io_error("temp cfl %s\n", filename);
+	}
 
 	if (-1 == write_cfl_header(pfd, filename, D, dimensions))
 		error("Writing to stdout\n");
@@ -387,6 +475,94 @@ complex float* load_zcoo(const char* name, int D, long dimensions[D])
 }
 
 
+static void pipe_read_header(char** filename, int D, long dimensions[D])
+{
+	pipe_once(false);
+
+	// read header from stdin
+
+	if (-1 == read_cfl_header(0, filename, D, dimensions))
+		error("Reading input\n");
+
+	if (NULL == *filename)
+		error("No data.\n");
+}
+
+
+static void pipe_read(int fd, void* buf, size_t size)
+{
+	while (size > 0) {
+
+		ssize_t r;
+
+		if (-1 == (r = read(fd, buf, size)))
+			io_error("Reading input\n");
+
+		if (0 == r)
+			error("Reading input: unexpected end of stream\n");
+
+		buf = (char*)buf + r;
+		size -= r;
+	}
+}
+
+
+static void pipe_write(int fd, const void* buf, size_t size)
+{
+	while (size > 0) {
+
+		ssize_t r;
+
+		if (-1 == (r = write(fd, buf, size)))
+			io_error("Writing to stdout\n");
+
+		buf = (const char*)buf + r;
+		size -= r;
+	}
+}
+
+
+static complex float* load_pipe(const char* filename, int D, const long dimensions[D], bool priv)
+{
+	complex float* ret;
+
+	if (0 == strcmp("-", filename)) {
+
+		// data follows the header on stdin
+
+		ret = anon_cfl(NULL, D, dimensions);
+
+		pipe_read(0, ret, io_calc_size(D, dimensions, sizeof(complex float)));
+
+	} else if (FILE_TYPE_SHM == file_type(filename)) {
+
+		// unlink directly so that the segment does not outlive us
+
+		int fd;
+		if (-1 == (fd = shm_open(filename, O_RDONLY, 0)))
+			io_error("Loading shm file %s\n", filename);
+
+		if (0 != shm_unlink(filename))
+			error("Error unlinking shared memory segment %s\n", filename);
+
+		long dims[D];
+		ret = load_zra_internal(fd, filename, D, dims);
+
+		if (!md_check_equal_dims(D, dims, dimensions, ~0UL))
+			error("Dimensions of pipe do not match\n");
+
+	} else {
+
+		ret = (priv ? private_cfl : shared_cfl)(D, dimensions, filename);
+
+		if (0 != unlink(filename))
+			error("Error unlinking temporary file %s\n", filename);
+	}
+
+	return ret;
+}
+
+
 static complex float* load_cfl_internal(const char* name, int D, long dimensions[D], bool priv)
 {
 	UNUSED(priv);
@@ -400,22 +576,7 @@ static complex float* load_cfl_internal(const char* name, int D, long dimensions
 
 	case FILE_TYPE_PIPE:
 
-		;
-
-		static bool once_r = false;
-
-		if (once_r)
-			error("reading two inputs from pipe is not supported\n");
-
-		once_r = true;
-
-		// read header from stdin
-
-		if (-1 == read_cfl_header(0, &filename, D, dimensions))
-			error("Reading input\n");
-
-		if (NULL == filename)
-			error("No data.\n");
+		pipe_read_header(&filename, D, dimensions);
 
 		goto skip;
 
@@ -458,11 +619,12 @@ static complex float* load_cfl_internal(const char* name, int D, long dimensions
 		io_error("Loading cfl file %s\n", name);
 
 skip: ;
-	complex float* ret = (priv ? private_cfl : shared_cfl)(D, dimensions, filename ?: name_bdy);
+	complex float* ret;
 
 	if (FILE_TYPE_PIPE == type)
-		if (0 != unlink(filename))
-			error("Error unlinking temporary file %s\n", filename);
+		ret = load_pipe(filename, D, dimensions, priv);
+	else
+		ret = (priv ? private_cfl : shared_cfl)(D, dimensions, filename ?: name_bdy);
 
 	free(filename);
 
@@ -780,3 +942,551 @@ void unmap_multi_cfl(int N, int D[N], const long* dimensions[N], _Complex float*
 		io_error("unmap multi cfl 3");
 #endif
 }
+
+
+
+/*
+ * Streaming access
+ *
+ * Hyperslabs of a file are read and written with pread/pwrite
+ * instead of mapping the whole file. This works for cfl and ra
+ * files. On pipes, the data directly follows the header in the
+ * stream, so that the next command in a pipeline can start before
+ * the previous one has finished. Other types (shared memory,
+ * in-memory cfls, coo) fall back to a mapping of the full array.
+ */
+
+struct cfl_stream_s {
+
+	int D;
+	long* dims;
+
+	int fd;
+	off_t offset;		// size of header
+
+	complex float* data;	// mapped fallback or pipe buffer
+
+	bool pipe_in;
+	bool pipe_out;
+	off_t pipe_pos;		// data transferred through the pipe
+};
+
+
+static void stream_io(int fd, void* buf, size_t size, off_t off, bool write)
+{
+	while (size > 0) {
+
+		ssize_t r = write ? pwrite(fd, buf, size, off) : pread(fd, buf, size, off);
+
+		if (-1 == r)
+			io_error("stream %s\n", write ? "write" : "read");
+
+		if (0 == r)
+			error("stream read: unexpected end of file\n");
+
+		buf = (char*)buf + r;
+		size -= r;
+		off += r;
+	}
+}
+
+
+/**
+ * Streaming of cfl and ra files can be turned off with
+ * BART_STREAM=0, then all files are mapped as a whole.
+ */
+bool stream_enabled(void)
+{
+	static int enabled = -1;
+
+	if (-1 == enabled) {
+
+		enabled = 1;
+
+		const char* str;
+
+		if (NULL != (str = getenv("BART_STREAM"))) {
+
+			long val = strtol(str, NULL, 10);
+
+			if ((0 != val) && (1 != val))
+				error("BART_STREAM environment variable must be 0 or 1!\n");
+
+			enabled = val;
+		}
+	}
+
+	return (1 == enabled);
+}
+
+
+static struct cfl_stream_s* stream_alloc(int D, const long dims[D])
+{
+	PTR_ALLOC(struct cfl_stream_s, s);
+
+	s->D = D;
+	s->dims = *TYPE_ALLOC(long[D]);
+	md_copy_dims(D, s->dims, dims);
+
+	s->fd = -1;
+	s->offset = 0;
+	s->data = NULL;
+
+	s->pipe_in = false;
+	s->pipe_out = false;
+	s->pipe_pos = 0;
+
+	return PTR_PASS(s);
+}
+
+
+static void stream_check_size(int fd, const char* name, off_t size)
+{
+	struct stat st;
+
+	if (-1 == fstat(fd, &st))
+		io_error("Loading file %s\n", name);
+
+	if (size > st.st_size)
+		error("Loading file %s: file too short\n", name);
+}
+
+
+/**
+ * Open file for reading hyperslabs
+ *
+ * @param name file name
+ * @param D number of dimensions
+ * @param dims dimensions (output)
+ */
+struct cfl_stream_s* stream_load_cfl(const char* name, int D, long dims[D])
+{
+	enum file_types_e type = file_type(name);
+
+	if (FILE_TYPE_PIPE == type) {
+
+		io_register_input(name);
+
+		char* filename = NULL;
+		pipe_read_header(&filename, D, dims);
+
+		struct cfl_stream_s* s = stream_alloc(D, dims);
+
+		if (0 == strcmp("-", filename)) {
+
+			// the data is read on demand
+
+			s->data = anon_cfl(NULL, D, dims);
+			s->fd = 0;
+			s->pipe_in = true;
+
+		} else {
+
+			s->data = load_pipe(filename, D, dims, true);
+		}
+
+		free(filename);
+
+		return s;
+	}
+
+	if (((FILE_TYPE_CFL != type) && (FILE_TYPE_RA != type)) || !stream_enabled()) {
+
+		complex float* data = load_cfl(name, D, dims);
+
+		struct cfl_stream_s* s = stream_alloc(D, dims);
+		s->data = data;
+
+		return s;
+	}
+
+	io_register_input(name);
+
+	int fd;
+	off_t offset = 0;
+
+	if (FILE_TYPE_RA == type) {
+
+		if (-1 == (fd = open(name, O_RDONLY)))
+			io_error("Loading ra file %s\n", name);
+
+		if (-1 == read_ra(fd, D, dims))
+			error("Loading ra file %s\n", name);
+
+		if (-1 == (offset = lseek(fd, 0, SEEK_CUR)))
+			io_error("Loading ra file %s\n", name);
+
+	} else {
+
+		char name_bdy[1024];
+
+		if (1024 <= snprintf(name_bdy, 1024, "%s.cfl", name))
+			error("Loading cfl file %s\n", name);
+
+		char name_hdr[1024];
+
+		if (1024 <= snprintf(name_hdr, 1024, "%s.hdr", name))
+			error("Loading cfl file %s\n", name);
+
+		int hfd;
+
+		if (-1 == (hfd = open(name_hdr, O_RDONLY)))
+			io_error("Loading cfl file %s\n", name);
+
+		char* filename = NULL;
+
+		if (-1 == read_cfl_header(hfd, &filename, D, dims))
+			error("Loading cfl file %s\n", name);
+
+		if (-1 == close(hfd))
+			io_error("Loading cfl file %s\n", name);
+
+		if (-1 == (fd = open(filename ?: name_bdy, O_RDONLY)))
+			io_error("Loading cfl file %s\n", name);
+
+		free(filename);
+	}
+
+	long T;
+
+	if (-1 == (T = io_calc_size(D, dims, sizeof(complex float))))
+		error("Loading file %s\n", name);
+
+	stream_check_size(fd, name, offset + T);
+
+	struct cfl_stream_s* s = stream_alloc(D, dims);
+
+	s->fd = fd;
+	s->offset = offset;
+
+	return s;
+}
+
+
+/**
+ * Create file for writing hyperslabs
+ *
+ * Existing content of the file is kept if the size does not change.
+ *
+ * @param name file name
+ * @param D number of dimensions
+ * @param dims dimensions
+ */
+struct cfl_stream_s* stream_create_cfl(const char* name, int D, const long dims[D])
+{
+	enum file_types_e type = file_type(name);
+
+	if (FILE_TYPE_PIPE == type) {
+
+		io_register_output(name);
+
+		pipe_once(true);
+
+		if (-1 == write_stream_header(1, D, dims))
+			error("Writing to stdout\n");
+
+		struct cfl_stream_s* s = stream_alloc(D, dims);
+
+		s->data = anon_cfl(NULL, D, dims);
+		s->fd = 1;
+		s->pipe_out = true;
+
+		return s;
+	}
+
+	if (((FILE_TYPE_CFL != type) && (FILE_TYPE_RA != type)) || !stream_enabled()) {
+
+		struct cfl_stream_s* s = stream_alloc(D, dims);
+		s->data = create_cfl(name, D, dims);
+
+		return s;
+	}
+
+	io_unlink_if_opened(name);
+	io_register_output(name);
+
+	long T;
+
+	if (-1 == (T = io_calc_size(D, dims, sizeof(complex float))))
+		error("Creating file %s\n", name);
+
+	int fd;
+	off_t offset = 0;
+
+	if (FILE_TYPE_RA == type) {
+
+		if (-1 == (fd = open(name, O_RDWR|O_CREAT, S_IRUSR|S_IWUSR)))
+			io_error("Creating ra file %s\n", name);
+
+		if (-1 == write_ra(fd, D, dims))
+			error("Creating ra file %s\n", name);
+
+		if (-1 == (offset = lseek(fd, 0, SEEK_CUR)))
+			io_error("Creating ra file %s\n", name);
+
+	} else {
+
+		char name_bdy[1024];
+
+		if (1024 <= snprintf(name_bdy, 1024, "%s.cfl", name))
+			error("Creating cfl file %s\n", name);
+
+		char name_hdr[1024];
+
+		if (1024 <= snprintf(name_hdr, 1024, "%s.hdr", name))
+			error("Creating cfl file %s\n", name);
+
+		int hfd;
+
+		if (-1 == (hfd = open(name_hdr, O_RDWR|O_CREAT|O_TRUNC, S_IRUSR|S_IWUSR)))
+			io_error("Creating cfl file %s\n", name);
+
+		if (-1 == write_cfl_header(hfd, NULL, D, dims))
+			error("Creating cfl file %s\n", name);
+
+		if (-1 == close(hfd))
+			io_error("Creating cfl file %s\n", name);
+
+		if (-1 == (fd = open(name_bdy, O_RDWR|O_CREAT, 0666 /* octal */)))
+			io_error("Creating cfl file %s\n", name);
+	}
+
+	if (-1 == ftruncate(fd, offset + T))
+		io_error("Creating file %s\n", name);
+
+	struct cfl_stream_s* s = stream_alloc(D, dims);
+
+	s->fd = fd;
+	s->offset = offset;
+
+	return s;
+}
+
+
+static void stream_slab(struct cfl_stream_s* s, int D, const long slab_dims[D], const long pos[D], complex float* ptr, bool write)
+{
+	assert(D == s->D);
+
+	for (int i = 0; i < D; i++)
+		assert((0 <= pos[i]) && (pos[i] + slab_dims[i] <= s->dims[i]));
+
+	long strs[D];
+	md_calc_strides(D, strs, s->dims, sizeof(complex float));
+
+	long slab_strs[D];
+	md_calc_strides(D, slab_strs, slab_dims, sizeof(complex float));
+
+	if (NULL != s->data) {
+
+		complex float* data = &MD_ACCESS(D, strs, pos, s->data);
+
+		// byte range of the hyperslab in the array
+
+		long last[D];
+
+		for (int i = 0; i < D; i++)
+			last[i] = pos[i] + slab_dims[i] - 1;
+
+		off_t start = md_calc_offset(D, strs, pos);
+		off_t end = md_calc_offset(D, strs, last) + (off_t)sizeof(complex float);
+
+		if (s->pipe_in && (s->pipe_pos < end)) {
+
+			pipe_read(s->fd, (char*)s->data + s->pipe_pos, end - s->pipe_pos);
+			s->pipe_pos = end;
+		}
+
+		if (write && s->pipe_out) {
+
+			if (start < s->pipe_pos)
+				error("stream write: data was already sent to pipe\n");
+
+			// contiguous hyperslabs are sent directly,
+			// everything else is buffered until it is next
+
+			if ((start == s->pipe_pos) && (end - start == md_calc_size(D, slab_dims) * (off_t)sizeof(complex float))) {
+
+				pipe_write(s->fd, ptr, end - start);
+				s->pipe_pos = end;
+
+				return;
+			}
+		}
+
+		if (write)
+			md_copy2(D, slab_dims, strs, data, slab_strs, ptr, sizeof(complex float));
+		else
+			md_copy2(D, slab_dims, slab_strs, ptr, strs, data, sizeof(complex float));
+
+		return;
+	}
+
+	// the slab consists of contiguous blocks of the first k + 1 dimensions
+
+	int k = 0;
+
+	while ((k < D) && (slab_dims[k] == s->dims[k]))
+		k++;
+
+	size_t block = md_calc_size(MIN(k + 1, D), slab_dims) * sizeof(complex float);
+	unsigned long flags = (k + 1 < D) ? ~(MD_BIT(k + 1) - 1) : 0UL;
+
+	long it[D];
+	md_set_dims(D, it, 0);
+
+	do {
+		long p[D];
+
+		for (int i = 0; i < D; i++)
+			p[i] = pos[i] + it[i];
+
+		stream_io(s->fd, (char*)ptr + md_calc_offset(D, slab_strs, it), block, s->offset + md_calc_offset(D, strs, p), write);
+
+	} while (md_next(D, slab_dims, flags, it));
+}
+
+
+/**
+ * Read hyperslab
+ *
+ * @param s stream
+ * @param D number of dimensions
+ * @param slab_dims dimensions of hyperslab
+ * @param pos position of hyperslab
+ * @param dst output (contiguous)
+ */
+void stream_read_cfl(struct cfl_stream_s* s, int D, const long slab_dims[D], const long pos[D], complex float* dst)
+{
+	stream_slab(s, D, slab_dims, pos, dst, false);
+}
+
+
+/**
+ * Write hyperslab
+ *
+ * @param s stream
+ * @param D number of dimensions
+ * @param slab_dims dimensions of hyperslab
+ * @param pos position of hyperslab
+ * @param src input (contiguous)
+ */
+void stream_write_cfl(struct cfl_stream_s* s, int D, const long slab_dims[D], const long pos[D], const complex float* src)
+{
+	stream_slab(s, D, slab_dims, pos, (complex float*)src, true);
+}
+
+
+void stream_close_cfl(struct cfl_stream_s* s)
+{
+	if (s->pipe_out) {
+
+		long T = io_calc_size(s->D, s->dims, sizeof(complex float));
+
+		pipe_write(s->fd, (char*)s->data + s->pipe_pos, T - s->pipe_pos);
+	}
+
+	if (NULL != s->data)
+		unmap_cfl(s->D, s->dims, s->data);
+
+	if (!(s->pipe_in || s->pipe_out) && (-1 != s->fd) && (-1 == close(s->fd)))
+		io_error("stream close\n");
+
+	xfree(s->dims);
+	xfree(s);
+}
+
+
+static long stream_slab_size(void)
+{
+	static long slab_size = -1;
+
+	if (-1 == slab_size) {
+
+		slab_size = 1L << 24;
+
+		const char* str;
+
+		if (NULL != (str = getenv("BART_STREAM_SLAB_SIZE"))) {
+
+			long size = strtol(str, NULL, 10);
+
+			if (0 < size)
+				slab_size = size;
+			else
+				debug_printf(DP_WARN, "invalid stream slab size\n");
+		}
+	}
+
+	return slab_size;
+}
+
+
+/**
+ * Choose dimensions of hyperslabs for streaming
+ *
+ * The hyperslabs always contain the full extent of the dimensions
+ * selected by flags and of all inner dimensions. Outer dimensions
+ * are added as long as the size stays below BART_STREAM_SLAB_SIZE
+ * elements (default: 2^24). The next dimension is split into equal
+ * parts if possible.
+ *
+ * @param D number of dimensions
+ * @param slab_dims dimensions of hyperslabs (output)
+ * @param dims dimensions of array
+ * @param flags dimensions which must not be split
+ */
+void stream_slab_dims(int D, long slab_dims[D], const long dims[D], unsigned long flags)
+{
+	long max = stream_slab_size();
+
+	flags &= md_nontriv_dims(D, dims);
+
+	int d = 0;
+
+	while ((d < D) && (0 != (flags >> d)))
+		d++;
+
+	long size = md_calc_size(d, dims);
+
+	while ((d < D) && (size * dims[d] <= max))
+		size *= dims[d++];
+
+	md_singleton_dims(D, slab_dims);
+	md_copy_dims(d, slab_dims, dims);
+
+	if (d < D) {
+
+		long n = MAX(1, max / size);
+
+		while (0 != dims[d] % n)
+			n--;
+
+		slab_dims[d] = n;
+	}
+}
+
+
+/**
+ * Advance to the next hyperslab
+ *
+ * @param D number of dimensions
+ * @param dims dimensions of array
+ * @param slab_dims dimensions of hyperslab (must divide dims)
+ * @param pos position of hyperslab
+ */
+bool stream_next(int D, const long dims[D], const long slab_dims[D], long pos[D])
+{
+	for (int i = 0; i < D; i++) {
+
+		assert(0 == dims[i] % slab_dims[i]);
+
+		pos[i] += slab_dims[i];
+
+		if (pos[i] < dims[i])
+			return true;
+
+		pos[i] = 0;
+	}
+
+	return false;
+}
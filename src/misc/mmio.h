@@ -34,5 +34,18 @@ extern _Complex float* load_zra(const char* name, int D, long dims[__VLA(D)]);
 extern _Complex float* create_zshm(const char* name, int D, const long dims[__VLA(D)]);
 extern _Complex float* load_zshm(const char* name, int D, long dims[__VLA(D)]);
 
+extern void pipe_cleanup(_Bool failed);
+
+struct cfl_stream_s;
+extern struct cfl_stream_s* stream_load_cfl(const char* name, int D, long dims[__VLA(D)]);
+extern struct cfl_stream_s* stream_create_cfl(const char* name, int D, const long dims[__VLA(D)]);
+extern void stream_read_cfl(struct cfl_stream_s* s, int D, const long slab_dims[__VLA(D)], const long pos[__VLA(D)], _Complex float* dst);
+extern void stream_write_cfl(struct cfl_stream_s* s, int D, const long slab_dims[__VLA(D)], const long pos[__VLA(D)], const _Complex float* src);
+extern void stream_close_cfl(struct cfl_stream_s* s);
+
+extern _Bool stream_enabled(void);
+extern void stream_slab_dims(int D, long slab_dims[__VLA(D)], const long dims[__VLA(D)], unsigned long flags);
+extern _Bool stream_next(int D, const long dims[__VLA(D)], const long slab_dims[__VLA(D)], long pos[__VLA(D)]);
+
 
 #include "misc/cppwrap.h"
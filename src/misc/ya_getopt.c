@@ -151,7 +151,7 @@ static int ya_getopt_internal(int argc, char * const argv[], const char *optstri
     }
     if (ya_optnext == NULL) {
         const char *arg = argv[ya_optind];
-        if (*arg != '-') {
+        if ((*arg != '-') || (arg[1] == '\0')) {
             if (handle_nonopt_argv) {
                 ya_optarg = argv[optind++];
                 start = 0;
@@ -164,7 +164,7 @@ static int ya_getopt_internal(int argc, char * const argv[], const char *optstri
 
                 start = ya_optind;
                 for (i = ya_optind + 1; i < argc; i++) {
-                    if (argv[i][0] == '-') {
+                    if ((argv[i][0] == '-') && (argv[i][1] != '\0')) {
                         end = i;
                         break;
                     }
@@ -34,6 +34,7 @@
 #include "num/flpmath.h"
 #include "num/fft.h"
 #include "num/init.h"
+#include "num/ops.h"
 
 #include "noncart/nufft.h"
 #include "linops/linop.h"
@@ -87,6 +88,7 @@ int main_nlinv(int argc, char* argv[argc])
 	bool use_gpu = false;
 	float scaling = -1.;
 	bool nufft_lowmem = false;
+	const char* trace_file = NULL;
 
 	long my_img_dims[3] = { 0, 0, 0 };
 
@@ -114,6 +116,7 @@ int main_nlinv(int argc, char* argv[argc])
 		OPT_FLOAT('w', &scaling, "", "(inverse scaling of the data)"),
 		OPTL_SET(0, "lowmem", &nufft_lowmem, "Use low-mem mode of the nuFFT"),
 		OPT_VEC3('x', &my_img_dims, "x:y:z", "Explicitly specify image dimensions"),
+		OPTL_STRING(0, "graph-trace", &trace_file, "<file.json>", "export timing of operator graph nodes (Chrome trace format)"),
 	};
 
 	cmdline(&argc, argv, ARRAY_SIZE(args), args, help_str, ARRAY_SIZE(opts), opts);
@@ -121,6 +124,9 @@ int main_nlinv(int argc, char* argv[argc])
 
 	(use_gpu ? num_init_gpu : num_init)();
 
+	if (NULL != trace_file)
+		operator_plan_trace_start(trace_file);
+
 	long ksp_dims[DIMS];
 	complex float* kspace = load_cfl(ksp_file, DIMS, ksp_dims);
 
@@ -430,6 +436,8 @@ int main_nlinv(int argc, char* argv[argc])
 	unmap_cfl(DIMS, pat_dims, pattern);
 	unmap_cfl(DIMS, img_output_dims, img_output);
 
+	operator_plan_trace_stop();
+
 	double recosecs = timestamp() - start_time;
 
 	debug_printf(DP_DEBUG2, "Total time: %.2f s\n", recosecs);
@@ -11,6 +11,7 @@
 #include <complex.h>
 #include <assert.h>
 #include <string.h>
+#include <limits.h>
 
 #include "num/multind.h"
 #include "num/flpmath.h"
@@ -19,6 +20,7 @@
 
 #include "misc/nested.h"
 #include "misc/misc.h"
+#include "misc/debug.h"
 #include "misc/version.h"
 
 #ifdef USE_CUDA
@@ -36,6 +38,8 @@ float bessel_kb_beta = -1.; // = bessel_i0(beta);
 static float kb_table[kb_size_max + 1];
 static double kb_beta = -1.;
 
+static void grid_taps_select(void);
+
 static void kb_init(double beta)
 {
 	#pragma	omp critical
@@ -47,6 +51,8 @@ static void kb_init(double beta)
 
 		kb_precompute(beta, kb_size, kb_table);
 		kb_beta = beta;
+
+		grid_taps_select();
 	}
 
 	if (fabs(kb_beta - beta) / fabs(kb_beta) >= 1.E-6)
@@ -129,6 +135,275 @@ static float intlookup(int n, const float table[n + 1], float x)
 
 
 
+// separable kernel weights of one sample along one dimension
+static int grid_sample_weights(int n, float w[n], long* sti, long dims, float pos, bool periodic, float width)
+{
+	if (1 == dims) {
+
+		assert(0. == pos);
+
+		*sti = 0;
+		w[0] = intlookup(kb_size, kb_table, 0.);
+
+		return 1;
+	}
+
+	long st = (long)ceil(pos - 0.5 * width);
+	long en = (long)floor(pos + 0.5 * width);
+
+	if (!periodic) {
+
+		st = MAX(st, 0);
+		en = MIN(en, dims - 1);
+	}
+
+	if (st > en)
+		return 0;
+
+	assert(en - st < n);
+
+	for (long i = st; i <= en; i++)
+		w[i - st] = intlookup(kb_size, kb_table, fabs(((float)i - pos)) / width);
+
+	*sti = st;
+
+	return en - st + 1;
+}
+
+
+
+static void grid_sample_pos(const struct grid_conf_s* conf, const float shift[3], const long grid_dims[3], const complex float* traj, long i, float pos[3])
+{
+	pos[0] = conf->os * (creal(traj[i * 3 + 0]) + shift[0]);
+	pos[1] = conf->os * (creal(traj[i * 3 + 1]) + shift[1]);
+	pos[2] = conf->os * (creal(traj[i * 3 + 2]) + shift[2]);
+
+	pos[0] += (grid_dims[0] > 1) ? ((float)grid_dims[0] / 2.) : 0.;
+	pos[1] += (grid_dims[1] > 1) ? ((float)grid_dims[1] / 2.) : 0.;
+	pos[2] += (grid_dims[2] > 1) ? ((float)grid_dims[2] / 2.) : 0.;
+}
+
+
+/*
+ * Separable kernel taps
+ *
+ * The kernel weights are computed once per dimension and sample. If
+ * the taps along x fit into a fixed-length row of four or eight grid
+ * points without wrapping around, the row is applied with a loop of
+ * constant length which the compiler turns into vector FMAs. Versions
+ * for AVX2 and AVX-512 are selected at runtime.
+ */
+
+enum { grid_taps_max = 8 };
+
+struct grid_taps_s {
+
+	int T;			// taps along x (4 or 8)
+	int ny;
+	int nz;
+
+	long xoff;
+	long yoff[grid_taps_max];
+	long zoff[grid_taps_max];
+
+	float wx[2 * grid_taps_max];	// repeated for real and imaginary part
+	float wy[grid_taps_max];
+	float wz[grid_taps_max];
+};
+
+
+static long mod_dims(long i, long dims)
+{
+	return ((i % dims) + dims) % dims;
+}
+
+static bool grid_taps_set(struct grid_taps_s* t, const long dims[3], const int n[3], const long sti[3], int nw, const float w[3][nw])
+{
+	if ((n[1] > grid_taps_max) || (n[2] > grid_taps_max))
+		return false;
+
+	t->T = (n[0] <= 4) ? 4 : grid_taps_max;
+
+	if ((n[0] > t->T) || (sti[0] < 0) || (sti[0] + t->T > dims[0]))
+		return false;
+
+	t->ny = n[1];
+	t->nz = n[2];
+	t->xoff = sti[0];
+
+	for (int x = 0; x < t->T; x++)
+		t->wx[2 * x + 0] = t->wx[2 * x + 1] = (x < n[0]) ? w[0][x] : 0.;
+
+	for (int y = 0; y < n[1]; y++) {
+
+		t->wy[y] = w[1][y];
+		t->yoff[y] = mod_dims(sti[1] + y, dims[1]) * dims[0];
+	}
+
+	for (int z = 0; z < n[2]; z++) {
+
+		t->wz[z] = w[2][z];
+		t->zoff[z] = mod_dims(sti[2] + z, dims[2]) * dims[0] * dims[1];
+	}
+
+	return true;
+}
+
+
+// gather from a grid with channel stride cstr
+static inline __attribute__((always_inline)) void grid_tapsH_kern(int T, const struct grid_taps_s* t, unsigned int ch, long cstr, complex float val[ch], const complex float* src)
+{
+	for (unsigned int c = 0; c < ch; c++) {
+
+		float acc[2 * grid_taps_max] = { 0. };
+
+		for (int z = 0; z < t->nz; z++) {
+
+			for (int y = 0; y < t->ny; y++) {
+
+				const float* row = (const float*)(src + c * cstr + t->zoff[z] + t->yoff[y] + t->xoff);
+				float d = t->wz[z] * t->wy[y];
+
+				for (int k = 0; k < 2 * T; k++)
+					acc[k] += d * t->wx[k] * row[k];
+			}
+		}
+
+		float re = 0.;
+		float im = 0.;
+
+		for (int x = 0; x < T; x++) {
+
+			re += acc[2 * x + 0];
+			im += acc[2 * x + 1];
+		}
+
+		val[c] += re + 1.i * im;
+	}
+}
+
+// scatter into a grid with channel stride cstr (not thread-safe)
+static inline __attribute__((always_inline)) void grid_taps_kern(int T, const struct grid_taps_s* t, unsigned int ch, long cstr, complex float* dst, const complex float val[ch])
+{
+	for (unsigned int c = 0; c < ch; c++) {
+
+		float cw[2 * grid_taps_max];
+
+		for (int k = 0; k < 2 * T; k += 2) {
+
+			cw[k + 0] = crealf(val[c]) * t->wx[k + 0];
+			cw[k + 1] = cimagf(val[c]) * t->wx[k + 1];
+		}
+
+		for (int z = 0; z < t->nz; z++) {
+
+			for (int y = 0; y < t->ny; y++) {
+
+				float* row = (float*)(dst + c * cstr + t->zoff[z] + t->yoff[y] + t->xoff);
+				float d = t->wz[z] * t->wy[y];
+
+				for (int k = 0; k < 2 * T; k++)
+					row[k] += d * cw[k];
+			}
+		}
+	}
+}
+
+
+#define GRID_TAPS_DEFINE(suffix, attr)												\
+attr static void grid_tapsH_ ## suffix(const struct grid_taps_s* t, unsigned int ch, long cstr, complex float val[ch], const complex float* src)	\
+{																\
+	if (4 == t->T)														\
+		grid_tapsH_kern(4, t, ch, cstr, val, src);									\
+	else															\
+		grid_tapsH_kern(grid_taps_max, t, ch, cstr, val, src);								\
+}																\
+																\
+attr static void grid_taps_ ## suffix(const struct grid_taps_s* t, unsigned int ch, long cstr, complex float* dst, const complex float val[ch])	\
+{																\
+	if (4 == t->T)														\
+		grid_taps_kern(4, t, ch, cstr, dst, val);									\
+	else															\
+		grid_taps_kern(grid_taps_max, t, ch, cstr, dst, val);								\
+}
+
+GRID_TAPS_DEFINE(generic, )
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define GRID_TAPS_X86
+GRID_TAPS_DEFINE(avx2, __attribute__((target("avx2,fma"))))
+GRID_TAPS_DEFINE(avx512, __attribute__((target("avx512f"))))
+#endif
+
+typedef void grid_tapsH_fun_t(const struct grid_taps_s* t, unsigned int ch, long cstr, complex float val[ch], const complex float* src);
+typedef void grid_taps_fun_t(const struct grid_taps_s* t, unsigned int ch, long cstr, complex float* dst, const complex float val[ch]);
+
+static grid_tapsH_fun_t* grid_tapsH = grid_tapsH_generic;
+static grid_taps_fun_t* grid_taps = grid_taps_generic;
+
+static void grid_taps_select(void)
+{
+	const char* isa = "generic";
+
+#ifdef GRID_TAPS_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f")) {
+
+		grid_tapsH = grid_tapsH_avx512;
+		grid_taps = grid_taps_avx512;
+		isa = "avx512";
+
+	} else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+
+		grid_tapsH = grid_tapsH_avx2;
+		grid_taps = grid_taps_avx2;
+		isa = "avx2";
+	}
+#endif
+	debug_printf(DP_DEBUG3, "Gridding kernels: %s\n", isa);
+}
+
+
+static void gridH_sample(const struct grid_conf_s* conf, const complex float* traj, long i, long samples, const long grid_dims[4], long C, complex float* dst, const complex float* grid)
+{
+	float pos[3];
+	grid_sample_pos(conf, conf->shift, grid_dims, traj, i, pos);
+
+	complex float val[C];
+	for (int j = 0; j < C; j++)
+		val[j] = 0.0;
+
+	int nw = (int)ceilf(conf->width) + 1;
+	bool done = false;
+
+	if (nw <= grid_taps_max) {
+
+		float w[3][nw];
+		long sti[3];
+		int n[3];
+
+		for (int d = 0; d < 3; d++)
+			if (0 == (n[d] = grid_sample_weights(nw, w[d], &sti[d], grid_dims[d], pos[d], conf->periodic, conf->width)))
+				return;
+
+		struct grid_taps_s taps;
+
+		if (grid_taps_set(&taps, grid_dims, n, sti, nw, w)) {
+
+			grid_tapsH(&taps, C, md_calc_size(3, grid_dims), val, grid);
+			done = true;
+		}
+	}
+
+	if (!done)
+		grid_pointH(C, 3, grid_dims, pos, val, grid, conf->periodic, conf->width, kb_size, kb_table);
+
+	for (int j = 0; j < C; j++)
+		dst[j * samples + i] += val[j];
+}
+
+
 void gridH(const struct grid_conf_s* conf, const complex float* traj, const long ksp_dims[4], complex float* dst, const long grid_dims[4], const complex float* grid)
 {
 	if (grid_dims[3] != ksp_dims[3])
@@ -153,26 +428,8 @@ void gridH(const struct grid_conf_s* conf, const complex float* traj, const long
 	long samples = ksp_dims[1] * ksp_dims[2];
 
 #pragma omp parallel for
-	for(int i = 0; i < samples; i++) {
-
-		float pos[3];
-		pos[0] = conf->os * (creal(traj[i * 3 + 0]) + conf->shift[0]);
-		pos[1] = conf->os * (creal(traj[i * 3 + 1]) + conf->shift[1]);
-		pos[2] = conf->os * (creal(traj[i * 3 + 2]) + conf->shift[2]);
-
-		pos[0] += (grid_dims[0] > 1) ? ((float)grid_dims[0] / 2.) : 0.;
-		pos[1] += (grid_dims[1] > 1) ? ((float)grid_dims[1] / 2.) : 0.;
-		pos[2] += (grid_dims[2] > 1) ? ((float)grid_dims[2] / 2.) : 0.;
-
-		complex float val[C];
-		for (int j = 0; j < C; j++)
-			val[j] = 0.0;
-		
-		grid_pointH(C, 3, grid_dims, pos, val, grid, conf->periodic, conf->width, kb_size, kb_table);
-
-		for (int j = 0; j < C; j++)
-			dst[j * samples + i] += val[j];
-	}
+	for(int i = 0; i < samples; i++)
+		gridH_sample(conf, traj, i, samples, grid_dims, C, dst, grid);
 }
 
 
@@ -228,80 +485,903 @@ void grid(const struct grid_conf_s* conf, const complex float* traj, const long
 }
 
 
-static void grid2_dims(unsigned int D, const long trj_dims[D], const long ksp_dims[D], const long grid_dims[D])
+
+/*
+ * Presorted gridding
+ *
+ * The samples of a trajectory are sorted once into rectangular
+ * tiles of the grid. Each tile is gridded into a private buffer
+ * (tile plus halo) which is then added to the grid. Tiles are
+ * processed in groups of non-neighbouring tiles ("colors"), so
+ * that no atomics are needed and the result does not depend on
+ * the number of threads.
+ */
+
+enum { grid_tile_size = 8 };
+
+struct grid_bins_s {
+
+	float os;
+	float width;
+	float shift[3];
+	long grid_dims[3];
+
+	int halo;
+	long ntiles[3];
+	long ext[3];		// tile + halo
+
+	long ntraj;
+	long samples;
+
+	long* perm;		// samples sorted by tile
+	long* offsets;		// first sample of each tile
+
+	int ncolors;
+	long* color_offsets;
+	long* color_tiles;
+};
+
+
+static long tile_start(long dims, long n, long t)
 {
-	assert(D >= 4);
-	assert(md_check_compat(D - 3, ~0, grid_dims + 3, ksp_dims + 3));
-//	assert(md_check_compat(D - 3, ~(MD_BIT(0) | MD_BIT(1)), trj_dims + 3, ksp_dims + 3));
-	assert(md_check_bounds(D - 3, ~0, trj_dims + 3, ksp_dims + 3));
+	return (t * dims) / n;
+}
 
-	assert(3 == trj_dims[0]);
-	assert(1 == trj_dims[3]);
-	assert(1 == ksp_dims[0]);
+static long tile_index(long dims, long n, long i)
+{
+	long t = (i * n) / dims;
+
+	while ((t + 1 < n) && (tile_start(dims, n, t + 1) <= i))
+		t++;
+
+	while (tile_start(dims, n, t) > i)
+		t--;
+
+	return t;
 }
 
+static int tile_color(long n, long t)
+{
+	// an odd number of tiles needs a third color for periodic wrap-around
+	return ((1 < n) && (1 == n % 2) && (n - 1 == t)) ? 2 : (t % 2);
+}
 
-void grid2(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[D], const complex float* traj, const long grid_dims[D], complex float* dst, const long ksp_dims[D], const complex float* src)
+static long floor_div(long a, long b)
 {
-	grid2_dims(D, trj_dims, ksp_dims, grid_dims);
+	return (a >= 0) ? (a / b) : -((b - 1 - a) / b);
+}
 
-	long ksp_strs[D];
-	md_calc_strides(D, ksp_strs, ksp_dims, CFL_SIZE);
 
-	long trj_strs[D];
-	md_calc_strides(D, trj_strs, trj_dims, CFL_SIZE);
+// grid cell of a sample along one dimension and its periodic wrap
+static long grid_sample_cell(const struct grid_bins_s* bins, bool periodic, int d, float pos, long* wrap)
+{
+	long dims = bins->grid_dims[d];
 
-	long grid_strs[D];
-	md_calc_strides(D, grid_strs, grid_dims, CFL_SIZE);
+	*wrap = 0;
 
-	const long* ptr_grid_dims = &(grid_dims[0]);
-	const long* ptr_ksp_dims = &(ksp_dims[0]);
+	if (1 == dims)
+		return 0;
 
-	NESTED(void, nary_grid, (void* ptr[]))
-	{
-		const complex float* _trj = ptr[0];
-		complex float* _dst = ptr[1];
-		const complex float* _src = ptr[2];
+	long i = (long)floorf(pos);
 
-		grid(conf, _trj, ptr_grid_dims, _dst, ptr_ksp_dims, _src);
-	};
+	if (periodic) {
 
-	const long* strs[3] = { trj_strs + 4, grid_strs + 4, ksp_strs + 4 };
-	void* ptr[3] = { (void*)traj, (void*)dst, (void*)src };
-	unsigned long pflags = md_nontriv_dims(D - 4, grid_dims + 4);
+		*wrap = floor_div(i, dims);
+		i -= *wrap * dims;
 
-#ifdef USE_CUDA
-	if (cuda_ondevice(traj))
-		pflags = 0;
-#endif
+	} else {
 
-	md_parallel_nary(3, D - 4, ksp_dims + 4, pflags, strs, ptr, nary_grid);
+		i = MIN(MAX(i, 0), dims - 1);
+	}
+
+	return i;
 }
 
 
-void grid2H(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[D], const complex float* traj, const long ksp_dims[D], complex float* dst, const long grid_dims[D], const complex float* src)
+struct grid_bins_s* grid_bins_create(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[D], const complex float* traj, const long grid_dims[D])
 {
-	grid2_dims(D, trj_dims, ksp_dims, grid_dims);
+	assert(D >= 4);
+	assert(3 == trj_dims[0]);
+	assert(1 == trj_dims[3]);
 
-	long ksp_strs[D];
-	md_calc_strides(D, ksp_strs, ksp_dims, CFL_SIZE);
+	PTR_ALLOC(struct grid_bins_s, bins);
 
-	long trj_strs[D];
-	md_calc_strides(D, trj_strs, trj_dims, CFL_SIZE);
+	bins->os = conf->os;
+	bins->width = conf->width;
+	bins->halo = (int)ceil(0.5 * conf->width) + 1;
 
-	long grid_strs[D];
-	md_calc_strides(D, grid_strs, grid_dims, CFL_SIZE);
+	long size = MAX((long)grid_tile_size, 2 * bins->halo);
+	long tiles = 1;
+	int ncolors = 1;
 
-	long pos[D];
-	for (unsigned int i = 0; i < D; i++)
-		pos[i] = 0;
+	for (int d = 0; d < 3; d++) {
 
-	do {
-		gridH(conf, &MD_ACCESS(D, trj_strs, pos, traj),
-			ksp_dims, &MD_ACCESS(D, ksp_strs, pos, dst),
-			grid_dims, &MD_ACCESS(D, grid_strs, pos, src));
+		long dims = grid_dims[d];
 
-	} while(md_next(D, ksp_dims, (~0 ^ 15), pos));
+		bins->shift[d] = conf->shift[d];
+		bins->grid_dims[d] = dims;
+		bins->ntiles[d] = (1 == dims) ? 1 : MAX(1, dims / size);
+		bins->ext[d] = (1 == dims) ? 1 : ((dims + bins->ntiles[d] - 1) / bins->ntiles[d] + 2 * bins->halo);
+
+		tiles *= bins->ntiles[d];
+		ncolors *= (1 == bins->ntiles[d]) ? 1 : ((0 == bins->ntiles[d] % 2) ? 2 : 3);
+	}
+
+	bins->ntraj = md_calc_size(D - 4, trj_dims + 4);
+	bins->samples = trj_dims[1] * trj_dims[2];
+
+	long samples = bins->samples;
+
+	bins->perm = *TYPE_ALLOC(long[bins->ntraj * samples]);
+	bins->offsets = *TYPE_ALLOC(long[bins->ntraj * (tiles + 1)]);
+
+	bool periodic = conf->periodic;
+
+#pragma omp parallel for
+	for (long t = 0; t < bins->ntraj; t++) {
+
+		const complex float* trj = traj + t * 3 * samples;
+		long* perm = bins->perm + t * samples;
+		long* offsets = bins->offsets + t * (tiles + 1);
+
+		long* tidx = xmalloc((size_t)samples * sizeof(long));
+
+		for (long k = 0; k < tiles + 1; k++)
+			offsets[k] = 0;
+
+		for (long i = 0; i < samples; i++) {
+
+			float pos[3];
+			grid_sample_pos(conf, bins->shift, bins->grid_dims, trj, i, pos);
+
+			long ind = 0;
+
+			for (int d = 2; d >= 0; d--) {
+
+				long wrap;
+				long cell = grid_sample_cell(bins, periodic, d, pos[d], &wrap);
+
+				ind = ind * bins->ntiles[d] + tile_index(bins->grid_dims[d], bins->ntiles[d], cell);
+			}
+
+			tidx[i] = ind;
+			offsets[ind + 1]++;
+		}
+
+		for (long k = 0; k < tiles; k++)
+			offsets[k + 1] += offsets[k];
+
+		// stable counting sort
+
+		long* next = xmalloc((size_t)tiles * sizeof(long));
+
+		for (long k = 0; k < tiles; k++)
+			next[k] = offsets[k];
+
+		for (long i = 0; i < samples; i++)
+			perm[next[tidx[i]]++] = i;
+
+		xfree(next);
+		xfree(tidx);
+	}
+
+	bins->ncolors = ncolors;
+	bins->color_offsets = *TYPE_ALLOC(long[ncolors + 1]);
+	bins->color_tiles = *TYPE_ALLOC(long[tiles]);
+
+	for (int c = 0; c < ncolors + 1; c++)
+		bins->color_offsets[c] = 0;
+
+	int* tcolor = xmalloc((size_t)tiles * sizeof(int));
+
+	for (long k = 0; k < tiles; k++) {
+
+		long ind = k;
+		int color = 0;
+		int cstride = 1;
+
+		for (int d = 0; d < 3; d++) {
+
+			long n = bins->ntiles[d];
+
+			color += cstride * tile_color(n, ind % n);
+			cstride *= (1 == n) ? 1 : ((0 == n % 2) ? 2 : 3);
+			ind /= n;
+		}
+
+		tcolor[k] = color;
+		bins->color_offsets[color + 1]++;
+	}
+
+	for (int c = 0; c < ncolors; c++)
+		bins->color_offsets[c + 1] += bins->color_offsets[c];
+
+	long cnext[ncolors];
+
+	for (int c = 0; c < ncolors; c++)
+		cnext[c] = bins->color_offsets[c];
+
+	for (long k = 0; k < tiles; k++)
+		bins->color_tiles[cnext[tcolor[k]]++] = k;
+
+	xfree(tcolor);
+
+	debug_printf(DP_DEBUG2, "Gridding: %ld samples x %ld sorted into %ldx%ldx%ld tiles (%d colors).\n",
+			samples, bins->ntraj, bins->ntiles[0], bins->ntiles[1], bins->ntiles[2], ncolors);
+
+	return PTR_PASS(bins);
+}
+
+
+void grid_bins_free(const struct grid_bins_s* bins)
+{
+	if (NULL == bins)
+		return;
+
+	xfree(bins->perm);
+	xfree(bins->offsets);
+	xfree(bins->color_offsets);
+	xfree(bins->color_tiles);
+	xfree(bins);
+}
+
+
+static bool grid_bins_usable(const struct grid_bins_s* bins, const struct grid_conf_s* conf, unsigned int D, const long trj_dims[D], const long grid_dims[D], const complex float* traj)
+{
+	if (NULL == bins)
+		return false;
+
+#ifdef USE_CUDA
+	if (cuda_ondevice(traj))
+		return false;
+#else
+	UNUSED(traj);
+#endif
+
+	if ((conf->os != bins->os) || (conf->width > bins->width))
+		return false;
+
+	if (!md_check_equal_dims(3, grid_dims, bins->grid_dims, ~0UL))
+		return false;
+
+	if ((bins->samples != trj_dims[1] * trj_dims[2]) || (bins->ntraj != md_calc_size(D - 4, trj_dims + 4)))
+		return false;
+
+	// samples may move by at most one cell against the sorted position
+	for (int d = 0; d < 3; d++)
+		if (fabsf(conf->os * (conf->shift[d] - bins->shift[d])) > 1.)
+			return false;
+
+	return true;
+}
+
+
+static void grid_tile(const struct grid_conf_s* conf, const struct grid_bins_s* bins, const long* perm, long start, long end,
+		const long origin[3], complex float* buf, long blo[3], long bhi[3],
+		const complex float* traj, long C, const complex float* src)
+{
+	long samples = bins->samples;
+	long bsize = md_calc_size(3, bins->ext);
+
+	int nw = (int)ceilf(bins->width) + 1;
+
+	for (int d = 0; d < 3; d++) {
+
+		blo[d] = bins->ext[d];
+		bhi[d] = -1;
+	}
+
+	for (long k = start; k < end; k++) {
+
+		long i = perm[k];
+
+		complex float val[C];
+
+		bool skip = true;
+
+		for (int j = 0; j < C; j++) {
+
+			val[j] = src[j * samples + i];
+			skip = skip && (0. == val[j]);
+		}
+
+		if (skip)
+			continue;
+
+		float pos[3];
+		grid_sample_pos(conf, conf->shift, bins->grid_dims, traj, i, pos);
+
+		float pos0[3];
+		grid_sample_pos(conf, bins->shift, bins->grid_dims, traj, i, pos0);
+
+		float w[3][nw];
+		long sti[3];
+		int n[3];
+
+		for (int d = 0; d < 3; d++) {
+
+			long wrap;
+			grid_sample_cell(bins, conf->periodic, d, pos0[d], &wrap);
+
+			n[d] = grid_sample_weights(nw, w[d], &sti[d], bins->grid_dims[d], pos[d] - (float)(wrap * bins->grid_dims[d]), conf->periodic, conf->width);
+
+			if (0 == n[d])
+				break;
+
+			sti[d] -= origin[d];
+
+			assert((0 <= sti[d]) && (sti[d] + n[d] <= bins->ext[d]));
+
+			blo[d] = MIN(blo[d], sti[d]);
+			bhi[d] = MAX(bhi[d], sti[d] + n[d] - 1);
+		}
+
+		if ((0 == n[0]) || (0 == n[1]) || (0 == n[2]))
+			continue;
+
+		struct grid_taps_s taps;
+
+		if (grid_taps_set(&taps, bins->ext, n, sti, nw, w)) {
+
+			grid_taps(&taps, C, bsize, buf, val);
+			continue;
+		}
+
+		for (int z = 0; z < n[2]; z++) {
+
+			for (int y = 0; y < n[1]; y++) {
+
+				float dzy = w[2][z] * w[1][y];
+				long ind = ((sti[2] + z) * bins->ext[1] + (sti[1] + y)) * bins->ext[0] + sti[0];
+
+				for (int x = 0; x < n[0]; x++) {
+
+					float d = dzy * w[0][x];
+
+					for (int c = 0; c < C; c++)
+						buf[c * bsize + ind + x] += val[c] * d;
+				}
+			}
+		}
+	}
+}
+
+
+static void grid_tile_merge(const struct grid_bins_s* bins, bool periodic, const long origin[3], complex float* buf, const long blo[3], const long bhi[3], const long grid_dims[4], complex float* grid)
+{
+	long bsize = md_calc_size(3, bins->ext);
+	long gsize = md_calc_size(3, grid_dims);
+
+	for (int d = 0; d < 3; d++)
+		if (bhi[d] < blo[d])
+			return;
+
+	for (long c = 0; c < grid_dims[3]; c++) {
+
+		for (long z = blo[2]; z <= bhi[2]; z++) {
+
+			long gz = origin[2] + z;
+
+			if (periodic)
+				gz -= floor_div(gz, grid_dims[2]) * grid_dims[2];
+
+			for (long y = blo[1]; y <= bhi[1]; y++) {
+
+				long gy = origin[1] + y;
+
+				if (periodic)
+					gy -= floor_div(gy, grid_dims[1]) * grid_dims[1];
+
+				long bind = c * bsize + (z * bins->ext[1] + y) * bins->ext[0];
+				long gind = c * gsize + (gz * grid_dims[1] + gy) * grid_dims[0];
+
+				for (long x = blo[0]; x <= bhi[0]; x++) {
+
+					long gx = origin[0] + x;
+
+					if (periodic)
+						gx -= floor_div(gx, grid_dims[0]) * grid_dims[0];
+
+					assert((0 <= gx) && (gx < grid_dims[0]));
+
+					grid[gind + gx] += buf[bind + x];
+					buf[bind + x] = 0.;
+				}
+			}
+		}
+	}
+}
+
+
+static void grid_binned(const struct grid_conf_s* conf, const struct grid_bins_s* bins, long t, const complex float* traj, const long grid_dims[4], complex float* grid, const long ksp_dims[4], const complex float* src)
+{
+	if (grid_dims[3] != ksp_dims[3])
+		error("Gridding: ksp and grid are incompatible in dim 3 (%d != %d)!\n", ksp_dims[3], grid_dims[3]);
+
+	long C = ksp_dims[3];
+
+	// precompute kaiser bessel table
+	kb_init(conf->beta);
+
+	assert(1 == ksp_dims[0]);
+	assert(bins->samples == ksp_dims[1] * ksp_dims[2]);
+
+	long tiles = md_calc_size(3, bins->ntiles);
+	const long* perm = bins->perm + t * bins->samples;
+	const long* offsets = bins->offsets + t * (tiles + 1);
+
+	long bsize = md_calc_size(3, bins->ext);
+
+	for (int c = 0; c < bins->ncolors; c++) {
+
+#pragma omp parallel
+		{
+			complex float* buf = NULL;
+
+#pragma omp for schedule(dynamic)
+			for (long k = bins->color_offsets[c]; k < bins->color_offsets[c + 1]; k++) {
+
+				long tile = bins->color_tiles[k];
+
+				if (offsets[tile] == offsets[tile + 1])
+					continue;
+
+				if (NULL == buf) {
+
+					buf = xmalloc((size_t)(C * bsize) * sizeof(complex float));
+
+					for (long i = 0; i < C * bsize; i++)
+						buf[i] = 0.;
+				}
+
+				long origin[3];
+				long ind = tile;
+
+				for (int d = 0; d < 3; d++) {
+
+					long n = bins->ntiles[d];
+
+					origin[d] = (1 == bins->grid_dims[d]) ? 0 : (tile_start(bins->grid_dims[d], n, ind % n) - bins->halo);
+					ind /= n;
+				}
+
+				long blo[3];
+				long bhi[3];
+
+				grid_tile(conf, bins, perm, offsets[tile], offsets[tile + 1], origin, buf, blo, bhi, traj, C, src);
+				grid_tile_merge(bins, conf->periodic, origin, buf, blo, bhi, grid_dims, grid);
+			}
+
+			if (NULL != buf)
+				xfree(buf);
+		}
+	}
+}
+
+
+static void gridH_binned(const struct grid_conf_s* conf, const struct grid_bins_s* bins, long t, const complex float* traj, const long ksp_dims[4], complex float* dst, const long grid_dims[4], const complex float* grid)
+{
+	if (grid_dims[3] != ksp_dims[3])
+		error("Adjoint gridding: ksp and grid are incompatible in dim 3 (%d != %d)!\n", ksp_dims[3], grid_dims[3]);
+
+	long C = ksp_dims[3];
+
+	// precompute kaiser bessel table
+	kb_init(conf->beta);
+
+	assert(1 == ksp_dims[0]);
+	long samples = ksp_dims[1] * ksp_dims[2];
+
+	assert(bins->samples == samples);
+
+	long tiles = md_calc_size(3, bins->ntiles);
+	const long* perm = bins->perm + t * samples;
+	const long* offsets = bins->offsets + t * (tiles + 1);
+
+	// visit samples tile by tile for locality
+#pragma omp parallel for schedule(dynamic)
+	for (long tile = 0; tile < tiles; tile++)
+		for (long k = offsets[tile]; k < offsets[tile + 1]; k++)
+			gridH_sample(conf, traj, perm[k], samples, grid_dims, C, dst, grid);
+}
+
+
+static void grid2_dims(unsigned int D, const long trj_dims[D], const long ksp_dims[D], const long grid_dims[D])
+{
+	assert(D >= 4);
+	assert(md_check_compat(D - 3, ~0, grid_dims + 3, ksp_dims + 3));
+//	assert(md_check_compat(D - 3, ~(MD_BIT(0) | MD_BIT(1)), trj_dims + 3, ksp_dims + 3));
+	assert(md_check_bounds(D - 3, ~0, trj_dims + 3, ksp_dims + 3));
+
+	assert(3 == trj_dims[0]);
+	assert(1 == trj_dims[3]);
+	assert(1 == ksp_dims[0]);
+}
+
+
+void grid2(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[D], const complex float* traj, const long grid_dims[D], complex float* dst, const long ksp_dims[D], const complex float* src)
+{
+	grid2_dims(D, trj_dims, ksp_dims, grid_dims);
+
+	long ksp_strs[D];
+	md_calc_strides(D, ksp_strs, ksp_dims, CFL_SIZE);
+
+	long trj_strs[D];
+	md_calc_strides(D, trj_strs, trj_dims, CFL_SIZE);
+
+	long grid_strs[D];
+	md_calc_strides(D, grid_strs, grid_dims, CFL_SIZE);
+
+	const long* ptr_grid_dims = &(grid_dims[0]);
+	const long* ptr_ksp_dims = &(ksp_dims[0]);
+
+	const struct grid_bins_s* bins = grid_bins_usable(conf->bins, conf, D, trj_dims, grid_dims, traj) ? conf->bins : NULL;
+	long trj_size = md_calc_size(4, trj_dims);
+
+	NESTED(void, nary_grid, (void* ptr[]))
+	{
+		const complex float* _trj = ptr[0];
+		complex float* _dst = ptr[1];
+		const complex float* _src = ptr[2];
+
+		if (NULL != bins)
+			grid_binned(conf, bins, (_trj - traj) / trj_size, _trj, ptr_grid_dims, _dst, ptr_ksp_dims, _src);
+		else
+			grid(conf, _trj, ptr_grid_dims, _dst, ptr_ksp_dims, _src);
+	};
+
+	const long* strs[3] = { trj_strs + 4, grid_strs + 4, ksp_strs + 4 };
+	void* ptr[3] = { (void*)traj, (void*)dst, (void*)src };
+	unsigned long pflags = md_nontriv_dims(D - 4, grid_dims + 4);
+
+#ifdef USE_CUDA
+	if (cuda_ondevice(traj))
+		pflags = 0;
+#endif
+
+	md_parallel_nary(3, D - 4, ksp_dims + 4, pflags, strs, ptr, nary_grid);
+}
+
+
+void grid2H(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[D], const complex float* traj, const long ksp_dims[D], complex float* dst, const long grid_dims[D], const complex float* src)
+{
+	grid2_dims(D, trj_dims, ksp_dims, grid_dims);
+
+	long ksp_strs[D];
+	md_calc_strides(D, ksp_strs, ksp_dims, CFL_SIZE);
+
+	long trj_strs[D];
+	md_calc_strides(D, trj_strs, trj_dims, CFL_SIZE);
+
+	long grid_strs[D];
+	md_calc_strides(D, grid_strs, grid_dims, CFL_SIZE);
+
+	const struct grid_bins_s* bins = grid_bins_usable(conf->bins, conf, D, trj_dims, grid_dims, traj) ? conf->bins : NULL;
+	long trj_size = md_calc_size(4, trj_dims);
+
+	long pos[D];
+	for (unsigned int i = 0; i < D; i++)
+		pos[i] = 0;
+
+	do {
+		const complex float* _trj = &MD_ACCESS(D, trj_strs, pos, traj);
+
+		if (NULL != bins) {
+
+			gridH_binned(conf, bins, (_trj - traj) / trj_size, _trj,
+				ksp_dims, &MD_ACCESS(D, ksp_strs, pos, dst),
+				grid_dims, &MD_ACCESS(D, grid_strs, pos, src));
+
+		} else {
+
+			gridH(conf, _trj,
+				ksp_dims, &MD_ACCESS(D, ksp_strs, pos, dst),
+				grid_dims, &MD_ACCESS(D, grid_strs, pos, src));
+		}
+
+	} while(md_next(D, ksp_dims, (~0 ^ 15), pos));
+}
+
+
+
+/*
+ * Precomputed interpolation matrix
+ *
+ * The interpolation weights of all samples are stored as a sparse
+ * matrix in compressed row format (one row per sample). The
+ * transposed matrix is stored as well, so that gridding and its
+ * adjoint are both computed as gather operations without atomics.
+ */
+
+struct grid_spmat_s {
+
+	long grid_dims[3];
+	long ntraj;
+	long samples;
+
+	long* rowptr;
+	int* colind;
+	float* values;
+
+	long* colptr;
+	int* rowind;
+	float* tvalues;
+};
+
+
+static int grid_sample_row(const struct grid_conf_s* conf, const long grid_dims[3], const complex float* traj, long i, int nw, long sti[3], float w[3][nw], int n[3])
+{
+	float pos[3];
+	grid_sample_pos(conf, conf->shift, grid_dims, traj, i, pos);
+
+	for (int d = 0; d < 3; d++)
+		if (0 == (n[d] = grid_sample_weights(nw, w[d], &sti[d], grid_dims[d], pos[d], conf->periodic, conf->width)))
+			return 0;
+
+	return n[0] * n[1] * n[2];
+}
+
+
+struct grid_spmat_s* grid_spmat_create(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[D], const complex float* traj, const long grid_dims[D])
+{
+	assert(D >= 4);
+	assert(3 == trj_dims[0]);
+	assert(1 == trj_dims[3]);
+
+	// precompute kaiser bessel table
+	kb_init(conf->beta);
+
+	PTR_ALLOC(struct grid_spmat_s, spmat);
+
+	md_copy_dims(3, spmat->grid_dims, grid_dims);
+
+	spmat->ntraj = md_calc_size(D - 4, trj_dims + 4);
+	spmat->samples = trj_dims[1] * trj_dims[2];
+
+	long gsize = md_calc_size(3, grid_dims);
+	long samples = spmat->samples;
+	long rows = spmat->ntraj * samples;
+
+	assert(gsize <= INT_MAX);
+	assert(samples <= INT_MAX);
+
+	int nw = (int)ceilf(conf->width) + 1;
+
+	spmat->rowptr = *TYPE_ALLOC(long[rows + 1]);
+	spmat->rowptr[0] = 0;
+
+#pragma omp parallel for
+	for (long r = 0; r < rows; r++) {
+
+		long sti[3];
+		float w[3][nw];
+		int n[3];
+
+		spmat->rowptr[r + 1] = grid_sample_row(conf, spmat->grid_dims, traj + (r / samples) * 3 * samples, r % samples, nw, sti, w, n);
+	}
+
+	for (long r = 0; r < rows; r++)
+		spmat->rowptr[r + 1] += spmat->rowptr[r];
+
+	long nnz = spmat->rowptr[rows];
+
+	spmat->colind = xmalloc((size_t)nnz * sizeof(int));
+	spmat->values = xmalloc((size_t)nnz * sizeof(float));
+
+#pragma omp parallel for
+	for (long r = 0; r < rows; r++) {
+
+		long sti[3];
+		float w[3][nw];
+		int n[3];
+
+		if (0 == grid_sample_row(conf, spmat->grid_dims, traj + (r / samples) * 3 * samples, r % samples, nw, sti, w, n))
+			continue;
+
+		long k = spmat->rowptr[r];
+
+		for (int z = 0; z < n[2]; z++) {
+
+			long gz = (sti[2] + z) - floor_div(sti[2] + z, grid_dims[2]) * grid_dims[2];
+
+			for (int y = 0; y < n[1]; y++) {
+
+				long gy = (sti[1] + y) - floor_div(sti[1] + y, grid_dims[1]) * grid_dims[1];
+				float dzy = w[2][z] * w[1][y];
+
+				for (int x = 0; x < n[0]; x++) {
+
+					long gx = (sti[0] + x) - floor_div(sti[0] + x, grid_dims[0]) * grid_dims[0];
+
+					spmat->colind[k] = (int)((gz * grid_dims[1] + gy) * grid_dims[0] + gx);
+					spmat->values[k] = dzy * w[0][x];
+					k++;
+				}
+			}
+		}
+
+		assert(k == spmat->rowptr[r + 1]);
+	}
+
+	// transposed matrix
+
+	spmat->colptr = *TYPE_ALLOC(long[spmat->ntraj * gsize + 1]);
+	spmat->rowind = xmalloc((size_t)nnz * sizeof(int));
+	spmat->tvalues = xmalloc((size_t)nnz * sizeof(float));
+
+	for (long g = 0; g < spmat->ntraj * gsize + 1; g++)
+		spmat->colptr[g] = 0;
+
+	for (long r = 0; r < rows; r++)
+		for (long k = spmat->rowptr[r]; k < spmat->rowptr[r + 1]; k++)
+			spmat->colptr[(r / samples) * gsize + spmat->colind[k] + 1]++;
+
+	for (long g = 0; g < spmat->ntraj * gsize; g++)
+		spmat->colptr[g + 1] += spmat->colptr[g];
+
+#pragma omp parallel for
+	for (long t = 0; t < spmat->ntraj; t++) {
+
+		long* next = xmalloc((size_t)gsize * sizeof(long));
+
+		for (long g = 0; g < gsize; g++)
+			next[g] = spmat->colptr[t * gsize + g];
+
+		for (long r = t * samples; r < (t + 1) * samples; r++) {
+
+			for (long k = spmat->rowptr[r]; k < spmat->rowptr[r + 1]; k++) {
+
+				long l = next[spmat->colind[k]]++;
+
+				spmat->rowind[l] = (int)(r - t * samples);
+				spmat->tvalues[l] = spmat->values[k];
+			}
+		}
+
+		xfree(next);
+	}
+
+	debug_printf(DP_DEBUG1, "Gridding matrix: %ld non-zeros.\n", nnz);
+
+	return PTR_PASS(spmat);
+}
+
+
+void grid_spmat_free(const struct grid_spmat_s* spmat)
+{
+	if (NULL == spmat)
+		return;
+
+	xfree(spmat->rowptr);
+	xfree(spmat->colind);
+	xfree(spmat->values);
+	xfree(spmat->colptr);
+	xfree(spmat->rowind);
+	xfree(spmat->tvalues);
+	xfree(spmat);
+}
+
+
+long grid_spmat_bytes(const struct grid_spmat_s* spmat)
+{
+	long nnz = spmat->rowptr[spmat->ntraj * spmat->samples];
+	long gsize = md_calc_size(3, spmat->grid_dims);
+
+	return 2 * nnz * (long)(sizeof(int) + sizeof(float))
+		+ (spmat->ntraj * (spmat->samples + gsize) + 2) * (long)sizeof(long);
+}
+
+
+static void grid2_spmat_dims(const struct grid_spmat_s* spmat, unsigned int D, const long trj_dims[D], const long ksp_dims[D], const long grid_dims[D])
+{
+	grid2_dims(D, trj_dims, ksp_dims, grid_dims);
+
+	assert(md_check_equal_dims(3, grid_dims, spmat->grid_dims, ~0UL));
+	assert(spmat->samples == ksp_dims[1] * ksp_dims[2]);
+	assert(spmat->ntraj == md_calc_size(D - 4, trj_dims + 4));
+}
+
+
+void grid2_spmat(const struct grid_spmat_s* spmat, unsigned int D, const long trj_dims[D], const long grid_dims[D], complex float* dst, const long ksp_dims[D], const complex float* src)
+{
+	grid2_spmat_dims(spmat, D, trj_dims, ksp_dims, grid_dims);
+
+	long ksp_strs[D];
+	md_calc_strides(D, ksp_strs, ksp_dims, CFL_SIZE);
+
+	long trj_strs[D];
+	md_calc_strides(D, trj_strs, trj_dims, 1);
+
+	long grid_strs[D];
+	md_calc_strides(D, grid_strs, grid_dims, CFL_SIZE);
+
+	long C = ksp_dims[3];
+	long samples = spmat->samples;
+	long gsize = md_calc_size(3, grid_dims);
+	long trj_size = md_calc_size(4, trj_dims);
+
+	long pos[D];
+	for (unsigned int i = 0; i < D; i++)
+		pos[i] = 0;
+
+	do {
+		long t = md_calc_offset(D, trj_strs, pos) / trj_size;
+
+		const long* colptr = spmat->colptr + t * gsize;
+
+		complex float* _dst = &MD_ACCESS(D, grid_strs, pos, dst);
+		const complex float* _src = &MD_ACCESS(D, ksp_strs, pos, src);
+
+#pragma omp parallel for
+		for (long g = 0; g < gsize; g++) {
+
+			if (colptr[g] == colptr[g + 1])
+				continue;
+
+			complex float val[C];
+
+			for (int c = 0; c < C; c++)
+				val[c] = 0.;
+
+			for (long k = colptr[g]; k < colptr[g + 1]; k++)
+				for (int c = 0; c < C; c++)
+					val[c] += spmat->tvalues[k] * _src[c * samples + spmat->rowind[k]];
+
+			for (int c = 0; c < C; c++)
+				_dst[c * gsize + g] += val[c];
+		}
+
+	} while (md_next(D, ksp_dims, (~0UL ^ 15UL), pos));
+}
+
+
+void grid2H_spmat(const struct grid_spmat_s* spmat, unsigned int D, const long trj_dims[D], const long ksp_dims[D], complex float* dst, const long grid_dims[D], const complex float* src)
+{
+	grid2_spmat_dims(spmat, D, trj_dims, ksp_dims, grid_dims);
+
+	long ksp_strs[D];
+	md_calc_strides(D, ksp_strs, ksp_dims, CFL_SIZE);
+
+	long trj_strs[D];
+	md_calc_strides(D, trj_strs, trj_dims, 1);
+
+	long grid_strs[D];
+	md_calc_strides(D, grid_strs, grid_dims, CFL_SIZE);
+
+	long C = ksp_dims[3];
+	long samples = spmat->samples;
+	long gsize = md_calc_size(3, grid_dims);
+	long trj_size = md_calc_size(4, trj_dims);
+
+	long pos[D];
+	for (unsigned int i = 0; i < D; i++)
+		pos[i] = 0;
+
+	do {
+		long t = md_calc_offset(D, trj_strs, pos) / trj_size;
+
+		const long* rowptr = spmat->rowptr + t * samples;
+
+		complex float* _dst = &MD_ACCESS(D, ksp_strs, pos, dst);
+		const complex float* _src = &MD_ACCESS(D, grid_strs, pos, src);
+
+#pragma omp parallel for
+		for (long i = 0; i < samples; i++) {
+
+			complex float val[C];
+
+			for (int c = 0; c < C; c++)
+				val[c] = 0.;
+
+			for (long k = rowptr[i]; k < rowptr[i + 1]; k++)
+				for (int c = 0; c < C; c++)
+					val[c] += spmat->values[k] * _src[c * gsize + spmat->colind[k]];
+
+			for (int c = 0; c < C; c++)
+				_dst[c * samples + i] += val[c];
+		}
+
+	} while (md_next(D, ksp_dims, (~0UL ^ 15UL), pos));
 }
 
 
@@ -8,6 +8,7 @@
 
 #include "misc/cppwrap.h"
 
+struct grid_bins_s;
 
 struct grid_conf_s {
 
@@ -17,6 +18,8 @@ struct grid_conf_s {
 	double beta;
 
 	float shift[3];
+
+	const struct grid_bins_s* bins;	///< presorted trajectory (optional)
 };
 
 extern int kb_size;
@@ -33,6 +36,18 @@ extern void grid2(const struct grid_conf_s* conf, unsigned int D, const long trj
 extern void grid2H(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[__VLA(D)], const _Complex float* traj, const long ksp_dims[__VLA(D)], _Complex float* dst, const long grid_dims[__VLA(D)], const _Complex float* grid);
 
 
+extern struct grid_bins_s* grid_bins_create(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[__VLA(D)], const _Complex float* traj, const long grid_dims[__VLA(D)]);
+extern void grid_bins_free(const struct grid_bins_s* bins);
+
+struct grid_spmat_s;
+extern struct grid_spmat_s* grid_spmat_create(const struct grid_conf_s* conf, unsigned int D, const long trj_dims[__VLA(D)], const _Complex float* traj, const long grid_dims[__VLA(D)]);
+extern void grid_spmat_free(const struct grid_spmat_s* spmat);
+extern long grid_spmat_bytes(const struct grid_spmat_s* spmat);
+
+extern void grid2_spmat(const struct grid_spmat_s* spmat, unsigned int D, const long trj_dims[__VLA(D)], const long grid_dims[__VLA(D)], _Complex float* grid, const long ksp_dims[__VLA(D)], const _Complex float* src);
+extern void grid2H_spmat(const struct grid_spmat_s* spmat, unsigned int D, const long trj_dims[__VLA(D)], const long ksp_dims[__VLA(D)], _Complex float* dst, const long grid_dims[__VLA(D)], const _Complex float* grid);
+
+
 extern void grid_pointH(unsigned int ch, int N, const long dims[__VLA(N)], const float pos[__VLA(N)], _Complex float val[__VLA(ch)], const _Complex float* src, _Bool periodic, float width, int kb_size, const float kb_table[__VLA(kb_size + 1)]);
 extern void grid_point(unsigned int ch, int N, const long dims[__VLA(N)], const float pos[__VLA(N)], _Complex float* dst, const _Complex float val[__VLA(ch)], _Bool periodic, float width, int kb_size, const float kb_table[__VLA(kb_size + 1)]);
 
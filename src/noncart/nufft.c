@@ -15,6 +15,9 @@
 #include <complex.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "misc/misc.h"
 #include "misc/debug.h"
@@ -43,6 +46,7 @@
 #include "nufft.h"
 
 #define FFT_FLAGS (MD_BIT(0)|MD_BIT(1)|MD_BIT(2))
+#define COIL_DIM 3
 
 struct nufft_conf_s nufft_conf_defaults = {
 
@@ -59,6 +63,9 @@ struct nufft_conf_s nufft_conf_defaults = {
 	.precomp_linphase = true,
 	.precomp_fftmod = true,
 	.precomp_roll = true,
+	.binning = false,
+	.precomp_interp = false,
+	.cache = false,
 };
 
 #include "nufft_priv.h"
@@ -730,6 +737,8 @@ static struct nufft_data* nufft_create_data(int N,
 	data->psf = NULL;
 	data->weights = NULL;
 	data->basis = NULL;
+	data->bins = NULL;
+	data->spmat = NULL;
 
 	data->lop_nufft_psf = NULL;
 	data->lop_fftuc_psf = NULL;
@@ -891,10 +900,71 @@ static struct nufft_data* nufft_create_data(int N,
 		data->cfft_op = linop_fft_create(N, data->cim_dims, data->flags | data->conf.cfft);
 	}
 
+	data->toeplitz_blk = data->cim_dims[COIL_DIM];
+	data->blk_fft_op = NULL;
+
 	return PTR_PASS(data);
 }
 
 
+/*
+ * The Toeplitz normal operator expands the coil images by the linear
+ * phases, which needs memory for all coils times the number of phases
+ * (or one full set of coil images per phase in low-mem mode). If the
+ * coils are the outermost dimension and no basis is used, the coils
+ * are processed in blocks of at most BART_TOEPLITZ_BLOCK_SIZE elements
+ * (default: 2^22) and the PSF is applied in place.
+ */
+static void toeplitz_blocks(struct nufft_data* data)
+{
+	int N = data->N;
+	int ND = N + 1;
+
+	long coils = data->cim_dims[COIL_DIM];
+
+	if (   (1 == coils) || (COIL_DIM >= N)
+	    || !md_check_equal_dims(ND, data->cml_dims, data->cmT_dims, ~0)
+	    || (1 != md_calc_size(N - COIL_DIM - 1, data->cim_dims + COIL_DIM + 1))
+	    || !md_check_bounds(ND, ~0UL, data->psf_dims, data->cml_dims))
+		return;
+
+	for (int i = 0; i < ND; i++)
+		if ((1 != data->psf_dims[i]) && (data->psf_dims[i] != data->cml_dims[i]))
+			return;
+
+	long max_size = 1L << 22;
+
+	const char* str = getenv("BART_TOEPLITZ_BLOCK_SIZE");
+
+	if ((NULL != str) && (0 < atol(str)))
+		max_size = atol(str);
+
+	bool lowmem = data->conf.pcycle || data->conf.lowmem;
+
+	long size = md_calc_size(lowmem ? N : ND, lowmem ? data->cim_dims : data->cml_dims) / coils;
+
+	// largest divisor of the number of coils within the limit
+
+	long blk = 1;
+
+	for (long b = 1; b <= coils; b++)
+		if ((0 == coils % b) && (b * size <= max_size))
+			blk = b;
+
+	if (blk == coils)
+		return;
+
+	debug_printf(DP_DEBUG1, "NUFFT: Toeplitz with blocks of %ld coils\n", blk);
+
+	long blk_dims[ND];
+	md_copy_dims(ND, blk_dims, lowmem ? data->cim_dims : data->cml_dims);
+	blk_dims[COIL_DIM] = blk;
+
+	data->toeplitz_blk = blk;
+	data->blk_fft_op = linop_fft_create(lowmem ? N : ND, blk_dims, data->flags | data->conf.cfft);
+}
+
+
 static void nufft_set_traj(struct nufft_data* data, int N,
 			   const long trj_dims[N], const complex float* traj,
 			   const long wgh_dims[N], const complex float* weights,
@@ -909,6 +979,45 @@ static void nufft_set_traj(struct nufft_data* data, int N,
 		multiplace_free(data->traj);
 
 		data->traj = multiplace_move(N, trj_dims, CFL_SIZE, traj);
+
+		grid_bins_free(data->bins);
+		grid_spmat_free(data->spmat);
+
+		data->bins = NULL;
+		data->spmat = NULL;
+		data->grid_conf.bins = NULL;
+
+		bool cpu = true;
+#ifdef USE_CUDA
+		cpu = !cuda_ondevice(traj);
+#endif
+		if (data->conf.precomp_interp && !data->conf.lowmem && cpu) {
+
+			double start = timestamp();
+
+			data->spmat = grid_spmat_create(&data->grid_conf, ND, data->trj_dims, traj, data->cm2_dims);
+
+			debug_printf(DP_DEBUG1, "NUFFT: interpolation matrix uses %.1f MB (%.2f s).\n",
+					(double)grid_spmat_bytes(data->spmat) / (1024. * 1024.), timestamp() - start);
+		}
+
+		if (data->conf.binning && (NULL == data->spmat) && cpu) {
+
+			// geometry of the gridding step of the adjoint
+
+			struct grid_conf_s grid_conf = data->grid_conf;
+			const long* grid_dims = data->cm2_dims;
+
+			if (data->conf.decomp || data->conf.lowmem) {
+
+				grid_conf.width /= 2.;
+				grid_conf.os = 1.;
+				grid_dims = data->cim_dims;
+			}
+
+			data->bins = grid_bins_create(&grid_conf, ND, data->trj_dims, traj, grid_dims);
+			data->grid_conf.bins = data->bins;
+		}
 	}
 
 	if (NULL != basis) {
@@ -973,6 +1082,9 @@ static void nufft_set_traj(struct nufft_data* data, int N,
 
 		md_calc_strides(ND, data->psf_strs, data->psf_dims, CFL_SIZE);
 
+		if (NULL == data->blk_fft_op)
+			toeplitz_blocks(data);
+
 		if (!data->conf.nopsf && (NULL != data->traj)) {
 
 			const complex float* psf = compute_psf2(N, data->psf_dims, data->flags, data->trj_dims, traj,
@@ -1078,6 +1190,270 @@ static struct linop_s* nufft_create3(int N,
 }
 
 
+/*
+ * NUFFT cache
+ *
+ * Operators are kept in a small cache and reused when they are
+ * created again for the same dimensions, configuration, trajectory,
+ * weights and basis. This avoids recomputing the PSF, gridding
+ * tables and FFT plans when the same trajectory is used for many
+ * slices (lowmem stacking) or in repeated reconstructions in server
+ * mode. It is only used if requested in the configuration. The number
+ * of entries is set with BART_NUFFT_CACHE (default: 4, 0 disables).
+ *
+ * Entries are looked up by a hash of the data, which is then compared
+ * to the trajectory, weights and basis stored in the cached operator,
+ * so no additional copies are kept. Cached operators share their data
+ * and can not be updated. Entries which are not used outside of the
+ * cache anymore are dropped when an operator for a different
+ * trajectory is created.
+ */
+
+struct nufft_cache_entry_s {
+
+	int N;
+	long* dims;
+
+	struct nufft_conf_s conf;
+
+	uint64_t hash;
+
+	const struct linop_s* op;
+	long last_use;
+};
+
+enum { NUFFT_CACHE_MAX = 16 };
+
+static struct nufft_cache_entry_s nufft_cache[NUFFT_CACHE_MAX];
+static long nufft_cache_clock = 0;
+static bool nufft_cache_persist = false;
+
+
+static int nufft_cache_size(void)
+{
+	static int size = -1;
+
+	if (-1 == size) {
+
+		size = 4;
+
+		const char* str = getenv("BART_NUFFT_CACHE");
+
+		if (NULL != str)
+			size = MIN(NUFFT_CACHE_MAX, MAX(0, atoi(str)));
+	}
+
+	return size;
+}
+
+
+/**
+ * Operators are reused across commands (server mode).
+ */
+void nufft_cache_keep(void)
+{
+	nufft_cache_persist = true;
+}
+
+
+bool nufft_cache_kept_p(void)
+{
+	return nufft_cache_persist && (0 < nufft_cache_size());
+}
+
+
+static uint64_t nufft_cache_hash(uint64_t hash, size_t size, const void* ptr)
+{
+	// FNV-1a on 64 bit words (complex floats have a size of 8)
+
+	assert(0 == size % sizeof(uint64_t));
+
+	const char* p = ptr;
+
+	for (size_t i = 0; i < size; i += sizeof(uint64_t)) {
+
+		uint64_t w;
+		memcpy(&w, p + i, sizeof w);
+
+		hash = (hash ^ w) * 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+
+static bool nufft_conf_equal(const struct nufft_conf_s* a, const struct nufft_conf_s* b)
+{
+	// compares all fields, different padding only causes a miss
+
+	return (0 == memcmp(a, b, sizeof *a));
+}
+
+
+static bool nufft_cache_match(const struct linop_s* op, const long size[3], const complex float* data[3])
+{
+	auto nd = CAST_DOWN(nufft_data, linop_get_data(op));
+
+	struct multiplace_array_s* cached[3] = { nd->traj, nd->weights, nd->basis };
+
+	for (int j = 0; j < 3; j++) {
+
+		if ((NULL == data[j]) != (NULL == cached[j]))
+			return false;
+
+		if (   (NULL != data[j])
+		    && (0 != memcmp(data[j], multiplace_read(cached[j], data[j]), (size_t)size[j] * CFL_SIZE)))
+			return false;
+	}
+
+	return true;
+}
+
+
+static void nufft_cache_free(struct nufft_cache_entry_s* e)
+{
+	linop_free(e->op);
+
+	xfree(e->dims);
+
+	e->op = NULL;
+}
+
+
+void nufft_cache_clear(void)
+{
+	#pragma omp critical (nufft_cache)
+	for (int i = 0; i < NUFFT_CACHE_MAX; i++)
+		if (NULL != nufft_cache[i].op)
+			nufft_cache_free(&nufft_cache[i]);
+}
+
+
+static void nufft_cache_release(void)
+{
+	// drop entries only referenced by the cache
+
+	for (int i = 0; i < NUFFT_CACHE_MAX; i++)
+		if ((NULL != nufft_cache[i].op) && !operator_shared(nufft_cache[i].op->forward))
+			nufft_cache_free(&nufft_cache[i]);
+}
+
+
+static struct linop_s* nufft_create_cached(int N,
+			     const long ksp_dims[N],
+			     const long cim_dims[N],
+			     const long traj_dims[N],
+			     const complex float* traj,
+			     const long wgh_dims[N],
+			     const complex float* weights,
+			     const long bas_dims[N],
+			     const complex float* basis,
+			     struct nufft_conf_s conf)
+{
+	bool cpu = true;
+#ifdef USE_CUDA
+	cpu = !(   cuda_ondevice(traj)
+		|| ((NULL != weights) && cuda_ondevice(weights))
+		|| ((NULL != basis) && cuda_ondevice(basis)));
+#endif
+
+	if ((0 == nufft_cache_size()) || (NULL == traj) || !cpu) {
+
+		conf.cache = false;
+
+		return nufft_create3(N, ksp_dims, cim_dims, traj_dims, traj, wgh_dims, weights, bas_dims, basis, conf);
+	}
+
+	long dims[5][N];
+	md_copy_dims(N, dims[0], ksp_dims);
+	md_copy_dims(N, dims[1], cim_dims);
+	md_copy_dims(N, dims[2], traj_dims);
+	md_singleton_dims(N, dims[3]);
+	md_singleton_dims(N, dims[4]);
+
+	if (NULL != weights)
+		md_copy_dims(N, dims[3], wgh_dims);
+
+	if (NULL != basis)
+		md_copy_dims(N, dims[4], bas_dims);
+
+	const complex float* data[3] = { traj, weights, basis };
+	long size[3];
+
+	for (int i = 0; i < 3; i++)
+		size[i] = (NULL == data[i]) ? 0 : md_calc_size(N, dims[2 + i]);
+
+	uint64_t hash = 14695981039346656037ULL;
+
+	for (int i = 0; i < 3; i++)
+		hash = nufft_cache_hash(hash, (size_t)size[i] * CFL_SIZE, data[i]);
+
+	const struct linop_s* op = NULL;
+
+	#pragma omp critical (nufft_cache)
+	for (int i = 0; i < NUFFT_CACHE_MAX; i++) {
+
+		struct nufft_cache_entry_s* e = &nufft_cache[i];
+
+		if (   (NULL == e->op) || (hash != e->hash) || (N != e->N)
+		    || (0 != memcmp(dims, e->dims, sizeof(dims)))
+		    || !nufft_conf_equal(&conf, &e->conf))
+			continue;
+
+		if (nufft_cache_match(e->op, size, data)) {
+
+			e->last_use = ++nufft_cache_clock;
+			op = linop_clone(e->op);
+			break;
+		}
+	}
+
+	if (NULL != op) {
+
+		debug_printf(DP_DEBUG1, "NUFFT: reusing cached operator.\n");
+		return (struct linop_s*)op;
+	}
+
+	struct linop_s* nop = nufft_create3(N, ksp_dims, cim_dims, traj_dims, traj, wgh_dims, weights, bas_dims, basis, conf);
+
+	#pragma omp critical (nufft_cache)
+	{
+		nufft_cache_release();
+
+		// replace an empty or the least recently used entry
+
+		int k = 0;
+
+		for (int i = 0; i < nufft_cache_size(); i++) {
+
+			if (NULL == nufft_cache[i].op) {
+
+				k = i;
+				break;
+			}
+
+			if (nufft_cache[i].last_use < nufft_cache[k].last_use)
+				k = i;
+		}
+
+		struct nufft_cache_entry_s* e = &nufft_cache[k];
+
+		if (NULL != e->op)
+			nufft_cache_free(e);
+
+		e->N = N;
+		e->dims = xmalloc(sizeof(dims));
+		memcpy(e->dims, dims, sizeof(dims));
+		e->conf = conf;
+		e->hash = hash;
+		e->op = linop_clone(nop);
+		e->last_use = ++nufft_cache_clock;
+	}
+
+	return nop;
+}
+
+
 struct linop_s* nufft_create2(int N,
 			     const long ksp_dims[N],
 			     const long cim_dims[N],
@@ -1123,6 +1499,11 @@ struct linop_s* nufft_create2(int N,
 		}
 	}
 
+	if (conf.cache)
+		return nufft_create_cached(N, ksp_dims, cim_dims,
+				traj_dims, traj, wgh_dims, weights,
+				bas_dims, basis, conf);
+
 	return nufft_create3(N, ksp_dims, cim_dims,
 			traj_dims, traj, wgh_dims, weights,
 			bas_dims, basis, conf);
@@ -1150,10 +1531,13 @@ struct linop_s* nufft_create_normal(int N, const long cim_dims[N],
 	auto data = nufft_create_data(N, cim_dims, basis, conf);
 
 	md_copy_dims(ND, data->psf_dims, psf_dims);
+	md_calc_strides(ND, data->psf_strs, data->psf_dims, CFL_SIZE);
 
 	assert(md_check_equal_dims(ND, data->psf_dims, data->lph_dims, data->flags));
 	assert(conf.toeplitz);
 
+	toeplitz_blocks(data);
+
 	long out_dims[N];
 	md_singleton_dims(N, out_dims);
 
@@ -1224,11 +1608,17 @@ static void nufft_free_data(const linop_data_t* _data)
 	multiplace_free(data->basis);
 	multiplace_free(data->traj);
 
+	grid_bins_free(data->bins);
+	grid_spmat_free(data->spmat);
+
 	linop_free(data->fft_op);
 
 	if (data->conf.pcycle || data->conf.lowmem)
 		linop_free(data->cfft_op);
 
+	if (NULL != data->blk_fft_op)
+		linop_free(data->blk_fft_op);
+
 	if (NULL != data->lop_nufft_psf)
 		linop_free(data->lop_nufft_psf);
 
@@ -1241,6 +1631,20 @@ static void nufft_free_data(const linop_data_t* _data)
 
 
 
+static bool use_spmat(const struct nufft_data* data, const complex float* ptr)
+{
+	if (NULL == data->spmat)
+		return false;
+#ifdef USE_CUDA
+	if (cuda_ondevice(ptr))
+		return false;
+#else
+	UNUSED(ptr);
+#endif
+	return true;
+}
+
+
 // Forward: from image to kspace
 static void nufft_apply_forward(const linop_data_t* _data, complex float* dst, const complex float* src)
 {
@@ -1282,7 +1686,10 @@ static void nufft_apply_forward(const linop_data_t* _data, complex float* dst, c
 
 	md_clear(ND, data->ksp_dims, tmp, CFL_SIZE);
 
-	grid2H(&data->grid_conf, ND, data->trj_dims, multiplace_read(data->traj, src), data->ksp_dims, tmp, data->cm2_dims, gridX);
+	if (use_spmat(data, dst))
+		grid2H_spmat(data->spmat, ND, data->trj_dims, data->ksp_dims, tmp, data->cm2_dims, gridX);
+	else
+		grid2H(&data->grid_conf, ND, data->trj_dims, multiplace_read(data->traj, src), data->ksp_dims, tmp, data->cm2_dims, gridX);
 
 	md_free(gridX);
 
@@ -1332,7 +1739,7 @@ static void nufft_apply_adjoint(const linop_data_t* _data, complex float* dst, c
 
 	complex float* grid = md_alloc_sameplace(ND, data->cml_dims, CFL_SIZE, dst);
 
-	if (data->conf.decomp) {
+	if (data->conf.decomp && !use_spmat(data, dst)) {
 
 		md_clear(ND, data->cml_dims, grid, CFL_SIZE);
 
@@ -1345,7 +1752,10 @@ static void nufft_apply_adjoint(const linop_data_t* _data, complex float* dst, c
 
 		md_clear(data->N, data->cm2_dims, gridX, CFL_SIZE);
 
-		grid2(&data->grid_conf, ND, data->trj_dims, multiplace_read(data->traj, dst), data->cm2_dims, gridX, data->ksp_dims, src);
+		if (use_spmat(data, dst))
+			grid2_spmat(data->spmat, ND, data->trj_dims, data->cm2_dims, gridX, data->ksp_dims, src);
+		else
+			grid2(&data->grid_conf, ND, data->trj_dims, multiplace_read(data->traj, dst), data->cm2_dims, gridX, data->ksp_dims, src);
 
 		md_decompose(data->N, data->factors, data->cml_dims, grid, data->cm2_dims, gridX, CFL_SIZE);
 
@@ -1371,10 +1781,54 @@ static void nufft_apply_adjoint(const linop_data_t* _data, complex float* dst, c
 
 
 
+static void toeplitz_mult_blk(const struct nufft_data* data, complex float* dst, const complex float* src)
+{
+	int ND = data->N + 1;
+
+	const complex float* linphase = multiplace_read(data->linphase, src);
+	const complex float* psf = multiplace_read(data->psf, src);
+
+	long bml_dims[ND];
+	md_copy_dims(ND, bml_dims, data->cml_dims);
+	bml_dims[COIL_DIM] = data->toeplitz_blk;
+
+	long bim_dims[ND];
+	md_select_dims(ND, ~MD_BIT(data->N), bim_dims, bml_dims);
+
+	long bml_strs[ND];
+	md_calc_strides(ND, bml_strs, bml_dims, CFL_SIZE);
+
+	complex float* grid = md_alloc_sameplace(ND, bml_dims, CFL_SIZE, dst);
+
+	for (long c = 0; c < data->cim_dims[COIL_DIM]; c += data->toeplitz_blk) {
+
+		long off = c * data->cim_strs[COIL_DIM] / (long)CFL_SIZE;
+
+		md_zmul2(ND, bml_dims, bml_strs, grid, data->cim_strs, src + off, data->lph_strs, linphase);
+
+		linop_forward(data->blk_fft_op, ND, bml_dims, grid, ND, bml_dims, grid);
+
+		md_zmul2(ND, bml_dims, bml_strs, grid, bml_strs, grid, data->psf_strs, psf);
+
+		linop_adjoint(data->blk_fft_op, ND, bml_dims, grid, ND, bml_dims, grid);
+
+		md_ztenmulc2(ND, bml_dims, data->cim_strs, dst + off, bml_strs, grid, data->lph_strs, linphase);
+	}
+
+	md_free(grid);
+}
+
+
 static void toeplitz_mult(const struct nufft_data* data, complex float* dst, const complex float* src)
 {
 	int ND = data->N + 1;
 
+	if (NULL != data->blk_fft_op) {
+
+		toeplitz_mult_blk(data, dst, src);
+		return;
+	}
+
 	const complex float* linphase = multiplace_read(data->linphase, src);
 	const complex float* psf = multiplace_read(data->psf, src);
 
@@ -1384,11 +1838,20 @@ static void toeplitz_mult(const struct nufft_data* data, complex float* dst, con
 
 	linop_forward(data->fft_op, ND, data->cml_dims, grid, ND, data->cml_dims, grid);
 
-	complex float* gridT = md_alloc_sameplace(ND, data->cmT_dims, CFL_SIZE, dst);
+	complex float* gridT = grid;
 
-	md_ztenmul(ND, data->cmT_dims, gridT, data->cml_dims, grid, data->psf_dims, psf);
+	if (md_check_equal_dims(ND, data->cml_dims, data->cmT_dims, ~0)) {
 
-	md_free(grid);
+		md_zmul2(ND, data->cml_dims, data->cml_strs, grid, data->cml_strs, grid, data->psf_strs, psf);
+
+	} else {
+
+		gridT = md_alloc_sameplace(ND, data->cmT_dims, CFL_SIZE, dst);
+
+		md_ztenmul(ND, data->cmT_dims, gridT, data->cml_dims, grid, data->psf_dims, psf);
+
+		md_free(grid);
+	}
 
 	linop_adjoint(data->fft_op, ND, data->cml_dims, gridT, ND, data->cml_dims, gridT);
 
@@ -1399,7 +1862,29 @@ static void toeplitz_mult(const struct nufft_data* data, complex float* dst, con
 
 
 
+static void toeplitz_mult_lowmem2(const struct nufft_data* data, int i, const long cim_dims[data->N], const struct linop_s* cfft_op, complex float* dst, const complex float* src);
+
 static void toeplitz_mult_lowmem(const struct nufft_data* data, int i, complex float* dst, const complex float* src)
+{
+	if (NULL == data->blk_fft_op) {
+
+		toeplitz_mult_lowmem2(data, i, data->cim_dims, data->cfft_op, dst, src);
+		return;
+	}
+
+	long bim_dims[data->N];
+	md_copy_dims(data->N, bim_dims, data->cim_dims);
+	bim_dims[COIL_DIM] = data->toeplitz_blk;
+
+	for (long c = 0; c < data->cim_dims[COIL_DIM]; c += data->toeplitz_blk) {
+
+		long off = c * data->cim_strs[COIL_DIM] / (long)CFL_SIZE;
+
+		toeplitz_mult_lowmem2(data, i, bim_dims, data->blk_fft_op, dst + off, src + off);
+	}
+}
+
+static void toeplitz_mult_lowmem2(const struct nufft_data* data, int i, const long cim_dims[data->N], const struct linop_s* cfft_op, complex float* dst, const complex float* src)
 {
 	const complex float* linphase = multiplace_read(data->linphase, src);
 	const complex float* psf = multiplace_read(data->psf, src);
@@ -1411,32 +1896,32 @@ static void toeplitz_mult_lowmem(const struct nufft_data* data, int i, complex f
 	for (int j = 0; j < 3; j++)
 		shift[j] = MD_IS_SET((unsigned long)i, j) ? -0.5 : 0;
 
-	complex float* grid = md_alloc_sameplace(data->N, data->cim_dims, CFL_SIZE, dst);
+	complex float* grid = md_alloc_sameplace(data->N, cim_dims, CFL_SIZE, dst);
 
 	if (NULL != clinphase) {
 
-		md_zmul2(data->N, data->cim_dims, data->cim_strs, grid, data->cim_strs, src, data->img_strs, clinphase);
+		md_zmul2(data->N, cim_dims, data->cim_strs, grid, data->cim_strs, src, data->img_strs, clinphase);
 
 	} else {
 
 		float scale = 1. / sqrtf(md_calc_size(3, data->lph_dims));
 
-		apply_linphases_3D(data->N, data->cim_dims, shift, grid, src, false, false, scale);
+		apply_linphases_3D(data->N, cim_dims, shift, grid, src, false, false, scale);
 
 		if (NULL != data->fftmod)
-			md_zmul2(data->N, data->cim_dims, data->cim_strs, grid, data->cim_strs, grid, data->img_strs, multiplace_read(data->fftmod, dst));
+			md_zmul2(data->N, cim_dims, data->cim_strs, grid, data->cim_strs, grid, data->img_strs, multiplace_read(data->fftmod, dst));
 		else
-			fftmod(data->N, data->cim_dims, data->flags, grid, grid);
+			fftmod(data->N, cim_dims, data->flags, grid, grid);
 	}
 
 
-	linop_forward(data->cfft_op, data->N, data->cim_dims, grid, data->N, data->cim_dims, grid);
+	linop_forward(cfft_op, data->N, cim_dims, grid, data->N, cim_dims, grid);
 
 	if (!md_check_equal_dims(data->N, data->cim_dims, data->ciT_dims, ~0)) {
 
 		complex float* gridT = md_alloc_sameplace(data->N, data->ciT_dims, CFL_SIZE, dst);
 
-		md_ztenmul(data->N, data->ciT_dims, gridT, data->cim_dims, grid, data->psf_dims, cpsf);
+		md_ztenmul(data->N, data->ciT_dims, gridT, cim_dims, grid, data->psf_dims, cpsf);
 
 		md_free(grid);
 
@@ -1444,25 +1929,25 @@ static void toeplitz_mult_lowmem(const struct nufft_data* data, int i, complex f
 
 	} else {
 
-		md_zmul2(data->N, data->cim_dims, data->cim_strs, grid, data->cim_strs, grid, data->psf_strs, cpsf);
+		md_zmul2(data->N, cim_dims, data->cim_strs, grid, data->cim_strs, grid, data->psf_strs, cpsf);
 	}
 
-	linop_adjoint(data->cfft_op, data->N, data->cim_dims, grid, data->N, data->cim_dims, grid);
+	linop_adjoint(cfft_op, data->N, cim_dims, grid, data->N, cim_dims, grid);
 
 	if (NULL != clinphase) {
 
-		md_zfmacc2(data->N, data->cim_dims, data->cim_strs, dst, data->cim_strs, grid, data->img_strs, clinphase);
+		md_zfmacc2(data->N, cim_dims, data->cim_strs, dst, data->cim_strs, grid, data->img_strs, clinphase);
 
 	} else {
 
 		if (NULL != data->fftmod)
-			md_zmulc2(data->N, data->cim_dims, data->cim_strs, grid, data->cim_strs, grid, data->img_strs, multiplace_read(data->fftmod, dst));
+			md_zmulc2(data->N, cim_dims, data->cim_strs, grid, data->cim_strs, grid, data->img_strs, multiplace_read(data->fftmod, dst));
 		else
-			ifftmod(data->N, data->cim_dims, data->flags, grid, grid);
+			ifftmod(data->N, cim_dims, data->flags, grid, grid);
 
 		float scale = 1. / sqrtf(md_calc_size(3, data->lph_dims));
 
-		apply_linphases_3D(data->N, data->cim_dims, shift, dst, grid, true, true, scale);
+		apply_linphases_3D(data->N, cim_dims, shift, dst, grid, true, true, scale);
 	}
 
 	md_free(grid);
@@ -1739,6 +2224,9 @@ void nufft_update_traj(	const struct linop_s* nufft, int N,
 
 	assert((int)data->N == N);
 
+	if (data->conf.cache)
+		error("NUFFT: cached operator can not be updated.\n");
+
 	nufft_set_traj(data, N, trj_dims, traj, wgh_dims, weights, bas_dims, basis);
 }
 
@@ -1748,6 +2236,9 @@ void nufft_update_psf2(const struct linop_s* nufft, int ND, const long psf_dims[
 
 	assert(md_check_equal_dims(ND, data->psf_dims, psf_dims, ~0));
 
+	if (data->conf.cache)
+		error("NUFFT: cached operator can not be updated.\n");
+
 	multiplace_free(data->psf);
 
 	data->psf = multiplace_move2(ND, psf_dims, psf_strs, CFL_SIZE, psf);
@@ -26,6 +26,10 @@ struct nufft_conf_s {
 	_Bool precomp_linphase;
 	_Bool precomp_fftmod;
 	_Bool precomp_roll;
+
+	_Bool binning;	///< Presort trajectory into tiles for gridding
+	_Bool precomp_interp;	///< Precompute sparse interpolation matrix
+	_Bool cache;		///< Reuse operators for identical trajectories
 };
 
 extern struct nufft_conf_s nufft_conf_defaults;
@@ -68,6 +72,10 @@ extern struct linop_s* nufft_create_normal(int N, const long cim_dims[__VLA(N)],
 					   int ND, const long psf_dims[__VLA(ND)], const _Complex float* psf,
 					   _Bool basis, struct nufft_conf_s conf);
 
+extern void nufft_cache_clear(void);
+extern void nufft_cache_keep(void);
+extern _Bool nufft_cache_kept_p(void);
+
 extern void nufft_update_traj(const struct linop_s* nufft, int N,
 			const long trj_dims[__VLA(N)], const _Complex float* traj,
 			const long wgh_dims[__VLA(N)], const _Complex float* weights,
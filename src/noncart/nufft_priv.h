@@ -25,6 +25,8 @@ struct nufft_data {
 	struct multiplace_array_s* fftmod;	///< FFT modulation for centering
 	struct multiplace_array_s* weights;	///< Weights, ex, density compensation
 	struct multiplace_array_s* basis;
+	struct grid_bins_s* bins;	///< Presorted trajectory for gridding
+	struct grid_spmat_s* spmat;	///< Precomputed interpolation matrix
 
 	float width;			///< Interpolation kernel width
 	double beta;			///< Kaiser-Bessel beta parameter
@@ -62,6 +64,9 @@ struct nufft_data {
 	const struct linop_s* cfft_op;   ///< Pcycle FFT operator
 	unsigned int cycle;
 
+	long toeplitz_blk;		///< Coils per block for the Toeplitz normal operator
+	const struct linop_s* blk_fft_op;	///< FFT operator for one block of coils
+
 	struct linop_s* lop_nufft_psf;
 	struct linop_s* lop_fftuc_psf;
 };
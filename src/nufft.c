@@ -87,6 +87,9 @@ int main_nufft(int argc, char* argv[argc])
 		OPT_CLEAR('1', &conf.decomp, "use/return oversampled grid"),
 		OPTL_SET(0, "lowmem", &conf.lowmem, "Use low-mem mode of the nuFFT"),
 		OPTL_CLEAR(0, "no-precomp", &precomp, "Use low-low-mem mode of the nuFFT"),
+		OPTL_SET(0, "binning", &conf.binning, "Presort trajectory into tiles for gridding"),
+		OPTL_SET(0, "interp-matrix", &conf.precomp_interp, "Precompute sparse interpolation matrix"),
+		OPTL_SET(0, "cg-pipelined", &cgconf.pipelined, "pipelined conjugate gradients (inverse only)"),
 		OPT_INFILE('B', &basis_file, "file", "temporal (or other) basis"),
 		OPT_INFILE('p', &pattern_file, "file", "weighting of nufft"),
 	};
@@ -0,0 +1,352 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ *
+ * Batched eigen decomposition of many small Hermitian matrices.
+ *
+ * ESPIRiT and locally low-rank thresholding solve huge numbers of
+ * tiny independent eigenvalue problems. Here, groups of matrices are
+ * stored with the matrix index innermost (structure of arrays) and
+ * diagonalized together with the cyclic Jacobi method, so that every
+ * rotation is applied to all matrices of a group with the same
+ * vectorized loop. The computation is done in double precision.
+ *
+ * Golub GH, Van Loan CF. Matrix Computations. 4th ed. 2013. Sec. 8.5.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <complex.h>
+#include <math.h>
+
+#include "misc/misc.h"
+
+#include "eig-batch.h"
+
+
+// number of matrices processed together
+
+enum { EIG_BATCH_WIDTH = 16 };
+
+enum { EIG_BATCH_SWEEPS = 20 };
+
+
+struct eig_group_s {
+
+	double ar[EIG_BATCH_MAX][EIG_BATCH_MAX][EIG_BATCH_WIDTH];
+	double ai[EIG_BATCH_MAX][EIG_BATCH_MAX][EIG_BATCH_WIDTH];
+	double xr[EIG_BATCH_MAX][EIG_BATCH_MAX][EIG_BATCH_WIDTH];
+	double xi[EIG_BATCH_MAX][EIG_BATCH_MAX][EIG_BATCH_WIDTH];
+};
+
+
+static bool eig_group_converged(int N, const struct eig_group_s* g)
+{
+	enum { W = EIG_BATCH_WIDTH };
+
+	for (int w = 0; w < W; w++) {
+
+		double off = 0.;
+		double nrm = 0.;
+
+		for (int p = 0; p < N; p++) {
+
+			nrm += g->ar[p][p][w] * g->ar[p][p][w];
+
+			for (int q = p + 1; q < N; q++)
+				off += 2. * (g->ar[p][q][w] * g->ar[p][q][w] + g->ai[p][q][w] * g->ai[p][q][w]);
+		}
+
+		if (off > 1.E-24 * (nrm + off))
+			return false;
+	}
+
+	return true;
+}
+
+
+/*
+ * One cyclic Jacobi sweep. The matrix A(r, c) is stored in ar/ai[r][c]
+ * and the eigenvectors in the columns of X.
+ *
+ * With b = A(p, q) = |b| e, the rotation V = diag(1, conj(e)) R, where
+ * R is the real Jacobi rotation of [[a, |b|], [|b|, d]], diagonalizes
+ * the 2x2 submatrix.
+ */
+static void eig_group_sweep(int N, struct eig_group_s* g)
+{
+	enum { W = EIG_BATCH_WIDTH };
+
+	for (int p = 0; p < N; p++) {
+
+		for (int q = p + 1; q < N; q++) {
+
+			double c[W];
+			double s[W];
+			double er[W];
+			double ei[W];
+
+			#pragma omp simd
+			for (int w = 0; w < W; w++) {
+
+				double a = g->ar[p][p][w];
+				double d = g->ar[q][q][w];
+				double br = g->ar[p][q][w];
+				double bi = g->ai[p][q][w];
+
+				double b = sqrt(br * br + bi * bi);
+
+				if (0. == b) {
+
+					c[w] = 1.;
+					s[w] = 0.;
+					er[w] = 1.;
+					ei[w] = 0.;
+
+				} else {
+
+					double tau = (d - a) / (2. * b);
+					double t = ((tau >= 0.) ? 1. : -1.) / (fabs(tau) + sqrt(1. + tau * tau));
+
+					c[w] = 1. / sqrt(1. + t * t);
+					s[w] = t * c[w];
+					er[w] = br / b;
+					ei[w] = bi / b;
+				}
+			}
+
+			// columns: A <- A V, X <- X V
+
+			for (int k = 0; k < N; k++) {
+
+				double* pr[2] = { g->ar[k][p], g->xr[k][p] };
+				double* pi[2] = { g->ai[k][p], g->xi[k][p] };
+				double* qr[2] = { g->ar[k][q], g->xr[k][q] };
+				double* qi[2] = { g->ai[k][q], g->xi[k][q] };
+
+				for (int m = 0; m < 2; m++) {
+
+					#pragma omp simd
+					for (int w = 0; w < W; w++) {
+
+						// q * conj(e)
+
+						double tr = qr[m][w] * er[w] + qi[m][w] * ei[w];
+						double ti = qi[m][w] * er[w] - qr[m][w] * ei[w];
+
+						double npr = c[w] * pr[m][w] - s[w] * tr;
+						double npi = c[w] * pi[m][w] - s[w] * ti;
+
+						qr[m][w] = s[w] * pr[m][w] + c[w] * tr;
+						qi[m][w] = s[w] * pi[m][w] + c[w] * ti;
+						pr[m][w] = npr;
+						pi[m][w] = npi;
+					}
+				}
+			}
+
+			// rows: A <- V^H A
+
+			for (int k = 0; k < N; k++) {
+
+				double* pr = g->ar[p][k];
+				double* pi = g->ai[p][k];
+				double* qr = g->ar[q][k];
+				double* qi = g->ai[q][k];
+
+				#pragma omp simd
+				for (int w = 0; w < W; w++) {
+
+					// q * e
+
+					double tr = qr[w] * er[w] - qi[w] * ei[w];
+					double ti = qi[w] * er[w] + qr[w] * ei[w];
+
+					double npr = c[w] * pr[w] - s[w] * tr;
+					double npi = c[w] * pi[w] - s[w] * ti;
+
+					qr[w] = s[w] * pr[w] + c[w] * tr;
+					qi[w] = s[w] * pi[w] + c[w] * ti;
+					pr[w] = npr;
+					pi[w] = npi;
+				}
+			}
+		}
+	}
+}
+
+
+static void eig_group_sort(int N, const struct eig_group_s* g, int w, int idx[N])
+{
+	for (int k = 0; k < N; k++)
+		idx[k] = k;
+
+	// insertion sort of the eigenvalues
+
+	for (int k = 1; k < N; k++)
+		for (int l = k; (l > 0) && (g->ar[idx[l]][idx[l]][w] < g->ar[idx[l - 1]][idx[l - 1]][w]); l--)
+			SWAP(idx[l], idx[l - 1]);
+}
+
+
+/*
+ * Extract an eigenvector with its phase chosen such that the last
+ * component is real and non-negative. Up to the sign, this is the
+ * convention of LAPACK's reduction of the upper triangle. It keeps
+ * the phase of the eigenvectors smooth across neighboring matrices.
+ */
+static void eig_group_vector(int N, const struct eig_group_s* g, int w, int k, complex double vec[N])
+{
+	double lr = g->xr[N - 1][k][w];
+	double li = g->xi[N - 1][k][w];
+	double l = sqrt(lr * lr + li * li);
+
+	complex double ph = (0. == l) ? 1. : ((lr - 1.i * li) / l);
+
+	for (int v = 0; v < N; v++)
+		vec[v] = (g->xr[v][k][w] + 1.i * g->xi[v][k][w]) * ph;
+}
+
+
+static void eig_group_init(int N, struct eig_group_s* g)
+{
+	// unused lanes are diagonalized as identities
+
+	for (int r = 0; r < N; r++) {
+
+		for (int c = 0; c < N; c++) {
+
+			for (int w = 0; w < EIG_BATCH_WIDTH; w++) {
+
+				g->ar[r][c][w] = (r == c) ? 1. : 0.;
+				g->ai[r][c][w] = 0.;
+				g->xr[r][c][w] = (r == c) ? 1. : 0.;
+				g->xi[r][c][w] = 0.;
+			}
+		}
+	}
+}
+
+
+static void eig_group_solve(int N, struct eig_group_s* g)
+{
+	for (int i = 0; (i < EIG_BATCH_SWEEPS) && !eig_group_converged(N, g); i++)
+		eig_group_sweep(N, g);
+}
+
+
+/**
+ * Eigen decomposition of B Hermitian matrices of size N x N with the
+ * same conventions as lapack_eig(): the upper triangle of each (column-
+ * major) matrix is used, the eigenvalues are returned in ascending
+ * order and vec[b][k] is the k-th eigenvector.
+ */
+void batch_eig(long N, long B, float val[B][N], complex float vec[B][N][N])
+{
+	enum { W = EIG_BATCH_WIDTH };
+
+	assert(N <= EIG_BATCH_MAX);
+
+	long groups = (B + W - 1) / W;
+
+#pragma omp parallel for
+	for (long gi = 0; gi < groups; gi++) {
+
+		struct eig_group_s* g = xmalloc(sizeof *g);
+
+		eig_group_init(N, g);
+
+		long b0 = gi * W;
+		long bn = MIN(W, B - b0);
+
+		for (int r = 0; r < N; r++) {
+
+			for (int c = 0; c < N; c++) {
+
+				for (int w = 0; w < bn; w++) {
+
+					complex float v = (r <= c) ? vec[b0 + w][c][r] : conjf(vec[b0 + w][r][c]);
+
+					g->ar[r][c][w] = crealf(v);
+					g->ai[r][c][w] = (r == c) ? 0. : cimagf(v);
+				}
+			}
+		}
+
+		eig_group_solve(N, g);
+
+		for (int w = 0; w < bn; w++) {
+
+			int idx[N];
+			eig_group_sort(N, g, w, idx);
+
+			for (int k = 0; k < N; k++) {
+
+				val[b0 + w][k] = g->ar[idx[k]][idx[k]][w];
+
+				complex double tmp[N];
+				eig_group_vector(N, g, w, idx[k], tmp);
+
+				for (int v = 0; v < N; v++)
+					vec[b0 + w][k][v] = tmp[v];
+			}
+		}
+
+		xfree(g);
+	}
+}
+
+
+/**
+ * Double precision version of batch_eig().
+ */
+void batch_eig_double(long N, long B, double val[B][N], complex double vec[B][N][N])
+{
+	enum { W = EIG_BATCH_WIDTH };
+
+	assert(N <= EIG_BATCH_MAX);
+
+	long groups = (B + W - 1) / W;
+
+#pragma omp parallel for
+	for (long gi = 0; gi < groups; gi++) {
+
+		struct eig_group_s* g = xmalloc(sizeof *g);
+
+		eig_group_init(N, g);
+
+		long b0 = gi * W;
+		long bn = MIN(W, B - b0);
+
+		for (int r = 0; r < N; r++) {
+
+			for (int c = 0; c < N; c++) {
+
+				for (int w = 0; w < bn; w++) {
+
+					complex double v = (r <= c) ? vec[b0 + w][c][r] : conj(vec[b0 + w][r][c]);
+
+					g->ar[r][c][w] = creal(v);
+					g->ai[r][c][w] = (r == c) ? 0. : cimag(v);
+				}
+			}
+		}
+
+		eig_group_solve(N, g);
+
+		for (int w = 0; w < bn; w++) {
+
+			int idx[N];
+			eig_group_sort(N, g, w, idx);
+
+			for (int k = 0; k < N; k++) {
+
+				val[b0 + w][k] = g->ar[idx[k]][idx[k]][w];
+
+				eig_group_vector(N, g, w, idx[k], vec[b0 + w][k]);
+			}
+		}
+
+		xfree(g);
+	}
+}
@@ -0,0 +1,18 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ */
+
+#ifndef __EIG_BATCH_H
+#define __EIG_BATCH_H
+
+#include "misc/cppwrap.h"
+
+enum { EIG_BATCH_MAX = 32 };
+
+extern void batch_eig(long N, long B, float val[__VLA(B)][N], _Complex float vec[__VLA(B)][N][N]);
+extern void batch_eig_double(long N, long B, double val[__VLA(B)][N], _Complex double vec[__VLA(B)][N][N]);
+
+#include "misc/cppwrap.h"
+
+#endif
@@ -0,0 +1,249 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ *
+ * Batched FFT for many small transforms.
+ *
+ * Calibration, SSA and wave-CAIPI apply huge numbers of small FFTs
+ * along dimensions with strides which can not be merged into a single
+ * loop. Here, blocks of transforms are gathered into a buffer with
+ * the batch index innermost and transformed together with a radix-2
+ * Stockham algorithm, so that all arithmetic runs on contiguous
+ * vectors. No planning is required.
+ *
+ * Stockham, T. G. 1966. "High-speed convolution and correlation."
+ * AFIPS Spring Joint Computer Conference, pp. 229-233.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <complex.h>
+#include <math.h>
+
+#include "num/multind.h"
+
+#include "misc/misc.h"
+
+#include "fft-batch.h"
+
+
+// number of transforms processed together
+
+enum { FFT_BATCH_BLOCK = 32 };
+
+
+bool fft_batch_supported(int D, const long dims[D], unsigned long flags)
+{
+	flags &= md_nontriv_dims(D, dims);
+
+	if (0u == flags)
+		return false;
+
+	for (int i = 0; i < D; i++) {
+
+		if (!MD_IS_SET(flags, i))
+			continue;
+
+		long n = dims[i];
+
+		if ((n > FFT_BATCH_MAX) || (0 != (n & (n - 1))))
+			return false;
+	}
+
+	return true;
+}
+
+
+static void fft_batch_block(long n, float* xr, float* xi, float* yr, float* yi, const float twr[n / 2], const float twi[n / 2])
+{
+	enum { B = FFT_BATCH_BLOCK };
+
+	for (long len = n, s = 1; len > 1; len /= 2, s *= 2) {
+
+		long m = len / 2;
+
+		for (long p = 0; p < m; p++) {
+
+			float wr = twr[p * s];
+			float wi = twi[p * s];
+
+			for (long q = 0; q < s; q++) {
+
+				const float* ar = xr + (q + s * p) * B;
+				const float* ai = xi + (q + s * p) * B;
+				const float* br = xr + (q + s * (p + m)) * B;
+				const float* bi = xi + (q + s * (p + m)) * B;
+
+				float* cr = yr + (q + s * (2 * p + 0)) * B;
+				float* ci = yi + (q + s * (2 * p + 0)) * B;
+				float* dr = yr + (q + s * (2 * p + 1)) * B;
+				float* di = yi + (q + s * (2 * p + 1)) * B;
+
+				#pragma omp simd
+				for (int b = 0; b < B; b++) {
+
+					float tr = ar[b] - br[b];
+					float ti = ai[b] - bi[b];
+
+					cr[b] = ar[b] + br[b];
+					ci[b] = ai[b] + bi[b];
+					dr[b] = tr * wr - ti * wi;
+					di[b] = tr * wi + ti * wr;
+				}
+			}
+		}
+
+		float* t;
+		t = xr; xr = yr; yr = t;
+		t = xi; xi = yi; yi = t;
+	}
+}
+
+
+static void fft_batch_dim(int D, const long dims[D], int d, const long ostrs[D], complex float* dst, const long istrs[D], const complex float* src, bool backwards)
+{
+	enum { B = FFT_BATCH_BLOCK };
+
+	long n = dims[d];
+
+	int log2n = 0;
+
+	while ((1L << log2n) < n)
+		log2n++;
+
+	float twr[n / 2];
+	float twi[n / 2];
+
+	for (long k = 0; k < n / 2; k++) {
+
+		double phase = (backwards ? 2. : -2.) * M_PI * (double)k / (double)n;
+
+		twr[k] = cos(phase);
+		twi[k] = sin(phase);
+	}
+
+	// all other dimensions are batch dimensions
+
+	int nb = 0;
+	long bdims[D];
+	long bistrs[D];
+	long bostrs[D];
+
+	for (int i = 0; i < D; i++) {
+
+		if ((i == d) || (1 == dims[i]))
+			continue;
+
+		bdims[nb] = dims[i];
+		bistrs[nb] = istrs[i];
+		bostrs[nb] = ostrs[i];
+		nb++;
+	}
+
+	long T = md_calc_size(nb, bdims);
+	long nblocks = (T + B - 1) / B;
+
+	long is = istrs[d];
+	long os = ostrs[d];
+
+	#pragma omp parallel for if (nblocks > 1)
+	for (long blk = 0; blk < nblocks; blk++) {
+
+		long bn = MIN(B, T - blk * B);
+
+		long ioffs[B];
+		long ooffs[B];
+
+		long pos[MAX(1, nb)];
+		long t = blk * B;
+
+		for (int i = 0; i < nb; i++) {
+
+			pos[i] = t % bdims[i];
+			t /= bdims[i];
+		}
+
+		for (long b = 0; b < bn; b++) {
+
+			ioffs[b] = 0;
+			ooffs[b] = 0;
+
+			for (int i = 0; i < nb; i++) {
+
+				ioffs[b] += pos[i] * bistrs[i];
+				ooffs[b] += pos[i] * bostrs[i];
+			}
+
+			for (int i = 0; i < nb; i++) {
+
+				if (++pos[i] < bdims[i])
+					break;
+
+				pos[i] = 0;
+			}
+		}
+
+		float buf[4][n * B];
+
+		float* xr = buf[0];
+		float* xi = buf[1];
+
+		for (long k = 0; k < n; k++) {
+
+			for (long b = 0; b < bn; b++) {
+
+				complex float v = *(const complex float*)((const void*)src + ioffs[b] + k * is);
+
+				xr[k * B + b] = crealf(v);
+				xi[k * B + b] = cimagf(v);
+			}
+
+			for (long b = bn; b < B; b++) {
+
+				xr[k * B + b] = 0.;
+				xi[k * B + b] = 0.;
+			}
+		}
+
+		fft_batch_block(n, xr, xi, buf[2], buf[3], twr, twi);
+
+		// after an odd number of stages, the result is in the second buffer
+
+		if (1 == log2n % 2) {
+
+			xr = buf[2];
+			xi = buf[3];
+		}
+
+		for (long k = 0; k < n; k++)
+			for (long b = 0; b < bn; b++)
+				*(complex float*)((void*)dst + ooffs[b] + k * os) = xr[k * B + b] + 1.i * xi[k * B + b];
+	}
+}
+
+
+/**
+ * Unnormalized FFT along all dimensions in flags. Each transformed
+ * dimension has to be a power of two not larger than FFT_BATCH_MAX.
+ */
+void fft_batch2(int D, const long dims[D], unsigned long flags, const long ostrs[D], complex float* dst, const long istrs[D], const complex float* src, bool backwards)
+{
+	flags &= md_nontriv_dims(D, dims);
+
+	assert(fft_batch_supported(D, dims, flags));
+
+	bool first = true;
+
+	for (int i = 0; i < D; i++) {
+
+		if (!MD_IS_SET(flags, i))
+			continue;
+
+		if (first)
+			fft_batch_dim(D, dims, i, ostrs, dst, istrs, src, backwards);
+		else
+			fft_batch_dim(D, dims, i, ostrs, dst, ostrs, dst, backwards);
+
+		first = false;
+	}
+}
@@ -0,0 +1,18 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ */
+
+#ifndef __FFT_BATCH_H
+#define __FFT_BATCH_H
+
+#include "misc/cppwrap.h"
+
+enum { FFT_BATCH_MAX = 64 };
+
+extern _Bool fft_batch_supported(int D, const long dims[__VLA(D)], unsigned long flags);
+extern void fft_batch2(int D, const long dims[__VLA(D)], unsigned long flags, const long ostrs[__VLA(D)], _Complex float* dst, const long istrs[__VLA(D)], const _Complex float* src, _Bool backwards);
+
+#include "misc/cppwrap.h"
+
+#endif
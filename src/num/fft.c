@@ -21,7 +21,16 @@
 #include <assert.h>
 #include <complex.h>
 #include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <sys/file.h>
+#endif
 
 #include <fftw3.h>
 
@@ -33,6 +42,7 @@
 #include "misc/debug.h"
 
 #include "fft.h"
+#include "fft-batch.h"
 #undef fft_plan_s
 
 #ifdef USE_CUDA
@@ -316,6 +326,7 @@ struct fft_plan_s {
 	INTERFACE(operator_data_t);
 
 	fftwf_plan fftw;
+	bool batch;
 
 	int D;
 	unsigned long flags;
@@ -333,57 +344,156 @@ static DEF_TYPEID(fft_plan_s);
 
 bool use_fftw_wisdom = false;
 
-static char* fftw_wisdom_name(int N, bool backwards, unsigned long flags, const long dims[N])
+static bool fftw_wisdom_loaded = false;
+
+
+/*
+ * All FFTW wisdom is kept in one database file which is shared by
+ * concurrent processes: $BART_FFTW_WISDOM or, by default,
+ * $TOOLBOX_PATH/save/fftw/wisdom. It is read once per process. New
+ * plans are merged with the current content of the file under an
+ * exclusive lock on "<file>.lock" and the file is replaced atomically.
+ *
+ * Must be called inside the critical section for the FFTW planner.
+ */
+static const char* fftw_wisdom_file(void)
 {
-	if (!use_fftw_wisdom)
-		return NULL;
+	static char* file = NULL;
+
+	if (NULL != file)
+		return file;
 
-	char* tbpath = getenv("TOOLBOX_PATH");
+	const char* str = getenv("BART_FFTW_WISDOM");
+
+	if (NULL != str)
+		return file = strdup(str);
+
+	const char* tbpath = getenv("TOOLBOX_PATH");
 
 	if (NULL == tbpath) {
 
-		debug_printf(DP_WARN, "FFTW wisdom only works with TOOLBOX_PATH set!\n");
+		debug_printf(DP_WARN, "FFTW wisdom only works with TOOLBOX_PATH or BART_FFTW_WISDOM set!\n");
 		return NULL;
 	}
 
-	// Space for path and null terminator.
-	int space = snprintf(NULL, 0, "%s/save/fftw/N_%d_BACKWARD_%d_FLAGS_%lu_DIMS", tbpath, N, backwards, flags);
+	int len = snprintf(NULL, 0, "%s/save/fftw/wisdom", tbpath) + 1;
+
+	file = xmalloc((size_t)len);
+	snprintf(file, (size_t)len, "%s/save/fftw/wisdom", tbpath);
+
+	return file;
+}
+
+static int fftw_wisdom_lock(const char* file, bool exclusive)
+{
+#ifndef _WIN32
+	char lock[strlen(file) + 6];
+	sprintf(lock, "%s.lock", file);
+
+	int fd = open(lock, O_RDWR | O_CREAT, 0666);
+
+	if (-1 == fd)
+		return -1;
+
+	if (-1 == flock(fd, exclusive ? LOCK_EX : LOCK_SH))
+		debug_printf(DP_WARN, "Could not lock FFTW wisdom.\n");
+
+	return fd;
+#else
+	UNUSED(file);
+	UNUSED(exclusive);
+	return -1;
+#endif
+}
+
+static void fftw_wisdom_unlock(int fd)
+{
+	if (-1 != fd)
+		close(fd);
+}
+
+static void fftw_wisdom_import(const char* file)
+{
+	FILE* fp = fopen(file, "r");
+
+	if (NULL == fp)
+		return;
+
+	fseek(fp, 0, SEEK_END);
+	long len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	char* str = xmalloc((size_t)len + 1);
+
+	if ((0 <= len) && ((size_t)len == fread(str, 1, (size_t)len, fp))) {
+
+		str[len] = '\0';
+
+		if ((0 < len) && !fftwf_import_wisdom_from_string(str))
+			debug_printf(DP_WARN, "Invalid FFTW wisdom in %s.\n", file);
+	}
+
+	xfree(str);
+	fclose(fp);
+}
+
+static bool fftw_wisdom_load(void)
+{
+	if (!use_fftw_wisdom)
+		return false;
+
+	const char* file = fftw_wisdom_file();
+
+	if (NULL == file)
+		return false;
+
+	if (!fftw_wisdom_loaded) {
+
+		int fd = fftw_wisdom_lock(file, false);
+
+		fftw_wisdom_import(file);
+
+		fftw_wisdom_unlock(fd);
+
+		fftw_wisdom_loaded = true;
+	}
+
+	return true;
+}
+
+static void fftw_wisdom_store(void)
+{
+	const char* file = fftw_wisdom_file();
+
+	int fd = fftw_wisdom_lock(file, true);
 
-	// Space for dimensions.
-	for (int idx = 0; idx < N; idx ++)
-		space += snprintf(NULL, 0, "_%lu", dims[idx]);
+	// merge plans stored by other processes in the meantime
 
-	// Space for extension.
-	space += snprintf(NULL, 0, ".fftw");
-	// Space for null terminator.
-	space += 1;
+	fftw_wisdom_import(file);
 
-	int len = space;
-	char* loc = calloc(space, sizeof(char));
+	char* str = fftwf_export_wisdom_to_string();
 
-	if (NULL == loc)
-		error("memory out");
+	char tmp[strlen(file) + 32];
+	sprintf(tmp, "%s.%ld", file, (long)getpid());
 
-	int ret = snprintf(loc, len, "%s/save/fftw/N_%d_BACKWARD_%d_FLAGS_%lu_DIMS", tbpath, N, backwards, flags);
+	FILE* fp = fopen(tmp, "w");
 
-	assert(ret < len);
-	len -= ret;
+	if (   (NULL == fp)
+	    || (EOF == fputs(str, fp))
+	    || (0 != fclose(fp))
+	    || (0 != rename(tmp, file))) {
 
-	for (int idx = 0; idx < N; idx++) {
+		debug_printf(DP_WARN, "Could not store FFTW wisdom in %s.\n", file);
+		unlink(tmp);
 
-		char tmp[64];
-		ret = sprintf(tmp, "_%lu", dims[idx]);
-		assert(ret < 64);
-		len -= ret;
-		strcat(loc, tmp);
+	} else {
+
+		debug_printf(DP_DEBUG1, "FFTW wisdom stored in %s.\n", file);
 	}
 
-	strcat(loc, ".fftw");
-	len -= 5;
-	assert(1 == len);
-	assert('\0' == loc[space - 1]);
+	free(str);
 
-	return loc;
+	fftw_wisdom_unlock(fd);
 }
 
 
@@ -397,12 +507,6 @@ static fftwf_plan fft_fftwf_plan(int D, const long dimensions[D], unsigned long
 	int k = 0;
 	int l = 0;
 
-	char* wisdom = fftw_wisdom_name(D, backwards, flags, dimensions);
-
-	if (NULL != wisdom)
-		fftwf_import_wisdom_from_filename(wisdom);
-
-
 	//FFTW seems to be fine with this
 	//assert(0 != flags); 
 
@@ -425,20 +529,44 @@ static fftwf_plan fft_fftwf_plan(int D, const long dimensions[D], unsigned long
 	}
 
 	#pragma omp critical
-	fftwf = fftwf_plan_guru64_dft(k, dims, l, hmdims, (complex float*)src, dst,
-				backwards ? 1 : (-1), measure ? FFTW_MEASURE : FFTW_ESTIMATE);
+	{
+		bool wisdom = fftw_wisdom_load();
+
+		// measured plans from the database do not need planning time
 
+		fftwf = NULL;
 
-	if (NULL != wisdom) {
+		if (wisdom)
+			fftwf = fftwf_plan_guru64_dft(k, dims, l, hmdims, (complex float*)src, dst,
+					backwards ? 1 : (-1), FFTW_MEASURE | FFTW_WISDOM_ONLY);
 
-		fftwf_export_wisdom_to_filename(wisdom);
-		xfree(wisdom);
+		if (NULL == fftwf) {
+
+			fftwf = fftwf_plan_guru64_dft(k, dims, l, hmdims, (complex float*)src, dst,
+					backwards ? 1 : (-1), measure ? FFTW_MEASURE : FFTW_ESTIMATE);
+
+			if (wisdom && measure)
+				fftw_wisdom_store();
+		}
 	}
 
 	return fftwf;
 }
 
 
+/*
+ * Write all plans of this process to the wisdom database.
+ */
+void fft_store_wisdom(void)
+{
+	#pragma omp critical
+	{
+		if (fftw_wisdom_load())
+			fftw_wisdom_store();
+	}
+}
+
+
 static void fft_apply(const operator_data_t* _plan, unsigned int N, void* args[N])
 {
 	complex float* dst = args[0];
@@ -467,7 +595,12 @@ static void fft_apply(const operator_data_t* _plan, unsigned int N, void* args[N
 
 	} else 
 #endif
-	{
+	if (plan->batch) {
+
+		fft_batch2(plan->D, plan->dims, plan->flags, plan->ostrs, dst, plan->istrs, src, plan->backwards);
+
+	} else {
+
 		assert(NULL != plan->fftw);
 		fftwf_execute_dft(plan->fftw, (complex float*)src, dst);
 	}
@@ -507,6 +640,7 @@ const struct operator_s* fft_measure_create(int D, const long dimensions[D], uns
 	md_calc_strides(D, strides, dimensions, CFL_SIZE);
 
 	plan->fftw = NULL;
+	plan->batch = false;
 
 	if (0u != flags)
 		plan->fftw = fft_fftwf_plan(D, dimensions, flags, strides, dst, strides, src, backwards, true);
@@ -543,6 +677,27 @@ const struct operator_s* fft_measure_create(int D, const long dimensions[D], uns
 }
 
 
+static bool fft_use_batch(int D, const long dimensions[D], unsigned long flags, const complex float* src)
+{
+	static int use_batch = -1;
+
+	if (-1 == use_batch) {
+
+		const char* str = getenv("BART_FFT_BATCH");
+
+		use_batch = (NULL == str) || (0 != atoi(str));
+	}
+
+#ifdef  USE_CUDA
+	if (cuda_ondevice(src))
+		return false;
+#else
+	UNUSED(src);
+#endif
+	return use_batch && fft_batch_supported(D, dimensions, flags);
+}
+
+
 const struct operator_s* fft_create2(int D, const long dimensions[D], unsigned long flags, const long ostrides[D], complex float* dst, const long istrides[D], const complex float* src, bool backwards)
 {
 	flags &= md_nontriv_dims(D, dimensions);
@@ -551,8 +706,13 @@ const struct operator_s* fft_create2(int D, const long dimensions[D], unsigned l
 	SET_TYPEID(fft_plan_s, plan);
 
 	plan->fftw = NULL;
+	plan->batch = false;
 
-	if (0u != flags)
+	// many small transforms do not need an FFTW plan
+
+	if ((0u != flags) && fft_use_batch(D, dimensions, flags, src))
+		plan->batch = true;
+	else if (0u != flags)
 		plan->fftw = fft_fftwf_plan(D, dimensions, flags, ostrides, dst, istrides, src, backwards, false);
 
 #ifdef  USE_CUDA
@@ -591,6 +751,191 @@ const struct operator_s* fft_create(int D, const long dimensions[D], unsigned lo
 
 
 
+/*
+ * Pruned FFT
+ *
+ * The multi-dimensional transform is computed as a sequence of 1D
+ * transforms along each dimension in flags. Along dimensions which
+ * have not been transformed yet, only rows inside the input box can be
+ * non-zero. Along dimensions which have already been transformed, only
+ * rows inside the output box are needed. The 1D transforms for all
+ * other rows are skipped. The input has to be zero outside the input
+ * box, the output is only valid inside the output box.
+ */
+struct fft_pruned_s {
+
+	INTERFACE(operator_data_t);
+
+	int D;
+	const long* dims;
+	const long* ostrs;
+	const long* istrs;
+
+	bool inplace;
+
+	int K;
+	const struct operator_s** steps;
+	long* offs;
+	long ioff;
+};
+
+static DEF_TYPEID(fft_pruned_s);
+
+static void fft_pruned_apply(const operator_data_t* _data, unsigned int N, void* args[N])
+{
+	const auto data = CAST_DOWN(fft_pruned_s, _data);
+
+	assert(2 == N);
+
+	complex float* dst = args[0];
+	const complex float* src = args[1];
+
+	assert(data->inplace == (dst == src));
+
+	if (0 == data->K) {
+
+		md_copy2(data->D, data->dims, data->ostrs, dst, data->istrs, src, CFL_SIZE);
+		return;
+	}
+
+	// the first step only writes rows inside the input box
+
+	if (!data->inplace)
+		md_clear2(data->D, data->dims, data->ostrs, dst, CFL_SIZE);
+
+	fft_exec(data->steps[0], (void*)dst + data->offs[0], (const void*)src + data->ioff);
+
+	for (int k = 1; k < data->K; k++)
+		fft_exec(data->steps[k], (void*)dst + data->offs[k], (void*)dst + data->offs[k]);
+}
+
+static void fft_pruned_free(const operator_data_t* _data)
+{
+	const auto data = CAST_DOWN(fft_pruned_s, _data);
+
+	for (int k = 0; k < data->K; k++)
+		fft_free(data->steps[k]);
+
+	xfree(data->steps);
+	xfree(data->offs);
+	xfree(data->dims);
+	xfree(data->istrs);
+	xfree(data->ostrs);
+
+	xfree(data);
+}
+
+/**
+ * Create a pruned FFT.
+ *
+ * @param ipos,idims box outside of which the input is zero
+ * @param opos,odims box inside of which the output is required
+ */
+const struct operator_s* fft_pruned_create2(int D, const long dimensions[D], unsigned long flags,
+		const long ipos[D], const long idims[D], const long opos[D], const long odims[D],
+		const long ostrides[D], complex float* dst, const long istrides[D], const complex float* src, bool backwards)
+{
+	flags &= md_nontriv_dims(D, dimensions);
+
+	for (int i = 0; i < D; i++) {
+
+		assert((0 <= ipos[i]) && (ipos[i] + idims[i] <= dimensions[i]));
+		assert((0 <= opos[i]) && (opos[i] + odims[i] <= dimensions[i]));
+		assert(MD_IS_SET(flags, i) || ((dimensions[i] == idims[i]) && (dimensions[i] == odims[i])));
+	}
+
+	PTR_ALLOC(struct fft_pruned_s, data);
+	SET_TYPEID(fft_pruned_s, data);
+
+	// Exchanging two adjacent dimensions a and b in the sequence does
+	// not increase the number of 1D transforms if o_a - i_a <= o_b - i_b,
+	// where o and i are the fractions of the output and input box.
+
+	int order[D];
+	double key[D];
+	int K = 0;
+
+	for (int i = 0; i < D; i++) {
+
+		if (!MD_IS_SET(flags, i))
+			continue;
+
+		double k = (double)(odims[i] - idims[i]) / (double)dimensions[i];
+		int j = K++;
+
+		for (; (0 < j) && (key[j - 1] > k); j--) {
+
+			order[j] = order[j - 1];
+			key[j] = key[j - 1];
+		}
+
+		order[j] = i;
+		key[j] = k;
+	}
+
+	data->K = K;
+	data->steps = *TYPE_ALLOC(const struct operator_s*[MAX(1, K)]);
+	data->offs = *TYPE_ALLOC(long[MAX(1, K)]);
+	data->ioff = 0;
+	data->inplace = (dst == src);
+
+	long sdims[D];
+	long spos[D];
+	md_copy_dims(D, sdims, idims);
+	md_copy_dims(D, spos, ipos);
+
+	for (int k = 0; k < K; k++) {
+
+		int d = order[k];
+
+		sdims[d] = dimensions[d];
+		spos[d] = 0;
+
+		data->offs[k] = md_calc_offset(D, ostrides, spos);
+
+		if (0 == k)
+			data->ioff = md_calc_offset(D, istrides, spos);
+
+		if (0 == k)
+			data->steps[k] = fft_create2(D, sdims, MD_BIT(d), ostrides, (void*)dst + data->offs[k],
+						istrides, (const void*)src + data->ioff, backwards);
+		else
+			data->steps[k] = fft_create2(D, sdims, MD_BIT(d), ostrides, (void*)dst + data->offs[k],
+						ostrides, (void*)dst + data->offs[k], backwards);
+
+		sdims[d] = odims[d];
+		spos[d] = opos[d];
+	}
+
+	data->D = D;
+
+	PTR_ALLOC(long[D], dims);
+	md_copy_dims(D, *dims, dimensions);
+	data->dims = *PTR_PASS(dims);
+
+	PTR_ALLOC(long[D], istrs);
+	md_copy_strides(D, *istrs, istrides);
+	data->istrs = *PTR_PASS(istrs);
+
+	PTR_ALLOC(long[D], ostrs);
+	md_copy_strides(D, *ostrs, ostrides);
+	data->ostrs = *PTR_PASS(ostrs);
+
+	return operator_create2(D, dimensions, ostrides, D, dimensions, istrides, CAST_UP(PTR_PASS(data)), fft_pruned_apply, fft_pruned_free);
+}
+
+const struct operator_s* fft_pruned_create(int D, const long dimensions[D], unsigned long flags,
+		const long ipos[D], const long idims[D], const long opos[D], const long odims[D],
+		complex float* dst, const complex float* src, bool backwards)
+{
+	long strides[D];
+	md_calc_strides(D, strides, dimensions, CFL_SIZE);
+
+	return fft_pruned_create2(D, dimensions, flags, ipos, idims, opos, odims, strides, dst, strides, src, backwards);
+}
+
+
+
 
 void fft_exec(const struct operator_s* o, complex float* dst, const complex float* src)
 {
@@ -634,6 +979,34 @@ void ifft(int D, const long dimensions[D], unsigned long flags, complex float* d
 	fft_free(plan);
 }
 
+void fft_pruned2(int D, const long dimensions[D], unsigned long flags, const long ipos[D], const long idims[D], const long opos[D], const long odims[D], const long ostrides[D], complex float* dst, const long istrides[D], const complex float* src)
+{
+	const struct operator_s* plan = fft_pruned_create2(D, dimensions, flags, ipos, idims, opos, odims, ostrides, dst, istrides, src, false);
+	fft_exec(plan, dst, src);
+	fft_free(plan);
+}
+
+void ifft_pruned2(int D, const long dimensions[D], unsigned long flags, const long ipos[D], const long idims[D], const long opos[D], const long odims[D], const long ostrides[D], complex float* dst, const long istrides[D], const complex float* src)
+{
+	const struct operator_s* plan = fft_pruned_create2(D, dimensions, flags, ipos, idims, opos, odims, ostrides, dst, istrides, src, true);
+	fft_exec(plan, dst, src);
+	fft_free(plan);
+}
+
+void fft_pruned(int D, const long dimensions[D], unsigned long flags, const long ipos[D], const long idims[D], const long opos[D], const long odims[D], complex float* dst, const complex float* src)
+{
+	const struct operator_s* plan = fft_pruned_create(D, dimensions, flags, ipos, idims, opos, odims, dst, src, false);
+	fft_exec(plan, dst, src);
+	fft_free(plan);
+}
+
+void ifft_pruned(int D, const long dimensions[D], unsigned long flags, const long ipos[D], const long idims[D], const long opos[D], const long odims[D], complex float* dst, const complex float* src)
+{
+	const struct operator_s* plan = fft_pruned_create(D, dimensions, flags, ipos, idims, opos, odims, dst, src, true);
+	fft_exec(plan, dst, src);
+	fft_free(plan);
+}
+
 void fftc(int D, const long dimensions[D], unsigned long flags, complex float* dst, const complex float* src)
 {
 	fftmod(D, dimensions, flags, dst, src);
@@ -712,6 +1085,7 @@ void ifftuc2(int D, const long dimensions[D], unsigned long flags, const long os
 
 
 bool fft_threads_init = false;
+static int fft_num_threads = 1;
 
 void fft_set_num_threads(int n)
 {
@@ -724,11 +1098,19 @@ void fft_set_num_threads(int n)
 	}
 
 	#pragma omp critical
-        fftwf_plan_with_nthreads(n);
+	{
+		fft_num_threads = n;
+		fftwf_plan_with_nthreads(n);
+	}
 #else
 	UNUSED(n);
 #endif
 }
 
+int fft_get_num_threads(void)
+{
+	return fft_num_threads;
+}
+
 
 
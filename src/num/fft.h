@@ -41,6 +41,12 @@ extern void ifft(int D, const long dimensions[__VLA(D)], unsigned long flags, _C
 extern void fft2(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ostrides[__VLA(D)], _Complex float* dst, const long istrides[__VLA(D)], const _Complex float* src);
 extern void ifft2(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ostrides[__VLA(D)], _Complex float* dst, const long istrides[__VLA(D)], const _Complex float* src);
 
+// pruned: input is zero outside of the box (ipos, idims), output is only computed inside of (opos, odims)
+extern void fft_pruned(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ipos[__VLA(D)], const long idims[__VLA(D)], const long opos[__VLA(D)], const long odims[__VLA(D)], _Complex float* dst, const _Complex float* src);
+extern void ifft_pruned(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ipos[__VLA(D)], const long idims[__VLA(D)], const long opos[__VLA(D)], const long odims[__VLA(D)], _Complex float* dst, const _Complex float* src);
+extern void fft_pruned2(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ipos[__VLA(D)], const long idims[__VLA(D)], const long opos[__VLA(D)], const long odims[__VLA(D)], const long ostrides[__VLA(D)], _Complex float* dst, const long istrides[__VLA(D)], const _Complex float* src);
+extern void ifft_pruned2(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ipos[__VLA(D)], const long idims[__VLA(D)], const long opos[__VLA(D)], const long odims[__VLA(D)], const long ostrides[__VLA(D)], _Complex float* dst, const long istrides[__VLA(D)], const _Complex float* src);
+
 // centered
 extern void fftc(int D, const long dimensions[__VLA(D)], unsigned long flags, _Complex float* dst, const _Complex float* src);
 extern void ifftc(int D, const long dimensions[__VLA(D)], unsigned long flags, _Complex float* dst, const _Complex float* src);
@@ -66,6 +72,8 @@ struct operator_s;
 extern const struct operator_s* fft_create(int D, const long dimensions[__VLA(D)], unsigned long flags, _Complex float* dst, const _Complex float* src, _Bool backwards);
 extern const struct operator_s* fft_create2(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ostrides[__VLA(D)], _Complex float* dst, const long istrides[__VLA(D)], const _Complex float* src, _Bool backwards);
 
+extern const struct operator_s* fft_pruned_create(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ipos[__VLA(D)], const long idims[__VLA(D)], const long opos[__VLA(D)], const long odims[__VLA(D)], _Complex float* dst, const _Complex float* src, _Bool backwards);
+extern const struct operator_s* fft_pruned_create2(int D, const long dimensions[__VLA(D)], unsigned long flags, const long ipos[__VLA(D)], const long idims[__VLA(D)], const long opos[__VLA(D)], const long odims[__VLA(D)], const long ostrides[__VLA(D)], _Complex float* dst, const long istrides[__VLA(D)], const _Complex float* src, _Bool backwards);
 extern const struct operator_s* fft_measure_create(int D, const long dimensions[__VLA(D)], unsigned long flags, _Bool inplace, _Bool backwards);
 
 
@@ -75,7 +83,9 @@ extern void fft_exec(const struct operator_s* plan, _Complex float* dst, const _
 extern void fft_free(const struct operator_s* plan);
 
 extern _Bool use_fftw_wisdom;
+extern void fft_store_wisdom(void);
 extern void fft_set_num_threads(int n);
+extern int fft_get_num_threads(void);
 
 
 #include "misc/cppwrap.h"
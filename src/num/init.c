@@ -25,6 +25,8 @@
 #include "misc/misc.h"
 
 #include "num/fft.h"
+#include "num/mem.h"
+#include "num/numa.h"
 
 #ifdef USE_CUDA
 #include "num/gpuops.h"
@@ -65,6 +67,8 @@ void num_init(void)
 #else
 	int p = 2;
 #endif
+	numa_init();
+
 #ifdef FFTWTHREADS
 	fft_set_num_threads(p);
 #endif
@@ -82,6 +86,20 @@ void num_init(void)
 	}
 		
 
+	const char* memcache_str;
+
+	if (NULL != (memcache_str = getenv("BART_MEMCACHE_CPU"))) {
+
+		long cache = strtoul(memcache_str, NULL, 10);
+
+		if ((1 != cache) && (0 != cache))
+			error("BART_MEMCACHE_CPU environment variable must be 0 or 1!\n");
+
+		if (0 == cache)
+			memcache_cpu_off();
+	}
+
+
 	const char* chunk_str;
 
 	if (NULL != (chunk_str = getenv("BART_PARALLEL_CHUNK_SIZE"))) {
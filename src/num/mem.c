@@ -11,6 +11,11 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -20,6 +25,8 @@
 #include "misc/misc.h"
 #include "misc/debug.h"
 
+#include "num/numa.h"
+
 #ifdef USE_CUDA
 #include "num/gpuops.h"
 #else
@@ -302,3 +309,273 @@ void* mem_device_malloc(int device, int stream, long size, void* (*device_alloc)
 
 
 
+
+
+
+/*
+ * Cache for large CPU allocations
+ *
+ * Iterative algorithms allocate and free the same temporaries in
+ * every iteration. For large arrays, each new allocation is mapped
+ * freshly by the C library and costs page faults and zeroing by the
+ * kernel. Here, sizes are rounded up to size classes (four for each
+ * power of two) and freed blocks are kept for reuse. Blocks are
+ * aligned to 2 MB and marked for transparent huge pages. The pages
+ * of a new block are touched in a parallel loop, so that they are
+ * placed on the NUMA nodes of the threads which later process the
+ * same parts of the array in statically scheduled loops.
+ *
+ * At most as much memory is kept in the cache as has been in use at
+ * the same time. Clearing the cache also resets this limit.
+ */
+
+enum { MEMCACHE_CPU_MIN = 1 << 16 };
+enum { MEMCACHE_CPU_PAGE = 1 << 12 };
+enum { MEMCACHE_CPU_ALIGN = 1 << 21 };
+enum { MEMCACHE_CPU_CLASSES = 256 };
+
+bool memcache_cpu = true;
+
+void memcache_cpu_off(void)
+{
+	memcache_cpu_clear();
+	memcache_cpu = false;
+}
+
+struct cpu_block_s {
+
+	struct mem_s mem;
+	struct cpu_block_s* next;
+};
+
+static tree_t cpu_pool = NULL;
+static struct cpu_block_s* cpu_cache[MEMCACHE_CPU_CLASSES] = { NULL };
+
+static struct {
+
+	long hits;
+	long misses;
+
+	size_t used;		// in size classes
+	size_t requested;	// as requested
+	size_t peak;
+	size_t limit;		// peak since the cache was cleared
+	size_t cached;
+
+	// accumulated over all allocations
+	double total_used;
+	double total_requested;
+
+} cpu_stats = { 0 };
+
+
+static void memcache_cpu_init(void)
+{
+	if (NULL != cpu_pool)
+		return;
+
+	#pragma omp critical(bart_memcache_cpu)
+	{
+		if (NULL == cpu_pool) {
+
+			cpu_pool = tree_create(ptr_cmp);
+		}
+	}
+}
+
+static int size_class(size_t size, size_t* csize)
+{
+	assert(MEMCACHE_CPU_MIN <= size);
+
+	int e = 0;
+
+	while (0 != ((size - 1) >> (e + 1)))
+		e++;
+
+	size_t top = ((size - 1) >> (e - 2)) + 1;
+
+	*csize = top << (e - 2);
+
+	return 4 * e + (int)top - 5;
+}
+
+static void* cpu_block_alloc(size_t len)
+{
+	void* ptr = NULL;
+
+#ifdef _WIN32
+	ptr = xmalloc(len);
+#else
+	// page alignment tags blocks of the cache (see mem_cpu_free)
+
+	if (0 != posix_memalign(&ptr, (len >= MEMCACHE_CPU_ALIGN) ? MEMCACHE_CPU_ALIGN : MEMCACHE_CPU_PAGE, len))
+		error("memory out\n");
+#endif
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	if (len >= MEMCACHE_CPU_ALIGN)
+		madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+
+	numa_first_touch(len, ptr);
+
+	return ptr;
+}
+
+bool memcache_cpu_p(size_t size)
+{
+	return memcache_cpu && (MEMCACHE_CPU_MIN <= size);
+}
+
+void* mem_cpu_malloc(size_t size)
+{
+	assert(memcache_cpu_p(size));
+
+	memcache_cpu_init();
+
+	size_t csize;
+	int c = size_class(size, &csize);
+
+	struct cpu_block_s* b = NULL;
+
+	#pragma omp critical(bart_memcache_cpu)
+	{
+		b = cpu_cache[c];
+
+		if (NULL != b) {
+
+			cpu_cache[c] = b->next;
+			cpu_stats.cached -= b->mem.len;
+			cpu_stats.hits++;
+
+		} else {
+
+			cpu_stats.misses++;
+		}
+
+		cpu_stats.used += csize;
+		cpu_stats.requested += size;
+		cpu_stats.peak = MAX(cpu_stats.peak, cpu_stats.used);
+		cpu_stats.limit = MAX(cpu_stats.limit, cpu_stats.used);
+		cpu_stats.total_used += csize;
+		cpu_stats.total_requested += size;
+	}
+
+	if (NULL == b) {
+
+		PTR_ALLOC(struct cpu_block_s, _b);
+
+		_b->mem.ptr = cpu_block_alloc(csize);
+		_b->mem.len = csize;
+		_b->mem.device_id = -1;
+		_b->mem.stream_id = 0;
+		_b->next = NULL;
+
+		b = PTR_PASS(_b);
+	}
+
+	b->mem.len_used = size;
+
+	tree_insert(cpu_pool, &b->mem);
+
+	return (void*)b->mem.ptr;
+}
+
+static int exact_p(const void* _rptr, const void* ptr)
+{
+	const struct mem_s* rptr = _rptr;
+
+	if (rptr->ptr == ptr)
+		return 0;
+
+	return (rptr->ptr > ptr) ? 1 : -1;
+}
+
+/**
+ * Return ptr to the cache. Returns false if ptr was not allocated
+ * with mem_cpu_malloc.
+ */
+bool mem_cpu_free(const void* ptr)
+{
+	if ((NULL == cpu_pool) || (NULL == ptr))
+		return false;
+
+#ifndef _WIN32
+	// other blocks are rarely page aligned, avoid the lookup
+
+	if (0 != (uintptr_t)ptr % MEMCACHE_CPU_PAGE)
+		return false;
+#endif
+	struct mem_s* m = tree_find(cpu_pool, ptr, exact_p, true);
+
+	if (NULL == m)
+		return false;
+
+	struct cpu_block_s* b = (struct cpu_block_s*)m;
+
+	size_t csize;
+	int c = size_class(m->len_used, &csize);
+
+	assert(csize == m->len);
+
+	bool keep = false;
+
+	#pragma omp critical(bart_memcache_cpu)
+	{
+		cpu_stats.used -= csize;
+		cpu_stats.requested -= m->len_used;
+
+		keep = memcache_cpu && (cpu_stats.cached + csize <= cpu_stats.limit);
+
+		if (keep) {
+
+			b->next = cpu_cache[c];
+			cpu_cache[c] = b;
+			cpu_stats.cached += csize;
+		}
+	}
+
+	if (!keep) {
+
+		free((void*)m->ptr);
+		xfree(b);
+	}
+
+	return true;
+}
+
+void debug_print_memcache_cpu(int dl)
+{
+	double used = cpu_stats.total_used;
+	double requested = cpu_stats.total_requested;
+
+	debug_printf(dl, "CPU memory cache: %ld hits, %ld misses, peak %zu bytes, %zu bytes cached, %zu bytes in use (%.1f%% lost to size classes)\n",
+			cpu_stats.hits, cpu_stats.misses, cpu_stats.peak, cpu_stats.cached, cpu_stats.used,
+			(0. == used) ? 0. : (100. * (used - requested) / used));
+}
+
+/**
+ * Release all cached CPU memory.
+ */
+void memcache_cpu_clear(void)
+{
+	if (NULL == cpu_pool)
+		return;
+
+	#pragma omp critical(bart_memcache_cpu)
+	{
+		for (int c = 0; c < MEMCACHE_CPU_CLASSES; c++) {
+
+			while (NULL != cpu_cache[c]) {
+
+				struct cpu_block_s* b = cpu_cache[c];
+				cpu_cache[c] = b->next;
+
+				free((void*)b->mem.ptr);
+				xfree(b);
+			}
+		}
+
+		cpu_stats.cached = 0;
+		cpu_stats.limit = cpu_stats.used;
+	}
+}
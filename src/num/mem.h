@@ -1,3 +1,4 @@
+#include <stddef.h>
 
 
 extern void memcache_init(void);
@@ -14,3 +15,10 @@ extern int mem_device_num(const void* ptr);
 extern void debug_print_memcache(int dl);
 extern _Bool memcache_is_empty(void);
 
+extern void memcache_cpu_off(void);
+extern void memcache_cpu_clear(void);
+extern _Bool memcache_cpu_p(size_t size);
+extern void* mem_cpu_malloc(size_t size);
+extern _Bool mem_cpu_free(const void* ptr);
+extern void debug_print_memcache_cpu(int dl);
+
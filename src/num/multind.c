@@ -52,6 +52,8 @@
 #include "misc/nested.h"
 
 #include "num/optimize.h"
+#include "num/mem.h"
+#include "num/numa.h"
 #ifdef USE_CUDA
 #include "num/gpuops.h"
 #include "num/gpukrnls.h"
@@ -126,6 +128,33 @@ void md_nary(int C, int D, const long dim[D], const long* str[C], void* ptr[C],
 
 
 
+static void md_parallel_nary_iter(int C, int D, const long dimc[D], int nparallel, const int parallel_b[nparallel], const long parallel_dim[nparallel],
+				const long* str[C], void* ptr[C], md_nary_fun_t fun, long i)
+{
+	// Recover place in parallel iteration space
+	long iter_i[D];
+	long ii = i;
+
+	for (int p = nparallel - 1; p >= 0; p--) {
+
+		iter_i[p] = ii % parallel_dim[p];
+		ii /= parallel_dim[p];
+	}
+
+	void* moving_ptr[C];
+
+	for (int j = 0; j < C; j++) {
+
+		moving_ptr[j] = ptr[j];
+
+		for(int p = 0; p < nparallel; p++)
+			moving_ptr[j] += iter_i[p] * str[j][parallel_b[p]];
+	}
+
+	md_nary(C, D, dimc, str, moving_ptr, fun);
+}
+
+
 /**
  * Generic functions which loops over all dimensions of a set of
  * multi-dimensional arrays and calls a given function for each position.
@@ -176,38 +205,49 @@ void md_parallel_nary(int C, int D, const long dim[D], unsigned long flags, cons
 	int outer_threads = MAX(1, MIN(old_threads, total_iterations));
 	int inner_threads = MAX(1, old_threads / outer_threads);
 
-	omp_set_num_threads(outer_threads);	
+#ifdef USE_CUDA
+	bool numa = numa_active() && !cuda_ondevice(ptr[0]);
+#else
+	bool numa = numa_active();
 #endif
+	if (numa && (1 < old_threads)) {
 
-	#pragma omp parallel for
-	for (long i = 0; i < total_iterations; i++) {
+		// Iterations are usually ordered by memory address. Assign them
+		// in the same contiguous partitions which are used for
+		// first-touch initialization (see num/numa.c), so that each
+		// thread mostly works on memory local to its node.
 
-#ifdef _OPENMP
-		omp_set_num_threads(inner_threads);
-#endif
-		gpu_threads_enter(gpu_stat);
+		#pragma omp parallel num_threads(old_threads)
+		{
+			long range[2];
+			numa_range(omp_get_thread_num(), omp_get_num_threads(), total_iterations, range);
 
-		// Recover place in parallel iteration space
-		long iter_i[D];
-		long ii = i;
+			omp_set_num_threads(inner_threads);
 
-		for (int p = nparallel - 1; p >= 0; p--) {
+			gpu_threads_enter(gpu_stat);
 
-			iter_i[p] = ii % parallel_dim[p];
-			ii /= parallel_dim[p];
+			for (long i = range[0]; i < range[1]; i++)
+				md_parallel_nary_iter(C, D, dimc, nparallel, parallel_b, parallel_dim, str, ptr, fun, i);
+
+			gpu_threads_leave(gpu_stat);
 		}
 
-		void* moving_ptr[C];
+		gpu_threads_free(gpu_stat);
+		return;
+	}
 
-		for (int j = 0; j < C; j++) {
+	omp_set_num_threads(outer_threads);	
+#endif
 
-			moving_ptr[j] = ptr[j];
+	#pragma omp parallel for
+	for (long i = 0; i < total_iterations; i++) {
 
-			for(int p = 0; p < nparallel; p++)
-				moving_ptr[j] += iter_i[p] * str[j][parallel_b[p]];
-		}
+#ifdef _OPENMP
+		omp_set_num_threads(inner_threads);
+#endif
+		gpu_threads_enter(gpu_stat);
 
-		md_nary(C, D, dimc, str, moving_ptr, fun);
+		md_parallel_nary_iter(C, D, dimc, nparallel, parallel_b, parallel_dim, str, ptr, fun, i);
 
 		gpu_threads_leave(gpu_stat);
 	}
@@ -693,6 +733,17 @@ long* md_calc_strides(int D, long str[D], const long dim[D], size_t size)
  */
 void md_clear(int D, const long dim[D], void* ptr, size_t size)
 {
+	size_t len = md_calc_size(D, dim) * size;
+
+#ifdef USE_CUDA
+	if (!cuda_ondevice(ptr) && numa_partition_p(len)) {
+#else
+	if (numa_partition_p(len)) {
+#endif
+		numa_clear(len, ptr);
+		return;
+	}
+
 	md_clear2(D, dim, MD_STRIDES(D, dim, size), ptr, size);
 }
 
@@ -2047,7 +2098,16 @@ void md_decompress(int D, const long dims[D], float* dst, const void* _src)
  */
 void* md_alloc(int D, const long dimensions[D], size_t size)
 {
-	return xmalloc(md_calc_size(D, dimensions) * size);
+	size_t len = md_calc_size(D, dimensions) * size;
+
+	if (memcache_cpu_p(len))
+		return mem_cpu_malloc(len);
+
+	void* ptr = xmalloc(len);
+
+	numa_first_touch(len, ptr);
+
+	return ptr;
 }
 
 
@@ -2142,7 +2202,8 @@ void md_free(const void* ptr)
 		cuda_free((void*)ptr);
 	else
 #endif
-	xfree(ptr);
+	if (!mem_cpu_free(ptr))
+		xfree(ptr);
 }
 
 
@@ -0,0 +1,301 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ *
+ * NUMA policy.
+ *
+ * Linux places a page on the memory node of the thread which touches
+ * it first. Large arrays are therefore initialized in contiguous
+ * partitions, one per thread, and md_parallel_nary assigns work to
+ * threads with the same partitioning, so that each thread mostly works
+ * on local memory. With BART_NUMA_BIND=1, the OpenMP threads are
+ * also bound to the nodes in the same order on machines with more
+ * than one node (unless this is already requested with OMP_PROC_BIND
+ * or OMP_PLACES).
+ *
+ * The policy only applies on machines with more than one node and
+ * can be disabled with BART_NUMA=0.
+ */
+
+#define _GNU_SOURCE
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "misc/misc.h"
+#include "misc/debug.h"
+
+#include "numa.h"
+
+
+enum { NUMA_PAGE = 4096 };
+enum { NUMA_MIN_SIZE = 1 << 20 };	// smaller arrays are not worth a parallel region
+enum { NUMA_MAX_NODES = 64 };
+
+bool numa_policy = true;
+
+static int nodes = -1;
+
+
+void numa_off(void)
+{
+	numa_policy = false;
+}
+
+
+bool numa_active(void)
+{
+	return numa_policy && (1 < numa_nodes());
+}
+
+
+/**
+ * Contiguous range [range[0], range[1]) of N work items assigned to
+ * thread t of T. If there are fewer items than threads, item i is
+ * assigned to thread (i * T) / N, i.e. the first thread of the group
+ * of threads which initialized the corresponding memory.
+ */
+void numa_range(int t, int T, long N, long range[2])
+{
+	range[0] = (t * N + T - 1) / T;
+	range[1] = ((t + 1) * N + T - 1) / T;
+}
+
+
+static long numa_threads(void)
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+
+bool numa_partition_p(size_t len)
+{
+	return numa_active() && (1 < numa_threads())
+		&& (len >= (size_t)MAX(NUMA_MIN_SIZE, NUMA_PAGE * numa_threads()));
+}
+
+
+static void numa_partitioned(size_t len, void* ptr, bool clear)
+{
+	long pages = (long)((len + NUMA_PAGE - 1) / NUMA_PAGE);
+
+	#pragma omp parallel
+	{
+#ifdef _OPENMP
+		int t = omp_get_thread_num();
+		int T = omp_get_num_threads();
+#else
+		int t = 0;
+		int T = 1;
+#endif
+		long range[2];
+		numa_range(t, T, pages, range);
+
+		size_t start = (size_t)range[0] * NUMA_PAGE;
+		size_t end = MIN(len, (size_t)range[1] * NUMA_PAGE);
+
+		if (start < end) {
+
+			if (clear) {
+
+				memset(ptr + start, 0, end - start);
+
+			} else {
+
+				for (size_t o = start; o < end; o += NUMA_PAGE)
+					((char*)ptr)[o] = 0;
+			}
+		}
+	}
+}
+
+
+/**
+ * Touch the pages of a new array in contiguous partitions,
+ * one per thread.
+ */
+void numa_first_touch(size_t len, void* ptr)
+{
+	if (numa_partition_p(len))
+		numa_partitioned(len, ptr, false);
+}
+
+
+/**
+ * Zero out a contiguous array with the same partitioning.
+ */
+void numa_clear(size_t len, void* ptr)
+{
+	if (numa_partition_p(len))
+		numa_partitioned(len, ptr, true);
+	else
+		memset(ptr, 0, len);
+}
+
+
+
+#ifdef __linux__
+static bool node_cpus(int n, cpu_set_t* set)
+{
+	char name[64];
+	snprintf(name, sizeof name, "/sys/devices/system/node/node%d/cpulist", n);
+
+	FILE* fp = fopen(name, "r");
+
+	if (NULL == fp)
+		return false;
+
+	CPU_ZERO(set);
+
+	int a, b;
+
+	while (1 <= fscanf(fp, "%d", &a)) {
+
+		b = a;
+
+		int c = fgetc(fp);
+
+		if ('-' == c) {
+
+			if (1 != fscanf(fp, "%d", &b))
+				break;
+
+			c = fgetc(fp);
+		}
+
+		for (int i = a; (i <= b) && (i < CPU_SETSIZE); i++)
+			CPU_SET(i, set);
+
+		if (',' != c)
+			break;
+	}
+
+	fclose(fp);
+
+	return true;
+}
+#endif
+
+
+int numa_nodes(void)
+{
+	if (0 <= nodes)
+		return nodes;
+
+	int n = 0;
+
+#ifdef __linux__
+	cpu_set_t set;
+
+	while ((n < NUMA_MAX_NODES) && node_cpus(n, &set))
+		n++;
+#endif
+
+	nodes = MAX(1, n);
+
+	return nodes;
+}
+
+
+/*
+ * Bind OpenMP thread t of T to node (t * nodes) / T. Threads are
+ * bound to all CPUs of a node, so that nested teams, which inherit
+ * the mask of the thread creating them, stay on the same node. The
+ * main thread is not bound, because other thread pools (e.g. FFTW)
+ * are started from it.
+ */
+static void numa_bind_threads(void)
+{
+#ifdef __linux__
+	int N = numa_nodes();
+
+	cpu_set_t node_set[N];
+
+	for (int n = 0; n < N; n++)
+		node_cpus(n, &node_set[n]);
+
+	cpu_set_t allowed;
+
+	if (0 != sched_getaffinity(0, sizeof allowed, &allowed))
+		return;
+
+	int bound = 0;
+
+	#pragma omp parallel reduction(+: bound)
+	{
+#ifdef _OPENMP
+		int t = omp_get_thread_num();
+		int T = omp_get_num_threads();
+#else
+		int t = 0;
+		int T = 1;
+#endif
+		int n = (int)(((long)t * N) / T);
+
+		cpu_set_t set;
+		CPU_AND(&set, &node_set[n], &allowed);
+
+		if ((0 < t) && (0 < CPU_COUNT(&set)) && (0 == sched_setaffinity(0, sizeof set, &set)))
+			bound++;
+	}
+
+	debug_printf(DP_DEBUG1, "NUMA: %d nodes, %d threads bound.\n", N, bound);
+#endif
+}
+
+
+void numa_init(void)
+{
+	const char* numa_str;
+
+	if (NULL != (numa_str = getenv("BART_NUMA"))) {
+
+		long numa = strtoul(numa_str, NULL, 10);
+
+		if ((1 != numa) && (0 != numa))
+			error("BART_NUMA environment variable must be 0 or 1!\n");
+
+		if (0 == numa)
+			numa_off();
+	}
+
+	bool bind = false;
+
+	if (NULL != (numa_str = getenv("BART_NUMA_BIND"))) {
+
+		long numa_bind = strtoul(numa_str, NULL, 10);
+
+		if ((1 != numa_bind) && (0 != numa_bind))
+			error("BART_NUMA_BIND environment variable must be 0 or 1!\n");
+
+		bind = (1 == numa_bind);
+	}
+
+	// also determines the number of nodes before any parallel region
+
+	if (!numa_active() || !bind)
+		return;
+
+	if ((NULL != getenv("OMP_PROC_BIND")) || (NULL != getenv("OMP_PLACES")))
+		return;
+
+	static bool bound = false;
+
+	if (!bound)
+		numa_bind_threads();
+
+	bound = true;
+}
@@ -0,0 +1,18 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ */
+
+#include <stddef.h>
+
+extern _Bool numa_policy;
+
+extern void numa_init(void);
+extern void numa_off(void);
+extern int numa_nodes(void);
+extern _Bool numa_active(void);
+
+extern void numa_range(int t, int T, long N, long range[2]);
+extern _Bool numa_partition_p(size_t len);
+extern void numa_first_touch(size_t len, void* ptr);
+extern void numa_clear(size_t len, void* ptr);
@@ -17,6 +17,7 @@
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #ifdef _WIN32
 #include <malloc.h>
@@ -195,6 +196,22 @@ const struct operator_s* operator_unref(const struct operator_s* x)
 }
 
 
+/**
+ * Check whether an operator is referenced more than once
+ *
+ * @param x operator
+ */
+bool operator_shared(const struct operator_s* x)
+{
+	int refcount;
+
+	#pragma omp atomic read
+	refcount = x->sptr.refcount;
+
+	return (1 < refcount);
+}
+
+
 void operator_debug(enum debug_levels dl, const struct operator_s* x)
 {
 	int N = operator_nr_args(x);
@@ -866,10 +883,197 @@ struct op_loop_s {
 
 	unsigned int parallel;
 	bool gpu;
+
+	bool sched;
+	struct op_loop_conf_s conf;
 };
 
 static DEF_TYPEID(op_loop_s);
 
+const struct op_loop_conf_s op_loop_conf_defaults = {
+
+	.workers = 0,
+	.mem_limit = 0.,
+};
+
+
+/*
+ * Nested parallelism is enabled once when an operator using it is
+ * created. The setting is not changed while operators are applied,
+ * as it is shared with other threads.
+ */
+static void op_enable_nesting(int levels)
+{
+#ifdef _OPENMP
+	#pragma omp critical (op_nesting)
+	if (omp_get_max_active_levels() < levels)
+		omp_set_max_active_levels(levels);
+#else
+	UNUSED(levels);
+#endif
+}
+
+
+/*
+ * Resident and peak resident memory of the process in bytes.
+ * The peak can be reset on Linux (>= 4.0) by writing to clear_refs.
+ */
+static long proc_mem(const char* key)
+{
+	long ret = -1;
+#ifdef __linux__
+	FILE* fp = fopen("/proc/self/status", "r");
+
+	if (NULL == fp)
+		return -1;
+
+	char line[128];
+	size_t len = strlen(key);
+
+	while (NULL != fgets(line, sizeof(line), fp)) {
+
+		if (0 == strncmp(line, key, len)) {
+
+			ret = 1024L * atol(line + len);
+			break;
+		}
+	}
+
+	fclose(fp);
+#else
+	UNUSED(key);
+#endif
+	return ret;
+}
+
+static bool proc_reset_peak(void)
+{
+#ifdef __linux__
+	FILE* fp = fopen("/proc/self/clear_refs", "w");
+
+	if (NULL == fp)
+		return false;
+
+	bool ok = (1 == fprintf(fp, "5"));
+
+	return (0 == fclose(fp)) && ok;
+#else
+	return false;
+#endif
+}
+
+
+/**
+ * Number of batch positions to process concurrently and threads
+ * available to each of them.
+ */
+int operator_loop_sched_threads(const struct op_loop_conf_s* conf, long positions, int* workers)
+{
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	int w = (0 < conf->workers) ? conf->workers : threads;
+
+	w = MAX(1, MIN(w, positions));
+
+	if (NULL != workers)
+		*workers = w;
+
+	return MAX(1, threads / w);
+}
+
+
+static void op_loop_pos(const struct op_loop_s* data, unsigned int N, void* args[N],
+			const long pdims[], const long cdims[], long i, md_nary_fun_t fun)
+{
+	unsigned int D = data->D;
+
+	long pos[D];
+
+	for (unsigned int j = 0; j < D; j++) {
+
+		pos[j] = i % pdims[j];
+		i /= pdims[j];
+	}
+
+	void* ptr[N];
+
+	for (unsigned int j = 0; j < N; j++)
+		ptr[j] = args[j] + md_calc_offset(D, data->strs[j], pos);
+
+	md_nary(N, D, cdims, data->strs, ptr, fun);
+}
+
+
+/*
+ * Run independent batch positions concurrently. Each worker gets
+ * an equal share of the threads for nested parallelism. If a memory
+ * limit is set, the first position is run alone to measure its peak
+ * memory and the number of concurrent workers is reduced so that
+ * the estimated total stays below the limit.
+ */
+static void op_loop_sched(const struct op_loop_s* data, unsigned int N, void* args[N], md_nary_fun_t fun)
+{
+	unsigned int D = data->D;
+
+	long pdims[D];
+	md_select_dims(D, data->parallel, pdims, data->dims0);
+
+	long cdims[D];
+	md_select_dims(D, ~data->parallel, cdims, data->dims0);
+
+	long total = md_calc_size(D, pdims);
+
+	int workers;
+	operator_loop_sched_threads(&data->conf, total, &workers);
+
+	long start = 0;
+
+	if ((0. < data->conf.mem_limit) && (1 < workers)) {
+
+		long rss0 = proc_mem("VmRSS:");
+		bool reset = proc_reset_peak();
+
+		op_loop_pos(data, N, args, pdims, cdims, start++, fun);
+
+		long peak = proc_mem("VmHWM:");
+		long rss1 = proc_mem("VmRSS:");
+
+		if (reset && (0 < rss0) && (rss0 < peak)) {
+
+			double avail = data->conf.mem_limit - (double)rss1;
+			long admit = (long)(avail / (double)(peak - rss0));
+
+			workers = MAX(1, MIN(workers, admit));
+
+			debug_printf(DP_DEBUG1, "Batch: %.1f MB per position, %.1f MB available, %d workers.\n",
+					(peak - rss0) / 1.E6, avail / 1.E6, workers);
+
+		} else {
+
+			debug_printf(DP_WARN, "Cannot measure memory use, memory limit ignored.\n");
+		}
+	}
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+	int inner = MAX(1, threads / workers);
+
+	debug_printf(DP_DEBUG1, "Batch: %ld positions, %d workers with %d threads.\n", total, workers, inner);
+
+	#pragma omp parallel for num_threads(workers) schedule(dynamic, 1)
+	for (long i = start; i < total; i++) {
+
+#ifdef _OPENMP
+		omp_set_num_threads(inner);
+#endif
+		op_loop_pos(data, N, args, pdims, cdims, i, fun);
+	}
+}
+
 static void op_loop_del(const operator_data_t* _data)
 {
 	const auto data = CAST_DOWN(op_loop_s, _data);
@@ -914,7 +1118,10 @@ static void op_loop_fun(const operator_data_t* _data, unsigned int N, void* args
 		gpu_threads_leave(gpu_stat);
 	};
 
-	md_parallel_nary(N, data->D, data->dims0, data->parallel, data->strs, args, op_loop_nary);
+	if (data->sched)
+		op_loop_sched(data, N, args, op_loop_nary);
+	else
+		md_parallel_nary(N, data->D, data->dims0, data->parallel, data->strs, args, op_loop_nary);
 
 	gpu_threads_free(gpu_stat);
 
@@ -934,11 +1141,11 @@ static void merge_dims(unsigned int D, long odims[D], const long idims1[D], cons
 	}
 }
 
-const struct operator_s* operator_loop_parallel2(unsigned int N, unsigned int D,
+static const struct operator_s* operator_loop_create(unsigned int N, unsigned int D,
 				const long dims[D], const long (*strs)[D],
 				const struct operator_s* op,
-				unsigned int flags, bool gpu)
-
+				unsigned int flags, bool gpu,
+				const struct op_loop_conf_s* conf)
 {
 	assert(N == operator_nr_args(op));
 
@@ -989,6 +1196,9 @@ const struct operator_s* operator_loop_parallel2(unsigned int N, unsigned int D,
 	data->parallel = flags;
 	data->gpu = gpu;
 
+	data->sched = (NULL != conf);
+	data->conf = (NULL != conf) ? *conf : op_loop_conf_defaults;
+
 	const struct operator_s* rop = operator_generic_create2(N, op->io_flags, D2, *dims2, *strs2, CAST_UP(PTR_PASS(data)), op_loop_fun, op_loop_del, NULL);
 
 	PTR_PASS(dims2);
@@ -997,6 +1207,14 @@ const struct operator_s* operator_loop_parallel2(unsigned int N, unsigned int D,
 	return rop;
 }
 
+const struct operator_s* operator_loop_parallel2(unsigned int N, unsigned int D,
+				const long dims[D], const long (*strs)[D],
+				const struct operator_s* op,
+				unsigned int flags, bool gpu)
+{
+	return operator_loop_create(N, D, dims, strs, op, flags, gpu, NULL);
+}
+
 const struct operator_s* (operator_loop2)(unsigned int N, const unsigned int D,
 				const long dims[D], const long (*strs)[D],
 				const struct operator_s* op)
@@ -1020,6 +1238,28 @@ const struct operator_s* operator_loop_parallel(unsigned int D, const long dims[
 	return operator_loop_parallel2(N, D, dims, strs, op, parallel, gpu);
 }
 
+/**
+ * Loop operator over the dimensions in 'parallel', processing
+ * several positions concurrently (see op_loop_sched).
+ */
+const struct operator_s* operator_loop_sched(unsigned int D, const long dims[D], const struct operator_s* op, unsigned int parallel, const struct op_loop_conf_s* conf)
+{
+	unsigned int N = operator_nr_args(op);
+	long strs[N][D];
+
+	for (unsigned int i = 0; i < N; i++) {
+
+		long tdims[D];
+		merge_dims(D, tdims, dims, operator_arg_domain(op, i)->dims);
+
+		md_calc_strides(D, strs[i], tdims, operator_arg_domain(op, i)->size);
+	}
+
+	op_enable_nesting(2);
+
+	return operator_loop_create(N, D, dims, strs, op, parallel, false, conf);
+}
+
 const struct operator_s* operator_loop(unsigned int D, const long dims[D], const struct operator_s* op)
 {
 	return operator_loop_parallel(D, dims, op, 0u, false);
@@ -1758,6 +1998,543 @@ const struct operator_s* operator_link_create_F(const struct operator_s* op, uns
 
 
 
+/*
+ * Operator applying a list of operators in the given order
+ *
+ * Each argument of each operator is either an argument of the
+ * combined operator or a buffer at a fixed offset in a single
+ * arena which is allocated once per application. The operator
+ * ref computes the same and is used for the graph representation
+ * and to find the operators contained.
+ *
+ * Operators which do not depend on each other, i.e. which do not
+ * access the same memory with at least one of them writing, are
+ * executed concurrently as OpenMP tasks. Each operator gets a share
+ * of the threads according to the number of operators at the same
+ * depth of the dependency graph.
+ */
+struct operator_plan_s {
+
+	INTERFACE(operator_data_t);
+
+	int N_ops;
+	const struct operator_s** ops;
+	const char** names;
+
+	// index of the argument (>= 0) or of a buffer (-1 - b)
+	int** map;
+
+	size_t* offset;
+
+	size_t arena;
+	size_t unplanned;
+
+	// dependencies
+	int* npred;
+	int* nsucc;
+	int** succ;
+
+	// number of operators at the same depth
+	int* width;
+	int workers;
+
+	const struct operator_s* ref;
+};
+
+static DEF_TYPEID(operator_plan_s);
+
+
+struct plan_event_s {
+
+	const char* name;
+	int app;
+	int node;
+	int thread;
+	double start;
+	double end;
+	bool critical;
+};
+
+static struct {
+
+	const char* filename;
+	int apps;
+	long N;
+	long max;
+	struct plan_event_s* events;
+	double t0;
+
+} plan_trace = { NULL, 0, 0, 0, NULL, 0. };
+
+
+/**
+ * Record the execution of all operators created by operator_plan_create
+ * until operator_plan_trace_stop is called, which writes the events to
+ * filename in the Chrome trace event format. Operators on the critical
+ * path of each application are marked.
+ */
+void operator_plan_trace_start(const char* filename)
+{
+	assert(NULL == plan_trace.filename);
+
+	plan_trace.filename = filename;
+	plan_trace.apps = 0;
+	plan_trace.N = 0;
+	plan_trace.max = 0;
+	plan_trace.events = NULL;
+	plan_trace.t0 = timestamp();
+}
+
+static void json_string(FILE* fp, const char* str)
+{
+	fputc('"', fp);
+
+	for (const unsigned char* p = (const unsigned char*)str; '\0' != *p; p++) {
+
+		if (('"' == *p) || ('\\' == *p))
+			fprintf(fp, "\\%c", *p);
+		else if (0x20 > *p)
+			fprintf(fp, "\\u%04x", *p);
+		else
+			fputc(*p, fp);
+	}
+
+	fputc('"', fp);
+}
+
+void operator_plan_trace_stop(void)
+{
+	if (NULL == plan_trace.filename)
+		return;
+
+	FILE* fp = fopen(plan_trace.filename, "w");
+
+	if (NULL == fp)
+		error("Opening file '%s' for graph trace.\n", plan_trace.filename);
+
+	fprintf(fp, "[\n");
+
+	for (long i = 0; i < plan_trace.N; i++) {
+
+		const struct plan_event_s* ev = &plan_trace.events[i];
+
+		fprintf(fp, "{\"name\": ");
+		json_string(fp, ev->name);
+		fprintf(fp, ", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+				"\"args\": {\"plan\": %d, \"node\": %d, \"critical\": %d}}%s\n",
+				ev->thread, (ev->start - plan_trace.t0) * 1.E6, (ev->end - ev->start) * 1.E6,
+				ev->app, ev->node, ev->critical ? 1 : 0, (i + 1 < plan_trace.N) ? "," : "");
+	}
+
+	fprintf(fp, "]\n");
+
+	if (0 != fclose(fp))
+		error("Writing graph trace.\n");
+
+	debug_printf(DP_DEBUG1, "Graph trace: %ld events of %d applications.\n", plan_trace.N, plan_trace.apps);
+
+	for (long i = 0; i < plan_trace.N; i++)
+		xfree(plan_trace.events[i].name);
+
+	xfree(plan_trace.events);
+
+	plan_trace.filename = NULL;
+	plan_trace.events = NULL;
+}
+
+static void plan_trace_append(const struct operator_plan_s* data, struct plan_event_s ev[data->N_ops])
+{
+	// longest path through the dependency graph
+
+	double best[data->N_ops];
+	int from[data->N_ops];
+
+	for (int k = 0; k < data->N_ops; k++) {
+
+		best[k] = 0.;
+		from[k] = -1;
+	}
+
+	int last = 0;
+
+	for (int k = 0; k < data->N_ops; k++) {
+
+		double fin = best[k] + (ev[k].end - ev[k].start);
+
+		for (int i = 0; i < data->nsucc[k]; i++) {
+
+			int s = data->succ[k][i];
+
+			if (fin > best[s]) {
+
+				best[s] = fin;
+				from[s] = k;
+			}
+		}
+
+		if (fin > best[last] + (ev[last].end - ev[last].start))
+			last = k;
+
+		ev[k].critical = false;
+	}
+
+	for (int k = last; -1 != k; k = from[k])
+		ev[k].critical = true;
+
+	#pragma omp critical (plan_trace)
+	{
+		int app = plan_trace.apps++;
+
+		if (plan_trace.N + data->N_ops > plan_trace.max) {
+
+			plan_trace.max = MAX(2 * plan_trace.max, plan_trace.N + data->N_ops);
+			plan_trace.events = realloc(plan_trace.events, (size_t)plan_trace.max * sizeof(struct plan_event_s));
+
+			if (NULL == plan_trace.events)
+				error("Out of memory for graph trace.\n");
+		}
+
+		for (int k = 0; k < data->N_ops; k++) {
+
+			ev[k].app = app;
+			ev[k].name = strdup(ev[k].name);
+			plan_trace.events[plan_trace.N++] = ev[k];
+		}
+	}
+}
+
+
+static void plan_apply_node(const struct operator_plan_s* data, unsigned int N, void* args[N], char* arena, int k, struct plan_event_s* ev)
+{
+	int A = operator_nr_args(data->ops[k]);
+	void* args2[A];
+
+	for (int a = 0; a < A; a++) {
+
+		int m = data->map[k][a];
+
+		assert(m < (int)N);
+
+		args2[a] = (0 <= m) ? args[m] : (arena + data->offset[-1 - m]);
+	}
+
+	if (NULL != ev) {
+
+		ev->name = data->names[k];
+		ev->node = k;
+		ev->thread = 0;
+#ifdef _OPENMP
+		ev->thread = omp_get_thread_num();
+#endif
+		ev->start = timestamp();
+	}
+
+	operator_generic_apply_unchecked(data->ops[k], A, args2);
+
+	if (NULL != ev)
+		ev->end = timestamp();
+}
+
+#ifdef _OPENMP
+static void plan_task(const struct operator_plan_s* data, unsigned int N, void* args[N], char* arena, int count[data->N_ops],
+			int threads, struct cuda_threads_s* gpu_stat, int k, struct plan_event_s* ev)
+{
+	#pragma omp task
+	{
+		omp_set_num_threads(MAX(1, threads / MIN(data->workers, data->width[k])));
+
+		gpu_threads_enter(gpu_stat);
+		plan_apply_node(data, N, args, arena, k, (NULL == ev) ? NULL : &ev[k]);
+		gpu_threads_leave(gpu_stat);
+
+		for (int i = 0; i < data->nsucc[k]; i++) {
+
+			int s = data->succ[k][i];
+			int c;
+
+			#pragma omp atomic capture
+			c = --count[s];
+
+			if (0 == c)
+				plan_task(data, N, args, arena, count, threads, gpu_stat, s, ev);
+		}
+	}
+}
+#endif
+
+static void plan_apply(const operator_data_t* _data, unsigned int N, void* args[N])
+{
+	auto data = CAST_DOWN(operator_plan_s, _data);
+
+#ifdef USE_CUDA
+	bool gpu = false;
+
+	for (unsigned int i = 0; i < N; i++)
+		gpu = gpu || cuda_ondevice(args[i]);
+
+	char* arena = (gpu ? md_alloc_gpu : md_alloc)(1, MD_DIMS(data->arena), 1);
+#else
+	char* arena = md_alloc(1, MD_DIMS(data->arena), 1);
+#endif
+
+	struct plan_event_s ev[data->N_ops];
+	bool trace = (NULL != plan_trace.filename);
+
+	int threads = 1;
+#ifdef _OPENMP
+	threads = omp_get_max_threads();
+#endif
+
+	if ((1 < threads) && (1 < data->workers)) {
+#ifdef _OPENMP
+		int count[data->N_ops];
+
+		for (int k = 0; k < data->N_ops; k++)
+			count[k] = data->npred[k];
+
+		int workers = MIN(threads, data->workers);
+
+		struct cuda_threads_s* gpu_stat = gpu_threads_create(NULL);
+
+		#pragma omp parallel num_threads(workers)
+		#pragma omp single
+		{
+			for (int k = 0; k < data->N_ops; k++)
+				if (0 == data->npred[k])
+					plan_task(data, N, args, arena, count, threads, gpu_stat, k, trace ? ev : NULL);
+		}
+
+		gpu_threads_free(gpu_stat);
+#endif
+	} else {
+
+		for (int k = 0; k < data->N_ops; k++)
+			plan_apply_node(data, N, args, arena, k, trace ? &ev[k] : NULL);
+	}
+
+	if (trace)
+		plan_trace_append(data, ev);
+
+	md_free(arena);
+}
+
+static void plan_del(const operator_data_t* _data)
+{
+	auto data = CAST_DOWN(operator_plan_s, _data);
+
+	for (int k = 0; k < data->N_ops; k++) {
+
+		operator_free(data->ops[k]);
+		xfree(data->names[k]);
+		xfree(data->map[k]);
+		xfree(data->succ[k]);
+	}
+
+	xfree(data->ops);
+	xfree(data->names);
+	xfree(data->map);
+	xfree(data->offset);
+	xfree(data->npred);
+	xfree(data->nsucc);
+	xfree(data->succ);
+	xfree(data->width);
+
+	operator_free(data->ref);
+
+	xfree(data);
+}
+
+static const struct graph_s* operator_plan_get_graph(const struct operator_s* op)
+{
+	const auto d = CAST_DOWN(operator_plan_s, op->data);
+	return operator_get_graph(d->ref);
+}
+
+
+// arguments a of operator j and b of operator k access the same memory
+
+static bool plan_args_overlap(const struct operator_plan_s* data, int j, int a, int k, int b)
+{
+	int mj = data->map[j][a];
+	int mk = data->map[k][b];
+
+	if ((0 <= mj) || (0 <= mk))
+		return (mj == mk);
+
+	auto iovj = operator_arg_domain(data->ops[j], a);
+	auto iovk = operator_arg_domain(data->ops[k], b);
+
+	size_t offj = data->offset[-1 - mj];
+	size_t offk = data->offset[-1 - mk];
+
+	return (offj < offk + md_calc_size(iovk->N, iovk->dims) * iovk->size)
+		&& (offk < offj + md_calc_size(iovj->N, iovj->dims) * iovj->size);
+}
+
+static bool plan_depends(const struct operator_plan_s* data, int j, int k)
+{
+	for (int a = 0; a < (int)operator_nr_args(data->ops[j]); a++)
+		for (int b = 0; b < (int)operator_nr_args(data->ops[k]); b++)
+			if (   (data->ops[j]->io_flags[a] || data->ops[k]->io_flags[b])
+			    && plan_args_overlap(data, j, a, k, b))
+				return true;
+
+	return false;
+}
+
+static void plan_dependencies(struct operator_plan_s* data)
+{
+	int N_ops = data->N_ops;
+
+	data->npred = *TYPE_ALLOC(int[N_ops]);
+	data->nsucc = *TYPE_ALLOC(int[N_ops]);
+	data->succ = *TYPE_ALLOC(int*[N_ops]);
+	data->width = *TYPE_ALLOC(int[N_ops]);
+
+	int depth[N_ops];
+	int count[N_ops];
+
+	for (int k = 0; k < N_ops; k++) {
+
+		data->npred[k] = 0;
+		data->nsucc[k] = 0;
+		data->succ[k] = xmalloc((size_t)N_ops * sizeof(int));
+
+		depth[k] = 0;
+		count[k] = 0;
+	}
+
+	for (int j = 0; j < N_ops; j++) {
+
+		for (int k = j + 1; k < N_ops; k++) {
+
+			if (!plan_depends(data, j, k))
+				continue;
+
+			data->succ[j][data->nsucc[j]++] = k;
+			data->npred[k]++;
+
+			depth[k] = MAX(depth[k], depth[j] + 1);
+		}
+	}
+
+	data->workers = 0;
+
+	for (int k = 0; k < N_ops; k++)
+		count[depth[k]]++;
+
+	for (int k = 0; k < N_ops; k++) {
+
+		data->width[k] = count[depth[k]];
+		data->workers = MAX(data->workers, data->width[k]);
+	}
+
+	// independent operators are only applied concurrently on request
+
+	bool concurrent = false;
+	const char* str = getenv("BART_GRAPH_CONCURRENT");
+
+	if (NULL != str) {
+
+		int val = atoi(str);
+
+		if ((0 > val) || (1 < val))
+			error("BART_GRAPH_CONCURRENT environment variable must be 0 or 1!\n");
+
+		concurrent = (1 == val);
+	}
+
+	if (!concurrent)
+		data->workers = 1;
+}
+
+/**
+ * Create an operator which applies ops in the given order with the
+ * arguments given by map. ref has to compute the same as the list of
+ * operators and determines the arguments of the created operator.
+ * The names (optional) are used for tracing.
+ */
+const struct operator_s* operator_plan_create(const struct operator_s* ref, int N_ops, const struct operator_s* ops[N_ops], const char* names[N_ops], const int* map[N_ops],
+				int N_bufs, const size_t offset[N_bufs], size_t arena, size_t unplanned)
+{
+	int N = operator_nr_args(ref);
+
+	unsigned int D[N];
+	const long* dims[N];
+	const long* strs[N];
+
+	for (int i = 0; i < N; i++) {
+
+		auto iov = operator_arg_domain(ref, i);
+
+		D[i] = iov->N;
+		dims[i] = iov->dims;
+		strs[i] = iov->strs;
+	}
+
+	PTR_ALLOC(struct operator_plan_s, data);
+	SET_TYPEID(operator_plan_s, data);
+
+	data->N_ops = N_ops;
+	data->ops = *TYPE_ALLOC(const struct operator_s*[N_ops]);
+	data->names = *TYPE_ALLOC(const char*[N_ops]);
+	data->map = *TYPE_ALLOC(int*[N_ops]);
+
+	for (int k = 0; k < N_ops; k++) {
+
+		int A = operator_nr_args(ops[k]);
+
+		data->ops[k] = operator_ref(ops[k]);
+		data->names[k] = strdup(((NULL != names) && (NULL != names[k])) ? names[k] : ops[k]->data->TYPEID->name);
+		data->map[k] = xmalloc((size_t)A * sizeof(int));
+
+		for (int a = 0; a < A; a++) {
+
+			assert(map[k][a] < N);
+			assert(-N_bufs <= map[k][a]);
+			assert((0 <= map[k][a]) || (offset[-1 - map[k][a]] < arena));
+
+			data->map[k][a] = map[k][a];
+		}
+	}
+
+	data->offset = *TYPE_ALLOC(size_t[MAX(1, N_bufs)]);
+
+	for (int b = 0; b < N_bufs; b++)
+		data->offset[b] = offset[b];
+
+	data->arena = arena;
+	data->unplanned = unplanned;
+	data->ref = operator_ref(ref);
+
+	plan_dependencies(data);
+
+	if (1 < data->workers)
+		op_enable_nesting(2);
+
+	debug_printf(DP_DEBUG2, "Operator plan: up to %d operators concurrently.\n", data->workers);
+
+	return operator_generic_create2(N, ref->io_flags, D, dims, strs, CAST_UP(PTR_PASS(data)), plan_apply, plan_del, operator_plan_get_graph);
+}
+
+/**
+ * Size of the arena of intermediate results allocated when applying
+ * op, or 0 if op is not created by operator_plan_create. If unplanned
+ * is not NULL, it is set to the memory all intermediate results would
+ * take up without sharing.
+ */
+size_t operator_plan_arena_size(const struct operator_s* op, size_t* unplanned)
+{
+	auto data = CAST_MAYBE(operator_plan_s, op->data);
+
+	if (NULL != unplanned)
+		*unplanned = (NULL == data) ? 0 : data->unplanned;
+
+	return (NULL == data) ? 0 : data->arena;
+}
+
+
+
 struct permute_data_s {
 
 	INTERFACE(operator_data_t);
@@ -2551,6 +3328,7 @@ list_t operator_get_list(const struct operator_s* op) {
 	auto data_plus = CAST_MAYBE(operator_plus_s, op->data);
 	auto data_copy = CAST_MAYBE(copy_data_s, op->data);
 	auto data_attach = CAST_MAYBE(attach_data_s, op->data);
+	auto data_plan = CAST_MAYBE(operator_plan_s, op->data);
 
 	if (NULL != data_combi) {
 
@@ -2605,6 +3383,11 @@ list_t operator_get_list(const struct operator_s* op) {
 		return operator_get_list(data_attach->op);
 	}
 
+	if (NULL != data_plan) {
+
+		return operator_get_list(data_plan->ref);
+	}
+
 	list_t result = list_create();
 	list_append(result, (void*)op);
 
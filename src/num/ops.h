@@ -75,6 +75,7 @@ extern void operator_free(const struct operator_s* x);
 
 extern const struct operator_s* operator_ref(const struct operator_s* x);
 extern const struct operator_s* operator_unref(const struct operator_s* x);
+extern _Bool operator_shared(const struct operator_s* x);
 
 #define OP_PASS(x) (operator_unref(x))
 
@@ -132,11 +133,27 @@ const struct operator_s* operator_loop_parallel2(unsigned int N, const unsigned
 extern const struct operator_s* operator_loop(unsigned int D, const long dims[D], const struct operator_s* op);
 extern const struct operator_s* operator_loop_parallel(unsigned int D, const long dims[D], const struct operator_s* op, unsigned int parallel, _Bool gpu);
 
+struct op_loop_conf_s {
+
+	int workers;		///< positions processed concurrently (0: one per thread)
+	double mem_limit;	///< limit for resident memory in bytes (0: none)
+};
+
+extern const struct op_loop_conf_s op_loop_conf_defaults;
+
+extern int operator_loop_sched_threads(const struct op_loop_conf_s* conf, long positions, int* workers);
+extern const struct operator_s* operator_loop_sched(unsigned int D, const long dims[D], const struct operator_s* op, unsigned int parallel, const struct op_loop_conf_s* conf);
+
 
 extern const struct operator_s* operator_combi_create(int N, const struct operator_s* x[N]);
 extern const struct operator_s* operator_combi_create_FF(int N, const struct operator_s* x[N]);
 extern const struct operator_s* operator_link_create(const struct operator_s* op, unsigned int o, unsigned int i);
 extern const struct operator_s* operator_link_create_F(const struct operator_s* op, unsigned int o, unsigned int i);
+extern const struct operator_s* operator_plan_create(const struct operator_s* ref, int N_ops, const struct operator_s* ops[__VLA(N_ops)], const char* names[__VLA(N_ops)], const int* map[__VLA(N_ops)],
+				int N_bufs, const size_t offset[__VLA(N_bufs)], size_t arena, size_t unplanned);
+extern size_t operator_plan_arena_size(const struct operator_s* op, size_t* unplanned);
+extern void operator_plan_trace_start(const char* filename);
+extern void operator_plan_trace_stop(void);
 extern const struct operator_s* operator_dup_create(const struct operator_s* op, unsigned int a, unsigned int b);
 extern const struct operator_s* operator_dup_create_F(const struct operator_s* op, unsigned int a, unsigned int b);
 extern const struct operator_s* operator_extract_create(const struct operator_s* op, int a, int N, const long dims[N], const long pos[N]);
@@ -6,6 +6,8 @@
 #include <assert.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "misc/misc.h"
 #include "misc/types.h"
@@ -15,6 +17,7 @@
 
 #include "num/ops.h"
 #include "num/iovec.h"
+#include "num/multind.h"
 
 #include "ops_graph.h"
 
@@ -586,13 +589,305 @@ static graph_t graph_to_op_permute_F(graph_t graph)
 	return graph;
 }
 
+/*
+ * Static memory plan for a cluster of operators
+ *
+ * The operator created by combine, dup, and link allocates all
+ * intermediate results of a cluster at the same time. Instead, the
+ * operators are executed in topological order and all intermediate
+ * results are placed into a single arena. Buffers whose lifetimes
+ * do not overlap share the same memory. Offsets are assigned with a
+ * first-fit strategy in the order the buffers are produced.
+ */
+
+enum { PLAN_ALIGN = 256 };
+
+struct memory_plan_s {
+
+	int N_ops;
+	const struct operator_s** ops;
+	const char** names;
+
+	// index of the argument (>= 0) or of a buffer (-1 - b)
+	int** map;
+
+	int N_bufs;
+	size_t* offset;
+
+	size_t arena;
+	size_t unplanned;
+};
+
+static void memory_plan_free(struct memory_plan_s* plan)
+{
+	for (int k = 0; k < plan->N_ops; k++) {
+
+		xfree(plan->map[k]);
+		xfree(plan->names[k]);
+	}
+
+	xfree(plan->ops);
+	xfree(plan->names);
+	xfree(plan->map);
+	xfree(plan->offset);
+	xfree(plan);
+}
+
+
+static int ext_node_index(graph_t graph, node_t node)
+{
+	for (int i = 0; i < list_count(graph->ext_nodes); i++)
+		if (node == list_get_item(graph->ext_nodes, i))
+			return i;
+
+	return -1;
+}
+
+
+/*
+ * Liveness analysis and buffer assignment for a topologically
+ * sorted graph. Returns NULL if there is nothing to plan.
+ */
+static struct memory_plan_s* graph_memory_plan(graph_t graph)
+{
+	int N_ops = list_count(graph->nodes);
+
+	for (int k = 0; k < N_ops; k++)
+		((node_t)list_get_item(graph->nodes, k))->count = k;
+
+	// buffers for all outputs which are not an output of the cluster
+
+	int N_bufs = 0;
+	int* buf_idx[N_ops];
+
+	for (int k = 0; k < N_ops; k++) {
+
+		node_t node = list_get_item(graph->nodes, k);
+
+		buf_idx[k] = xmalloc((size_t)node->N_vertices * sizeof(int));
+
+		for (int a = 0; a < node->N_vertices; a++) {
+
+			buf_idx[k][a] = -1;
+
+			if (!node->io_flags[a])
+				continue;
+
+			int ext = 0;
+
+			for (int e = 0; e < list_count(node->edges[a]); e++)
+				if (((vertex_t)list_get_item(node->edges[a], e))->node->external)
+					ext++;
+
+			if (0 == ext)
+				buf_idx[k][a] = N_bufs++;
+		}
+	}
+
+	if (0 == N_bufs) {
+
+		for (int k = 0; k < N_ops; k++)
+			xfree(buf_idx[k]);
+
+		return NULL;
+	}
+
+	PTR_ALLOC(struct memory_plan_s, plan);
+
+	plan->N_ops = N_ops;
+	plan->N_bufs = N_bufs;
+	plan->ops = *TYPE_ALLOC(const struct operator_s*[N_ops]);
+	plan->names = *TYPE_ALLOC(const char*[N_ops]);
+	plan->map = *TYPE_ALLOC(int*[N_ops]);
+	plan->offset = *TYPE_ALLOC(size_t[N_bufs]);
+
+	size_t size[N_bufs];
+	int first[N_bufs];
+	int last[N_bufs];
+
+	bool ok = true;
+
+	for (int k = 0; k < N_ops; k++) {
+
+		node_t node = list_get_item(graph->nodes, k);
+
+		plan->ops[k] = get_operator_from_node(node);
+		plan->names[k] = (NULL != node->name) ? strdup(node->name) : NULL;
+		plan->map[k] = xmalloc((size_t)node->N_vertices * sizeof(int));
+
+		for (int a = 0; a < node->N_vertices; a++) {
+
+			if (node->io_flags[a]) {
+
+				int b = buf_idx[k][a];
+
+				if (0 <= b) {
+
+					auto iov = get_iovec_from_node(node, a);
+
+					ok = ok && ((int)iov->N == md_calc_blockdim(iov->N, iov->dims, iov->strs, iov->size));
+
+					size[b] = (md_calc_size(iov->N, iov->dims) * iov->size + PLAN_ALIGN - 1) & ~(size_t)(PLAN_ALIGN - 1);
+					first[b] = k;
+					last[b] = k;
+
+					plan->map[k][a] = -1 - b;
+
+				} else {
+
+					// written to an output of the cluster, and
+					// read from there by other operators
+
+					int ext = -1;
+
+					for (int e = 0; e < list_count(node->edges[a]); e++) {
+
+						vertex_t v = list_get_item(node->edges[a], e);
+
+						if (!v->node->external)
+							continue;
+
+						ok = ok && (-1 == ext);
+						ext = ext_node_index(graph, v->node);
+					}
+
+					ok = ok && (0 <= ext);
+					plan->map[k][a] = ext;
+				}
+
+			} else {
+
+				assert(1 == list_count(node->edges[a]));
+
+				vertex_t v = list_get_item(node->edges[a], 0);
+
+				// internal inputs are resolved below
+
+				plan->map[k][a] = v->node->external ? ext_node_index(graph, v->node) : 0;
+				ok = ok && (0 <= plan->map[k][a]);
+			}
+		}
+	}
+
+	// inputs produced by other operators of the cluster
+
+	for (int k = 0; k < N_ops; k++) {
+
+		node_t node = list_get_item(graph->nodes, k);
+
+		for (int a = 0; a < node->N_vertices; a++) {
+
+			if (node->io_flags[a])
+				continue;
+
+			vertex_t v = list_get_item(node->edges[a], 0);
+
+			if (v->node->external)
+				continue;
+
+			int p = v->node->count;
+			int b = buf_idx[p][v->idx];
+
+			ok = ok && (p < k);
+
+			if (0 <= b)
+				last[b] = MAX(last[b], k);
+
+			plan->map[k][a] = plan->map[p][v->idx];
+		}
+	}
+
+	for (int k = 0; k < N_ops; k++)
+		xfree(buf_idx[k]);
+
+	if (!ok) {
+
+		memory_plan_free(plan);
+		return NULL;
+	}
+
+	// first-fit assignment of offsets, buffers are ordered by
+	// the operator which produces them
+
+	plan->arena = 0;
+	plan->unplanned = 0;
+
+	for (int b = 0; b < N_bufs; b++) {
+
+		plan->unplanned += size[b];
+
+		size_t off = 0;
+		bool moved;
+
+		do {
+			moved = false;
+
+			for (int c = 0; c < b; c++) {
+
+				if (last[c] < first[b])
+					continue;
+
+				if ((off < plan->offset[c] + size[c]) && (plan->offset[c] < off + size[b])) {
+
+					off = plan->offset[c] + size[c];
+					moved = true;
+				}
+			}
+
+		} while (moved);
+
+		plan->offset[b] = off;
+		plan->arena = MAX(plan->arena, off + size[b]);
+	}
+
+	debug_printf(DP_DEBUG2, "Memory plan: %d operators, %d buffers, %zu bytes (unplanned: %zu bytes)\n",
+				N_ops, N_bufs, plan->arena, plan->unplanned);
+
+	return PTR_PASS(plan);
+}
+
+
+static bool graph_plan_enabled(void)
+{
+	const char* str = getenv("BART_GRAPH_PLAN");
+
+	return (NULL == str) || (0 != atoi(str));
+}
+
+
 static graph_t graph_construct_operator_F(graph_t graph)
 {
 	graph = graph_to_op_reshape_F(graph);
+
+	struct memory_plan_s* plan = NULL;
+
+	if (graph_plan_enabled()) {
+
+		graph = graph_topological_sort_F(graph);
+		plan = graph_memory_plan(graph);
+	}
+
 	graph = graph_to_op_combine_F(graph);
 	graph = graph_to_op_dup_F(graph);
 	graph = graph_to_op_link_F(graph);
 	graph = graph_to_op_permute_F(graph);
+
+	if (NULL != plan) {
+
+		// the operators of the plan are kept alive by ref
+
+		node_t node = list_get_item(graph->nodes, 0);
+		auto ref = get_operator_from_node(node);
+
+		auto op = operator_plan_create(ref, plan->N_ops, plan->ops, plan->names, (const int**)plan->map,
+						plan->N_bufs, plan->offset, plan->arena, plan->unplanned);
+
+		operator_free(ref);
+		set_operator_to_node(node, op);
+
+		memory_plan_free(plan);
+	}
+
 	return graph;
 }
 
@@ -601,8 +896,12 @@ const struct operator_s* graph_to_operator_F(graph_t graph)
 	graph = operator_graph_optimize_identify_F(graph);
 	graph = operator_graph_optimize_identity_F(graph);
 
+	// with a memory plan, the whole graph is applied as one
+	// cluster so that all intermediate results share an arena
+
 	int count;
-	do {
+	while (!graph_plan_enabled()) {
+
 		do {
 			count = list_count(graph->nodes);
 			graph = operator_graph_optimize_chains_F(graph);
@@ -610,7 +909,10 @@ const struct operator_s* graph_to_operator_F(graph_t graph)
 		} while (list_count(graph->nodes) < count);
 
 		graph = operator_graph_optimize_clusters_F(graph, false);
-	} while (list_count(graph->nodes) < count);
+
+		if (list_count(graph->nodes) >= count)
+			break;
+	}
 
 	graph = graph_construct_operator_F(graph);
 	node_t node = list_get_item(graph->nodes, 0);
@@ -0,0 +1,394 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ *
+ * Fused elementwise operations on vectors of floats.
+ *
+ * Iterative algorithms apply short sequences of elementwise updates
+ * (e.g. two axpy followed by a norm in CG) to large vectors. Executed
+ * one after another, each operation streams all its arguments through
+ * memory. Here, the operations are recorded and then applied block by
+ * block so that all arguments of a block stay in cache for the whole
+ * sequence. Results are identical to sequential execution, including
+ * the order of summation for dot products.
+ *
+ * Vectors may also be stored in reduced precision (bfloat16 or IEEE
+ * half precision). Such vectors are converted to single precision
+ * block by block when loaded and rounded to nearest even when stored,
+ * which halves the memory traffic for these vectors. Because of the
+ * limited range of half precision, they are stored with a scale factor,
+ * which should be a power of two close to the magnitude of the elements.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "misc/misc.h"
+
+#include "vecfuse.h"
+
+
+void vec_fuse_init(struct vec_fuse_s* f, long N)
+{
+	f->N = N;
+	f->K = 0;
+	f->S = 0;
+}
+
+/**
+ * Declare the storage format of vector x for all operations of
+ * the sequence. The vector is stored as x / scale.
+ */
+void vec_fuse_storage(struct vec_fuse_s* f, const float* x, enum vec_storage st, float scale)
+{
+	if (VEC_FP32 == st)
+		return;
+
+	assert(f->S < VEC_FUSE_MAX);
+
+	f->sptr[f->S] = x;
+	f->storage[f->S] = st;
+	f->scale[f->S] = scale;
+	f->S++;
+}
+
+/**
+ * Power of two closest to the root mean square of a vector of
+ * N floats with norm 'nrm', used as scale factor for storage.
+ */
+float vec_storage_scale(enum vec_storage st, long N, double nrm)
+{
+	double rms = nrm / sqrt((double)N);
+
+	if ((VEC_FP32 == st) || !(0. < rms) || !isfinite(rms))
+		return 1.;
+
+	return ldexpf(1., (int)lround(log2(rms)));
+}
+
+/**
+ * Number of floats occupied by a vector of N floats stored in format st.
+ */
+long vec_storage_length(enum vec_storage st, long N)
+{
+	return (VEC_FP32 == st) ? N : ((N + 1) / 2);
+}
+
+static void vec_fuse_push(struct vec_fuse_s* f, enum vec_fop op, float alpha, float* a, const float* x, const float* y, double* result)
+{
+	assert(f->K < VEC_FUSE_MAX);
+
+	f->ops[f->K++] = (struct vec_fop_s){ op, alpha, a, x, y, result };
+}
+
+void vec_fuse_copy(struct vec_fuse_s* f, float* a, const float* x)
+{
+	vec_fuse_push(f, VEC_FOP_COPY, 0., a, x, NULL, NULL);
+}
+
+void vec_fuse_swap(struct vec_fuse_s* f, float* a, float* x)
+{
+	vec_fuse_push(f, VEC_FOP_SWAP, 0., a, x, NULL, NULL);
+}
+
+void vec_fuse_smul(struct vec_fuse_s* f, float alpha, float* a, const float* x)
+{
+	vec_fuse_push(f, VEC_FOP_SMUL, alpha, a, x, NULL, NULL);
+}
+
+void vec_fuse_axpy(struct vec_fuse_s* f, float* a, float alpha, const float* x)
+{
+	vec_fuse_push(f, VEC_FOP_AXPY, alpha, a, x, NULL, NULL);
+}
+
+void vec_fuse_xpay(struct vec_fuse_s* f, float alpha, float* a, const float* x)
+{
+	vec_fuse_push(f, VEC_FOP_XPAY, alpha, a, x, NULL, NULL);
+}
+
+void vec_fuse_add(struct vec_fuse_s* f, float* a, const float* x, const float* y)
+{
+	vec_fuse_push(f, VEC_FOP_ADD, 0., a, x, y, NULL);
+}
+
+void vec_fuse_sub(struct vec_fuse_s* f, float* a, const float* x, const float* y)
+{
+	vec_fuse_push(f, VEC_FOP_SUB, 0., a, x, y, NULL);
+}
+
+void vec_fuse_dot(struct vec_fuse_s* f, double* result, const float* x, const float* y)
+{
+	vec_fuse_push(f, VEC_FOP_DOT, 0., NULL, x, y, result);
+}
+
+
+// 8 KB per argument: a sequence with up to 24 streams stays in L2
+
+enum { VEC_FUSE_BLOCK = 2048 };
+
+static void vec_fop_block(const struct vec_fop_s* o, float* a, const float* x, const float* y, long n, double* acc)
+{
+	float alpha = o->alpha;
+
+	// same expressions as in vecops.c
+
+	switch (o->op) {
+
+	case VEC_FOP_COPY:
+
+		for (long i = 0; i < n; i++)
+			a[i] = x[i];
+
+		break;
+
+	case VEC_FOP_SWAP:
+
+		for (long i = 0; i < n; i++) {
+
+			float t = a[i];
+			a[i] = ((float*)x)[i];
+			((float*)x)[i] = t;
+		}
+
+		break;
+
+	case VEC_FOP_SMUL:
+
+		for (long i = 0; i < n; i++)
+			a[i] = 0.f * x[i] + alpha * x[i];
+
+		break;
+
+	case VEC_FOP_AXPY:
+
+		for (long i = 0; i < n; i++)
+			a[i] = 1.f * a[i] + alpha * x[i];
+
+		break;
+
+	case VEC_FOP_XPAY:
+
+		for (long i = 0; i < n; i++)
+			a[i] = alpha * a[i] + 1.f * x[i];
+
+		break;
+
+	case VEC_FOP_ADD:
+
+		for (long i = 0; i < n; i++)
+			a[i] = x[i] + y[i];
+
+		break;
+
+	case VEC_FOP_SUB:
+
+		for (long i = 0; i < n; i++)
+			a[i] = x[i] - y[i];
+
+		break;
+
+	case VEC_FOP_DOT:
+
+		for (long i = 0; i < n; i++)
+			*acc += x[i] * y[i];
+
+		break;
+	}
+}
+
+
+static float bf16_to_float(uint16_t h)
+{
+	uint32_t u = (uint32_t)h << 16;
+
+	float x;
+	memcpy(&x, &u, sizeof x);
+
+	return x;
+}
+
+static uint16_t float_to_bf16(float x)
+{
+	uint32_t u;
+	memcpy(&u, &x, sizeof u);
+
+	if ((u & 0x7FFFFFFF) > 0x7F800000)	// NaN
+		return (u >> 16) | 0x40;
+
+	u += 0x7FFF + ((u >> 16) & 1);
+
+	return u >> 16;
+}
+
+static float fp16_to_float(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t e = (h >> 10) & 0x1F;
+	uint32_t m = h & 0x3FF;
+
+	if (0 == e) {	// zero and subnormals
+
+		float x = (float)m * 0x1p-24f;
+
+		return sign ? -x : x;
+	}
+
+	uint32_t u = sign | ((31 == e) ? (0x7F800000 | (m << 13)) : (((e + 112) << 23) | (m << 13)));
+
+	float x;
+	memcpy(&x, &u, sizeof x);
+
+	return x;
+}
+
+static uint16_t float_to_fp16(float x)
+{
+	uint32_t u;
+	memcpy(&u, &x, sizeof u);
+
+	uint16_t sign = (u >> 16) & 0x8000;
+	uint32_t mag = u & 0x7FFFFFFF;
+
+	if (mag > 0x7F800000)	// NaN
+		return sign | 0x7E00;
+
+	if (mag >= 0x477FF000)	// rounds to infinity
+		return sign | 0x7C00;
+
+	if (mag >= 0x38800000) {	// normal
+
+		mag -= 112 << 23;
+		mag += 0xFFF + ((mag >> 13) & 1);
+
+		return sign | (mag >> 13);
+	}
+
+	if (mag < 0x33000000)	// rounds to zero
+		return sign;
+
+	// subnormal
+
+	uint32_t m = (mag & 0x7FFFFF) | 0x800000;
+	int shift = 126 - (int)(mag >> 23);
+
+	uint32_t r = m >> shift;
+	uint32_t rem = m & ((1u << shift) - 1);
+	uint32_t half = 1u << (shift - 1);
+
+	if ((rem > half) || ((rem == half) && (r & 1)))
+		r++;
+
+	return sign | r;
+}
+
+static void vec_storage_load(enum vec_storage st, float scale, long n, float* dst, const uint16_t* src)
+{
+	if (VEC_BF16 == st) {
+
+		for (long i = 0; i < n; i++)
+			dst[i] = scale * bf16_to_float(src[i]);
+
+	} else {
+
+		assert(VEC_FP16 == st);
+
+		for (long i = 0; i < n; i++)
+			dst[i] = scale * fp16_to_float(src[i]);
+	}
+}
+
+static void vec_storage_store(enum vec_storage st, float scale, long n, uint16_t* dst, const float* src)
+{
+	float iscale = 1. / scale;
+
+	if (VEC_BF16 == st) {
+
+		for (long i = 0; i < n; i++)
+			dst[i] = float_to_bf16(iscale * src[i]);
+
+	} else {
+
+		assert(VEC_FP16 == st);
+
+		for (long i = 0; i < n; i++)
+			dst[i] = float_to_fp16(iscale * src[i]);
+	}
+}
+
+static int vec_fuse_find(const struct vec_fuse_s* f, const float* x)
+{
+	for (int s = 0; s < f->S; s++)
+		if (f->sptr[s] == x)
+			return s;
+
+	return -1;
+}
+
+
+void vec_fuse_cpu(const struct vec_fuse_s* f)
+{
+	double acc[MAX(1, f->K)];
+
+	for (int k = 0; k < f->K; k++)
+		acc[k] = 0.;
+
+	// reduced-precision arguments: index into buf or -1
+
+	int ia[MAX(1, f->K)];
+	int ix[MAX(1, f->K)];
+	int iy[MAX(1, f->K)];
+
+	bool dirty[MAX(1, f->S)];
+
+	for (int s = 0; s < f->S; s++)
+		dirty[s] = false;
+
+	for (int k = 0; k < f->K; k++) {
+
+		const struct vec_fop_s* o = &f->ops[k];
+
+		ia[k] = (NULL != o->a) ? vec_fuse_find(f, o->a) : -1;
+		ix[k] = vec_fuse_find(f, o->x);
+		iy[k] = (NULL != o->y) ? vec_fuse_find(f, o->y) : -1;
+
+		if (0 <= ia[k])
+			dirty[ia[k]] = true;
+
+		if ((VEC_FOP_SWAP == o->op) && (0 <= ix[k]))
+			dirty[ix[k]] = true;
+	}
+
+	float (*buf)[VEC_FUSE_BLOCK] = (0 < f->S) ? xmalloc((size_t)f->S * sizeof *buf) : NULL;
+
+	for (long off = 0; off < f->N; off += VEC_FUSE_BLOCK) {
+
+		long n = MIN(VEC_FUSE_BLOCK, f->N - off);
+
+		for (int s = 0; s < f->S; s++)
+			vec_storage_load(f->storage[s], f->scale[s], n, buf[s], (const uint16_t*)f->sptr[s] + off);
+
+		for (int k = 0; k < f->K; k++) {
+
+			const struct vec_fop_s* o = &f->ops[k];
+
+			float* a = (0 <= ia[k]) ? buf[ia[k]] : ((NULL != o->a) ? (o->a + off) : NULL);
+			const float* x = (0 <= ix[k]) ? buf[ix[k]] : (o->x + off);
+			const float* y = (0 <= iy[k]) ? buf[iy[k]] : ((NULL != o->y) ? (o->y + off) : NULL);
+
+			vec_fop_block(o, a, x, y, n, &acc[k]);
+		}
+
+		for (int s = 0; s < f->S; s++)
+			if (dirty[s])
+				vec_storage_store(f->storage[s], f->scale[s], n, (uint16_t*)f->sptr[s] + off, buf[s]);
+	}
+
+	xfree(buf);
+
+	for (int k = 0; k < f->K; k++)
+		if (VEC_FOP_DOT == f->ops[k].op)
+			*f->ops[k].result = acc[k];
+}
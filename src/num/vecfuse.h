@@ -0,0 +1,76 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ */
+
+#ifndef __VECFUSE_H
+#define __VECFUSE_H
+
+enum vec_fop {
+
+	VEC_FOP_COPY,	// a = x
+	VEC_FOP_SWAP,	// a <-> x
+	VEC_FOP_SMUL,	// a = alpha * x
+	VEC_FOP_AXPY,	// a = a + alpha * x
+	VEC_FOP_XPAY,	// a = alpha * a + x
+	VEC_FOP_ADD,	// a = x + y
+	VEC_FOP_SUB,	// a = x - y
+	VEC_FOP_DOT,	// result = x^T y
+};
+
+/*
+ * Storage formats of vectors. Vectors in reduced precision hold
+ * N 16-bit values in the space of (N + 1) / 2 floats. They can only
+ * be accessed with fused operations on the CPU, where all arithmetic
+ * is done in single precision and dot products are accumulated in
+ * double precision.
+ */
+enum vec_storage { VEC_FP32, VEC_BF16, VEC_FP16 };
+
+struct vec_fop_s {
+
+	enum vec_fop op;
+	float alpha;
+	float* a;
+	const float* x;
+	const float* y;
+	double* result;
+};
+
+enum { VEC_FUSE_MAX = 8 };
+
+/*
+ * Sequence of elementwise operations on float vectors of the same
+ * length which are recorded and then executed in a single pass.
+ */
+struct vec_fuse_s {
+
+	long N;
+	int K;
+	struct vec_fop_s ops[VEC_FUSE_MAX];
+
+	int S;
+	const float* sptr[VEC_FUSE_MAX];
+	enum vec_storage storage[VEC_FUSE_MAX];
+	float scale[VEC_FUSE_MAX];
+};
+
+extern void vec_fuse_init(struct vec_fuse_s* f, long N);
+
+extern void vec_fuse_copy(struct vec_fuse_s* f, float* a, const float* x);
+extern void vec_fuse_swap(struct vec_fuse_s* f, float* a, float* x);
+extern void vec_fuse_smul(struct vec_fuse_s* f, float alpha, float* a, const float* x);
+extern void vec_fuse_axpy(struct vec_fuse_s* f, float* a, float alpha, const float* x);
+extern void vec_fuse_xpay(struct vec_fuse_s* f, float alpha, float* a, const float* x);
+extern void vec_fuse_add(struct vec_fuse_s* f, float* a, const float* x, const float* y);
+extern void vec_fuse_sub(struct vec_fuse_s* f, float* a, const float* x, const float* y);
+extern void vec_fuse_dot(struct vec_fuse_s* f, double* result, const float* x, const float* y);
+
+extern void vec_fuse_storage(struct vec_fuse_s* f, const float* x, enum vec_storage st, float scale);
+
+extern void vec_fuse_cpu(const struct vec_fuse_s* f);
+
+extern long vec_storage_length(enum vec_storage st, long N);
+extern float vec_storage_scale(enum vec_storage st, long N, double nrm);
+
+#endif
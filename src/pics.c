@@ -21,6 +21,7 @@
 #include "num/init.h"
 #include "num/ops_p.h"
 #include "num/ops.h"
+#include "num/vecfuse.h"
 
 #include "iter/misc.h"
 #include "iter/monitor.h"
@@ -32,6 +33,8 @@
 
 #include "noncart/nufft.h"
 
+#include "lowrank/batchsvd.h"
+
 #include "sense/recon.h"
 #include "sense/model.h"
 #include "sense/optcom.h"
@@ -50,6 +53,95 @@
 #include "num/ops.h"
 
 static const char help_str[] = "Parallel-imaging compressed-sensing reconstruction.\n";
+
+
+// pass over streamed k-space to estimate the sampling pattern and the scaling
+
+static void stream_prepare(struct cfl_stream_s* ksp, const long ksp_dims[DIMS], const long slab_dims[DIMS],
+			unsigned long loop_flags, complex float* pattern1, float* scaling)
+{
+	if ((NULL == pattern1) && (NULL == scaling))
+		return;
+
+	long pat_dims[DIMS];
+	md_select_dims(DIMS, ~COIL_FLAG, pat_dims, slab_dims);
+
+	complex float* data = md_alloc(DIMS, slab_dims, CFL_SIZE);
+	complex float* pattern = (NULL != pattern1) ? md_alloc(DIMS, pat_dims, CFL_SIZE) : NULL;
+
+	// center of k-space as used by estimate_scaling
+
+	long cen_dims[DIMS];
+	long cen_pos[DIMS];
+	long blk_dims[DIMS];
+
+	md_copy_dims(DIMS, cen_dims, ksp_dims);
+	md_set_dims(DIMS, cen_pos, 0);
+	md_copy_dims(DIMS, blk_dims, slab_dims);
+
+	for (int i = 0; i < 3; i++) {
+
+		cen_dims[i] = (READ_DIM == i) ? ksp_dims[i] : MIN(32, ksp_dims[i]);
+		cen_pos[i] = (ksp_dims[i] - cen_dims[i]) / 2;
+		blk_dims[i] = cen_dims[i];
+	}
+
+	complex float* cen = (NULL != scaling) ? md_alloc(DIMS, cen_dims, CFL_SIZE) : NULL;
+
+	double samples = 0.;
+	bool first = true;
+
+	long pos[DIMS];
+	md_set_dims(DIMS, pos, 0);
+
+	do {
+		stream_read_cfl(ksp, DIMS, slab_dims, pos, data);
+
+		if (NULL != pattern) {
+
+			estimate_pattern(DIMS, slab_dims, COIL_FLAG, pattern, data);
+
+			samples += pow(md_znorm(DIMS, pat_dims, pattern), 2.);
+
+			if (first)
+				md_slice(DIMS, loop_flags, pos, pat_dims, pattern1, pattern, CFL_SIZE);
+		}
+
+		if (NULL != cen) {
+
+			fftmod(DIMS, slab_dims, FFT_FLAGS, data, data);
+			md_move_block(DIMS, blk_dims, pos, cen_dims, cen, cen_pos, slab_dims, data, CFL_SIZE);
+		}
+
+		first = false;
+
+	} while (stream_next(DIMS, ksp_dims, slab_dims, pos));
+
+	if (NULL != pattern) {
+
+		long T = md_calc_size(DIMS, ksp_dims) / ksp_dims[COIL_DIM];
+
+		debug_printf(DP_INFO, "Size: %ld Samples: %ld Acc: %.2f\n", T, (long)samples, (float)T / (float)(long)samples);
+
+		md_free(pattern);
+	}
+
+	if (NULL != cen) {
+
+		long cal_dims[DIMS];
+		long cal_size[3] = { 32, 32, 32 };
+
+		complex float* cal = extract_calib(cal_dims, cal_size, cen_dims, cen, false);
+
+		*scaling = estimate_scaling_cal(ksp_dims, NULL, cal_dims, cal, false);
+
+		md_free(cal);
+		md_free(cen);
+	}
+
+	md_free(data);
+}
+
                  
 
 static const struct linop_s* sense_nc_init(const long max_dims[DIMS], const long map_dims[DIMS], const complex float* maps, const long ksp_dims[DIMS],
@@ -245,6 +337,7 @@ int main_pics(int argc, char* argv[argc])
 
 	// Read input options
 	struct nufft_conf_s nuconf = nufft_conf_defaults;
+	struct batch_svd_conf_s svd_conf = batch_svd_conf_defaults;
 	nuconf.toeplitz = true;
 	nuconf.lowmem = false;
 
@@ -274,6 +367,8 @@ int main_pics(int argc, char* argv[argc])
 	struct admm_conf admm = { false, false, false, iter_admm_defaults.rho, iter_admm_defaults.maxitercg };
 
 	enum algo_t algo = ALGO_DEFAULT;
+	enum vec_storage storage = VEC_FP32;
+	bool cg_pipelined = false;
 
 	bool hogwild = false;
 	bool fast = false;
@@ -285,6 +380,8 @@ int main_pics(int argc, char* argv[argc])
 	opt_reg_init(&ropts);
 
 	unsigned long loop_flags = 0UL;
+	struct op_loop_conf_s batch_conf = op_loop_conf_defaults;
+	float batch_mem = 0.;
 	unsigned long lowmem_flags = 0UL;
 
 	const struct opt_s opts[] = {
@@ -304,6 +401,8 @@ int main_pics(int argc, char* argv[argc])
 		OPT_INFILE('p', &pat_file, "file", "pattern or weights"),
 		OPTL_SET(0, "precond", &(conf.precond), "interprete weights as preconditioner"),
 		OPT_UINT('b', &llr_blk, "blk", "Lowrank block size"),
+		OPTL_LONG(0, "llr-rank", &svd_conf.rank, "r", "use randomized SVD with initial rank r for LLR"),
+		OPTL_SET(0, "llr-warmstart", &svd_conf.warmstart, "reuse singular subspaces of previous iteration for LLR (with --llr-rank and -n)"),
 		OPT_SET('e', &eigen, "Scale stepsize based on max. eigenvalue"),
 		OPT_SET('H', &hogwild, "(hogwild)"),
 		OPT_SET('D', &admm.dynamic_rho, "(ADMM dynamic step size)"),
@@ -322,9 +421,14 @@ int main_pics(int argc, char* argv[argc])
 		OPTL_SELECT(0, "fista", enum algo_t, &algo, ALGO_FISTA, "select FISTA"),
 		OPTL_SELECT('m', "admm", enum algo_t, &algo, ALGO_ADMM, "select ADMM"),
 		OPTL_SELECT('a', "pridu", enum algo_t, &algo, ALGO_PRIDU, "select Primal Dual"),
+		OPTL_SELECT(0, "bf16", enum vec_storage, &storage, VEC_BF16, "store CG residual and ADMM dual variables in bfloat16"),
+		OPTL_SELECT(0, "fp16", enum vec_storage, &storage, VEC_FP16, "store CG residual and ADMM dual variables in half precision"),
+		OPTL_SET(0, "cg-pipelined", &cg_pipelined, "pipelined conjugate gradients (one reduction per iteration)"),
 		OPT_FLOAT('w', &scaling, "", "inverse scaling of the data"),
 		OPT_SET('S', &scale_im, "re-scale the image after reconstruction"),
 		OPT_ULONG('L', &loop_flags, "flags", "batch-mode"),
+		OPTL_INT(0, "batch-workers", &batch_conf.workers, "n", "reconstruct n batch positions concurrently"),
+		OPTL_FLOAT(0, "batch-mem", &batch_mem, "GB", "limit memory used by concurrent batch positions (measures the peak memory of the first one)"),
 		OPT_SET('K', &nuconf.pcycle, "randshift for NUFFT"),
 		OPT_INFILE('B', &basis_file, "file", "temporal (or other) basis"),
 		OPT_FLOAT('P', &bpsense_eps, "eps", "Basis Pursuit formulation, || y- Ax ||_2 <= eps"),
@@ -332,6 +436,8 @@ int main_pics(int argc, char* argv[argc])
 		OPTL_SET('U', "lowmem", &nuconf.lowmem, "Use low-mem mode of the nuFFT"),
 		OPTL_ULONG(0, "lowmem-stack", &lowmem_flags, "flags", "(Stack SENSE model along selected dims (currently only supports COIL_DIM and noncart)))"),
 		OPTL_CLEAR(0, "no-toeplitz", &nuconf.toeplitz, "Turn off Toeplitz mode of nuFFT"),
+		OPTL_SET(0, "nufft-binning", &nuconf.binning, "Presort trajectory into tiles for gridding"),
+		OPTL_SET(0, "nufft-interp-matrix", &nuconf.precomp_interp, "Precompute sparse interpolation matrix for gridding"),
 		OPTL_OUTFILE(0, "psf_export", &psf_ofile, "file", "Export PSF to file"),
 		OPTL_INFILE(0, "psf_import", &psf_ifile, "file", "Import PSF from file"),
 		OPTL_STRING(0, "wavelet", &wtype_str, "name", "wavelet type (haar,dau2,cdf44)"),
@@ -362,6 +468,11 @@ int main_pics(int argc, char* argv[argc])
 		nuconf.precomp_linphase = false;
 	}
 
+	// operators are only reused for stacking or across server requests
+
+	if ((0 != lowmem_flags) || nufft_cache_kept_p())
+		nuconf.cache = true;
+
 
 	long max_dims[DIMS];
 	long map_dims[DIMS];
@@ -372,9 +483,20 @@ int main_pics(int argc, char* argv[argc])
 	long traj_dims[DIMS];
 
 
+	// in batch mode, Cartesian k-space is streamed slab by slab
+
+	bool stream = stream_enabled() && (0u != loop_flags) && !(loop_flags & FFT_FLAGS) && (NULL == traj_file) && (NULL == basis_file)
+			&& !conf.bpsense && !conf.precond && !im_truth && !warm_start && !sms;
+
 	// load kspace and maps and get dimensions
 
-	complex float* kspace = load_cfl(ksp_file, DIMS, ksp_dims);
+	complex float* kspace = NULL;
+	struct cfl_stream_s* ksp_stream = NULL;
+
+	if (stream)
+		ksp_stream = stream_load_cfl(ksp_file, DIMS, ksp_dims);
+	else
+		kspace = load_cfl(ksp_file, DIMS, ksp_dims);
 
         if (sms) {
 
@@ -487,6 +609,14 @@ int main_pics(int argc, char* argv[argc])
 	if (randshift)
 		shift_mode = 1;
 
+	if (svd_conf.warmstart && (0 >= svd_conf.rank))
+		error("--llr-warmstart requires --llr-rank\n");
+
+	if (svd_conf.warmstart && randshift)
+		error("--llr-warmstart requires -n\n");
+
+	ropts.svd_conf = &svd_conf;
+
 	if (overlapping_blocks) {
 
 		if (randshift)
@@ -515,8 +645,12 @@ int main_pics(int argc, char* argv[argc])
 	} else {
 
 		md_select_dims(DIMS, ~COIL_FLAG, pat_dims, ksp_dims);
-		pattern = md_alloc(DIMS, pat_dims, CFL_SIZE);
-		estimate_pattern(DIMS, ksp_dims, COIL_FLAG, pattern, kspace);
+
+		if (!stream) {
+
+			pattern = md_alloc(DIMS, pat_dims, CFL_SIZE);
+			estimate_pattern(DIMS, ksp_dims, COIL_FLAG, pattern, kspace);
+		}
 	}
 
 
@@ -538,7 +672,7 @@ int main_pics(int argc, char* argv[argc])
 			md_zmul2(DIMS, ksp_dims, ksp_strs, kspace, ksp_strs, kspace, pat_strs, pattern);
 		}
 
-	} else {
+	} else if (NULL != pattern) {
 
 		// print some statistics
 
@@ -550,10 +684,28 @@ int main_pics(int argc, char* argv[argc])
 
 	if (NULL == traj_file) {
 
-		fftmod(DIMS, ksp_dims, FFT_FLAGS, kspace, kspace);
+		if (!stream)
+			fftmod(DIMS, ksp_dims, FFT_FLAGS, kspace, kspace);
+
 		fftmod(DIMS, map_dims, FFT_FLAGS, maps, maps);
 	}
 
+	long slab_dims[DIMS];
+	complex float* pattern1 = NULL;
+
+	long pat1_dims[DIMS];
+	md_select_dims(DIMS, ~loop_flags, pat1_dims, pat_dims);
+
+	if (stream) {
+
+		stream_slab_dims(DIMS, slab_dims, ksp_dims, ~loop_flags);
+
+		if (NULL == pattern)
+			pattern1 = md_alloc(DIMS, pat1_dims, CFL_SIZE);
+
+		stream_prepare(ksp_stream, ksp_dims, slab_dims, loop_flags, pattern1, (0. == scaling) ? &scaling : NULL);
+	}
+
 	// apply fov mask to sensitivities
 
 	if (-1. != restrict_fov) {
@@ -567,6 +719,23 @@ int main_pics(int argc, char* argv[argc])
 	}
 
 
+	// split threads between concurrent batch positions
+	// (FFT plans are created with the per-position budget)
+
+	bool batch_sched = (0u != loop_flags) && !conf.gpu && ((0 < batch_conf.workers) || (0. < batch_mem));
+	int fft_threads = fft_get_num_threads();
+
+	if (batch_sched) {
+
+		batch_conf.mem_limit = batch_mem * 1.E9;
+
+		long batch_dims[DIMS];
+		md_select_dims(DIMS, loop_flags, batch_dims, stream ? slab_dims : max_dims);
+
+		fft_set_num_threads(operator_loop_sched_threads(&batch_conf, md_calc_size(DIMS, batch_dims), NULL));
+	}
+
+
 	// initialize forward_op
 
 	const struct linop_s* forward_op = NULL;
@@ -590,6 +759,11 @@ int main_pics(int argc, char* argv[argc])
 		if ((NULL != psf_ifile) && (NULL == psf_ofile))
 			nuconf.nopsf = true;
 
+		// the PSF of cached operators can not be replaced
+
+		if (NULL != psf_ifile)
+			nuconf.cache = false;
+
 		const complex float* traj_tmp = traj;
 
 		//for computation of psf on GPU
@@ -649,7 +823,7 @@ int main_pics(int argc, char* argv[argc])
 
 	// apply scaling
 
-	if (0. == scaling) {
+	if ((0. == scaling) && !stream) {
 
 		if (NULL == traj_file) {
 
@@ -674,7 +848,9 @@ int main_pics(int argc, char* argv[argc])
 	} else {
 
 		debug_printf(DP_DEBUG1, "Inverse scaling of the data: %f\n", scaling);
-		md_zsmul(DIMS, ksp_dims, kspace, kspace, 1. / scaling);
+
+		if (!stream)
+			md_zsmul(DIMS, ksp_dims, kspace, kspace, 1. / scaling);
 
 		if (conf.bpsense) {
 
@@ -684,8 +860,18 @@ int main_pics(int argc, char* argv[argc])
 	}
 
 
-	complex float* image = create_cfl(out_file, DIMS, img_dims);
-	md_clear(DIMS, img_dims, image, CFL_SIZE);
+	complex float* image = NULL;
+	struct cfl_stream_s* img_stream = NULL;
+
+	if (stream) {
+
+		img_stream = stream_create_cfl(out_file, DIMS, img_dims);
+
+	} else {
+
+		image = create_cfl(out_file, DIMS, img_dims);
+		md_clear(DIMS, img_dims, image, CFL_SIZE);
+	}
 
 
 	long img_truth_dims[DIMS];
@@ -746,11 +932,6 @@ int main_pics(int argc, char* argv[argc])
 	long max1_dims[DIMS];
 	md_select_dims(DIMS, ~loop_flags, max1_dims, max_dims);
 
-	long pat1_dims[DIMS];
-	md_select_dims(DIMS, ~loop_flags, pat1_dims, pat_dims);
-
-	complex float* pattern1 = NULL;
-
 	if (NULL != pattern) {
 
 		pattern1 = md_alloc(DIMS, pat1_dims, CFL_SIZE);
@@ -835,7 +1016,7 @@ int main_pics(int argc, char* argv[argc])
 
 	// initialize algorithm
 
-	struct iter it = italgo_config(algo, nr_penalties, ropts.regs, maxiter, step, hogwild, fast, admm, scaling, warm_start);
+	struct iter it = italgo_config(algo, nr_penalties, ropts.regs, maxiter, step, hogwild, fast, admm, scaling, warm_start, storage, cg_pipelined);
 
 	if (eigen && (ALGO_PRIDU == algo))
 		CAST_DOWN(iter_chambolle_pock_conf, it.iconf)->maxeigen_iter = 30;
@@ -916,29 +1097,113 @@ int main_pics(int argc, char* argv[argc])
 		}
 	}
 
-	if (0 != loop_flags) {
+	double batch_start = timestamp();
+
+	if (stream) {
+
+		// loop over the slabs of k-space and reconstruct each slab in parallel
+
+		long islab_dims[DIMS];
+
+		for (int i = 0; i < DIMS; i++) {
+
+			assert(!MD_IS_SET(loop_flags, i) || (img_dims[i] == ksp_dims[i]));
+			islab_dims[i] = MD_IS_SET(loop_flags, i) ? slab_dims[i] : img_dims[i];
+		}
+
+		md_calc_strides(DIMS, strsx[0], islab_dims, CFL_SIZE);
+		md_calc_strides(DIMS, strsx[1], slab_dims, CFL_SIZE);
+
+		for (int i = 0; i < DIMS; i++) {
+
+			if (MD_IS_SET(loop_flags, i)) {
+
+				strsx[0][i] = 0;
+				strsx[1][i] = 0;
+			}
+		}
+
+		long slab_loop_dims[DIMS];
+		md_select_dims(DIMS, loop_flags, slab_loop_dims, slab_dims);
 
 		auto op_tmp = operator_copy_wrapper(2, strs, op);
 		operator_free(op);
 		op = op_tmp;
 
-		// op = operator_loop(DIMS, loop_dims, op);
-		op_tmp = operator_loop_parallel(DIMS, loop_dims, op, loop_flags, conf.gpu);
+		if (batch_sched)
+			op_tmp = operator_loop_sched(DIMS, slab_loop_dims, op, loop_flags, &batch_conf);
+		else
+			op_tmp = operator_loop_parallel(DIMS, slab_loop_dims, op, loop_flags, conf.gpu);
+
 		operator_free(op);
 		op = op_tmp;
+
+		complex float* kslab = md_alloc(DIMS, slab_dims, CFL_SIZE);
+		complex float* islab = md_alloc(DIMS, islab_dims, CFL_SIZE);
+
+		long pos[DIMS];
+		md_set_dims(DIMS, pos, 0);
+
+		do {
+			stream_read_cfl(ksp_stream, DIMS, slab_dims, pos, kslab);
+
+			fftmod(DIMS, slab_dims, FFT_FLAGS, kslab, kslab);
+			md_zsmul(DIMS, slab_dims, kslab, kslab, 1. / scaling);
+
+			md_clear(DIMS, islab_dims, islab, CFL_SIZE);
+			operator_apply(op, DIMS, islab_dims, islab, DIMS, slab_dims, kslab);
+
+			if (scale_im)
+				md_zsmul(DIMS, islab_dims, islab, islab, scaling);
+
+			stream_write_cfl(img_stream, DIMS, islab_dims, pos, islab);
+
+		} while (stream_next(DIMS, ksp_dims, slab_dims, pos));
+
+		md_free(kslab);
+		md_free(islab);
+
+	} else {
+
+		if (0 != loop_flags) {
+
+			auto op_tmp = operator_copy_wrapper(2, strs, op);
+			operator_free(op);
+			op = op_tmp;
+
+			// op = operator_loop(DIMS, loop_dims, op);
+			if (batch_sched)
+				op_tmp = operator_loop_sched(DIMS, loop_dims, op, loop_flags, &batch_conf);
+			else
+				op_tmp = operator_loop_parallel(DIMS, loop_dims, op, loop_flags, conf.gpu);
+
+			operator_free(op);
+			op = op_tmp;
+		}
+
+		operator_apply(op, DIMS, img_dims, image, DIMS, (conf.bpsense || conf.precond) ? img_dims : ksp_dims, (conf.bpsense || conf.precond) ? NULL : kspace);
+
+		if (scale_im)
+			md_zsmul(DIMS, img_dims, image, image, scaling);
 	}
 
-	operator_apply(op, DIMS, img_dims, image, DIMS, (conf.bpsense || conf.precond) ? img_dims : ksp_dims, (conf.bpsense || conf.precond) ? NULL : kspace);
+	if (0u != loop_flags) {
+
+		double batch_time = timestamp() - batch_start;
+		long batch_size = md_calc_size(DIMS, loop_dims);
+
+		debug_printf(DP_INFO, "Batch: %ld positions in %.3fs (%.2f/s)\n", batch_size, batch_time, batch_size / batch_time);
+	}
 
 	operator_free(op);
 
+	if (batch_sched)
+		fft_set_num_threads(fft_threads);
+
 	opt_reg_free(&ropts, thresh_ops, trafos);
 
 	italgo_config_free(it);
 
-	if (scale_im)
-		md_zsmul(DIMS, img_dims, image, image, scaling);
-
 	// clean up
 
 	if (NULL != pat_file)
@@ -951,8 +1216,17 @@ int main_pics(int argc, char* argv[argc])
 
 
 	unmap_cfl(DIMS, map_dims, maps);
-	unmap_cfl(DIMS, ksp_dims, kspace);
-	unmap_cfl(DIMS, img_dims, image);
+
+	if (stream) {
+
+		stream_close_cfl(ksp_stream);
+		stream_close_cfl(img_stream);
+
+	} else {
+
+		unmap_cfl(DIMS, ksp_dims, kspace);
+		unmap_cfl(DIMS, img_dims, image);
+	}
 
 	if (NULL != traj)
 		unmap_cfl(DIMS, traj_dims, traj);
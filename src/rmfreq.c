@@ -259,7 +259,7 @@ int main_rmfreq(int argc, char* argv[argc])
 	unmap_cfl(DIMS, k_dims, k);
 	unmap_cfl(DIMS, k_dims, k_cor);
 
-	xfree(n_mod);
+	md_free(n_mod);
 
 	return 0;
 }
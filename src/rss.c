@@ -49,17 +49,39 @@ int main_rss(int argc, char* argv[argc])
 	num_init();
 
 	long dims[DIMS];
-	complex float* data = load_cfl(in_file, DIMS, dims);
+	struct cfl_stream_s* in = stream_load_cfl(in_file, DIMS, dims);
 
 	long odims[DIMS];
 	md_select_dims(DIMS, ~flags, odims, dims);
 
-	complex float* out = create_cfl(out_file, DIMS, odims);
+	struct cfl_stream_s* out = stream_create_cfl(out_file, DIMS, odims);
 
-	md_zrss(DIMS, dims, flags, out, data);
+	long slab_dims[DIMS];
+	stream_slab_dims(DIMS, slab_dims, dims, flags);
 
-	unmap_cfl(DIMS, dims, data);
-	unmap_cfl(DIMS, odims, out);
+	long oslab_dims[DIMS];
+	md_select_dims(DIMS, ~flags, oslab_dims, slab_dims);
+
+	complex float* data = md_alloc(DIMS, slab_dims, CFL_SIZE);
+	complex float* odata = md_alloc(DIMS, oslab_dims, CFL_SIZE);
+
+	long pos[DIMS];
+	md_set_dims(DIMS, pos, 0);
+
+	do {
+		stream_read_cfl(in, DIMS, slab_dims, pos, data);
+
+		md_zrss(DIMS, slab_dims, flags, odata, data);
+
+		stream_write_cfl(out, DIMS, oslab_dims, pos, odata);
+
+	} while (stream_next(DIMS, dims, slab_dims, pos));
+
+	md_free(data);
+	md_free(odata);
+
+	stream_close_cfl(in);
+	stream_close_cfl(out);
 
 	return 0;
 }
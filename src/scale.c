@@ -48,13 +48,30 @@ int main_scale(int argc, char* argv[argc])
 
 	const int N = DIMS;
 	long dims[N];
-	complex float* idata = load_cfl(in_file, N, dims);
-	complex float* odata = create_cfl(out_file, N, dims);
-		
-	md_zsmul(N, dims, odata, idata, scale);
+	struct cfl_stream_s* in = stream_load_cfl(in_file, N, dims);
+	struct cfl_stream_s* out = stream_create_cfl(out_file, N, dims);
 
-	unmap_cfl(N, dims, idata);
-	unmap_cfl(N, dims, odata);
+	long slab_dims[N];
+	stream_slab_dims(N, slab_dims, dims, 0UL);
+
+	complex float* data = md_alloc(N, slab_dims, CFL_SIZE);
+
+	long pos[N];
+	md_set_dims(N, pos, 0);
+
+	do {
+		stream_read_cfl(in, N, slab_dims, pos, data);
+
+		md_zsmul(N, slab_dims, data, data, scale);
+
+		stream_write_cfl(out, N, slab_dims, pos, data);
+
+	} while (stream_next(N, dims, slab_dims, pos));
+
+	md_free(data);
+
+	stream_close_cfl(in);
+	stream_close_cfl(out);
 
 	return 0;
 }
@@ -86,57 +86,91 @@ static int coord(int j, int x, int flen, int l)
 }
 
 
-static void wavelet_down3(const long dims[3], const long out_str[3], complex float* out, const long in_str[3], const complex float* in, int flen, const float filter[flen])
+/*
+ * Both bands are computed in one pass over the input. The reflected
+ * boundary coordinates only depend on j, so the innermost loop runs
+ * over contiguous elements without any index computations.
+ */
+static void wavelet_down3(const long dims[3], const long out_str[3], complex float* low, complex float* hgh, const long in_str[3], const complex float* in, int flen, const float filter_low[flen], const float filter_hgh[flen])
 {
-#pragma omp parallel for collapse(3)
+	assert(CFL_SIZE == out_str[0]);
+	assert(CFL_SIZE == in_str[0]);
+
+#pragma omp parallel for collapse(2)
 	for (int i = 0; i < dims[2]; i++) {
 
 		for (int j = 0; j < bandsize(dims[1], flen); j++) {
 
+			complex float* lo = access(out_str, low, i, j, 0);
+			complex float* hi = access(out_str, hgh, i, j, 0);
+
 			for (int k = 0; k < dims[0]; k++) {
 
-				*access(out_str, out, i, j, k) = 0.;
+				lo[k] = 0.;
+				hi[k] = 0.;
+			}
 
-				for (int l = 0; l < flen; l++) {
+			for (int l = 0; l < flen; l++) {
 
-					int n = coord(j, dims[1], flen, l);
-	
-					*access(out_str, out, i, j, k) +=
-						*(caccess(in_str, in, i, n, k)) * filter[flen - l - 1];
+				int n = coord(j, dims[1], flen, l);
+
+				const complex float* x = caccess(in_str, in, i, n, 0);
+
+				float fl = filter_low[flen - l - 1];
+				float fh = filter_hgh[flen - l - 1];
+
+				if ((0. == fl) && (0. == fh))
+					continue;
+
+				for (int k = 0; k < dims[0]; k++) {
+
+					lo[k] += x[k] * fl;
+					hi[k] += x[k] * fh;
 				}
 			}
 		}
 	}
 }
 
-static void wavelet_up3(const long dims[3], const long out_str[3], complex float* out, const long in_str[3],  const complex float* in, int flen, const float filter[flen])
+/*
+ * Synthesis from both bands in one pass. Each output row is written
+ * exactly once, so the output does not need to be cleared.
+ */
+static void wavelet_up3(const long dims[3], const long out_str[3], complex float* out, const long in_str[3], const complex float* low, const complex float* hgh, int flen, const float filter_low[flen], const float filter_hgh[flen])
 {
-//	md_clear2(3, dims, out_str, out, CFL_SIZE);
+	assert(CFL_SIZE == out_str[0]);
+	assert(CFL_SIZE == in_str[0]);
 
-#pragma omp parallel for collapse(3)
+#pragma omp parallel for collapse(2)
 	for (int i = 0; i < dims[2]; i++) {
 
 		for (int n = 0; n < dims[1]; n++) {
 
-			for (int k = 0; k < dims[0]; k++) {
+			complex float* y = access(out_str, out, i, n, 0);
 
-		//		*access(out_str, out, i, j, k) = 0.;
+			for (int k = 0; k < dims[0]; k++)
+				y[k] = 0.;
 
-				int odd = (n + 1) % 2;
+			int odd = (n + 1) % 2;
 
-				for (int l = odd; l < flen; l += 2) {
+			for (int l = odd; l < flen; l += 2) {
 
-					int j = (n + l - 1) / 2;
+				int j = (n + l - 1) / 2;
 #if 0
-					assert(1 == (n + l) % 2);
-					assert(n == coord(j, dims[1], flen, flen - l - 1));
+				assert(1 == (n + l) % 2);
+				assert(n == coord(j, dims[1], flen, flen - l - 1));
 #endif
-					if ((j < 0) || ((int)bandsize(dims[1], flen) <= j))
-						continue;
+				if ((j < 0) || ((int)bandsize(dims[1], flen) <= j))
+					continue;
 
-					*access(out_str, out, i, n, k) +=
-						*caccess(in_str, in, i, j, k) * filter[flen - l - 1];
-				}
+				const complex float* xl = caccess(in_str, low, i, j, 0);
+				const complex float* xh = caccess(in_str, hgh, i, j, 0);
+
+				float fl = filter_low[flen - l - 1];
+				float fh = filter_hgh[flen - l - 1];
+
+				for (int k = 0; k < dims[0]; k++)
+					y[k] += xl[k] * fl + xh[k] * fh;
 			}
 		}
 	}
@@ -194,8 +228,7 @@ void fwt1(unsigned int N, unsigned int d, const long dims[N], const long ostr[N]
 #endif
 
 	// no clear needed
-	wavelet_down3(wdims, wostr, low, wistr, in, flen, filter[0][0]);
-	wavelet_down3(wdims, wostr, hgh, wistr, in, flen, filter[0][1]);
+	wavelet_down3(wdims, wostr, low, hgh, wistr, in, flen, filter[0][0], filter[0][1]);
 }
 
 
@@ -228,11 +261,11 @@ void iwt1(unsigned int N, unsigned int d, const long dims[N], const long ostr[N]
 	long wistr[3] = { CFL_SIZE, istr[d], CFL_SIZE * md_calc_size(o, idims) };
 	long wostr[3] = { CFL_SIZE, ostr[d], CFL_SIZE * md_calc_size(o, dims) };
 
-	md_clear(3, wdims, out, CFL_SIZE);	// we cannot clear because we merge outputs
-
 #ifdef  USE_CUDA
 	if (cuda_ondevice(out)) {
 
+		md_clear(3, wdims, out, CFL_SIZE);	// we cannot clear because we merge outputs
+
 		assert(cuda_ondevice(low));
 		assert(cuda_ondevice(hgh));
 
@@ -248,8 +281,7 @@ void iwt1(unsigned int N, unsigned int d, const long dims[N], const long ostr[N]
 	}
 #endif
 
-	wavelet_up3(wdims, wostr, out, wistr, low, flen, filter[1][0]);
-	wavelet_up3(wdims, wostr, out, wistr, hgh, flen, filter[1][1]);
+	wavelet_up3(wdims, wostr, out, wistr, low, hgh, flen, filter[1][0], filter[1][1]);
 }
 
 
@@ -276,7 +308,12 @@ void wavelet_dims(unsigned int N, unsigned int flags, long odims[2 * N], const l
 }
 
 
-void fwtN(unsigned int N, unsigned int flags, const long shifts[N], const long dims[N], const long ostr[2 * N], complex float* out, const long istr[N], const complex float* in, const long flen, const float filter[2][2][flen])
+/*
+ * If lambda is not NULL, the coefficients are soft-thresholded when
+ * they are written to the output. The low band is only thresholded
+ * for the last level (all), otherwise it is transformed further.
+ */
+static void fwtN_thresh(unsigned int N, unsigned int flags, const long shifts[N], const long dims[N], const long ostr[2 * N], complex float* out, const long istr[N], const complex float* in, const long flen, const float filter[2][2][flen], const float* lambda, unsigned int jflags, bool all)
 {
 	long odims[2 * N];
 	wavelet_dims(N, flags, odims, dims, flen);
@@ -325,12 +362,33 @@ void fwtN(unsigned int N, unsigned int flags, const long shifts[N], const long d
 		}
 	}
 
-	md_copy2(2 * N, todims, ostr, out, tostrs, tmpA, CFL_SIZE);
+	if (NULL == lambda) {
+
+		md_copy2(2 * N, todims, ostr, out, tostrs, tmpA, CFL_SIZE);
+
+	} else {
+
+		md_zsoftthresh2(2 * N, todims, *lambda, jflags, ostr, out, tostrs, tmpA);
+
+		if (!all) {
+
+			long ldims[2 * N];
+			md_copy_dims(N, ldims, todims);
+			md_singleton_dims(N, ldims + N);
+
+			md_copy2(2 * N, ldims, ostr, out, tostrs, tmpA, CFL_SIZE);
+		}
+	}
 
 	md_free(tmpA);
 	md_free(tmpB);
 }
 
+void fwtN(unsigned int N, unsigned int flags, const long shifts[N], const long dims[N], const long ostr[2 * N], complex float* out, const long istr[N], const complex float* in, const long flen, const float filter[2][2][flen])
+{
+	fwtN_thresh(N, flags, shifts, dims, ostr, out, istr, in, flen, filter, NULL, 0u, false);
+}
+
 
 void iwtN(unsigned int N, unsigned int flags, const long shifts[N], const long dims[N], const long ostr[N], complex float* out, const long istr[2 * N], const complex float* in, const long flen, const float filter[2][2][flen])
 {
@@ -437,7 +495,9 @@ long wavelet_coeffs(unsigned int N, unsigned int flags, const long dims[N], cons
 
 
 
-void wavelet_thresh(unsigned int N, float lambda, unsigned int flags, unsigned int jflags, const long shifts[N], const long dims[N], complex float* out, const complex float* in, const long minsize[N], long flen, const float filter[2][2][flen])
+static void fwt2_thresh(unsigned int N, unsigned int flags, const long shifts[N], const long odims[N], const long ostr[N], complex float* out, const long idims[N], const long istr[N], const complex float* in, const long minsize[N], long flen, const float filter[2][2][flen], const float* lambda, unsigned int jflags);
+
+void wavelet_thresh2(unsigned int N, float lambda, unsigned int flags, unsigned int jflags, const long shifts[N], const long dims[N], const long ostr[N], complex float* out, const long istr[N], const complex float* in, const long minsize[N], long flen, const float filter[2][2][flen])
 {
 	assert(0 == (flags & jflags));
 
@@ -449,18 +509,23 @@ void wavelet_thresh(unsigned int N, float lambda, unsigned int flags, unsigned i
 
 	complex float* tmp = md_alloc_sameplace(N, wdims, CFL_SIZE, out);
 
-	long str[N];
-	md_calc_strides(N, str, dims, CFL_SIZE);
-
-	fwt2(N, flags, shifts, wdims, wstr, tmp, dims, str, in, minsize, flen, filter);
+	// thresholding is done when the coefficients of each level are written
 
-	md_zsoftthresh(N, wdims, lambda, jflags, tmp, tmp);
+	fwt2_thresh(N, flags, shifts, wdims, wstr, tmp, dims, istr, in, minsize, flen, filter, &lambda, jflags);
 
-	iwt2(N, flags, shifts, dims, str, out, wdims, wstr, tmp, minsize, flen, filter);
+	iwt2(N, flags, shifts, dims, ostr, out, wdims, wstr, tmp, minsize, flen, filter);
 
 	md_free(tmp);
 }
 
+void wavelet_thresh(unsigned int N, float lambda, unsigned int flags, unsigned int jflags, const long shifts[N], const long dims[N], complex float* out, const complex float* in, const long minsize[N], long flen, const float filter[2][2][flen])
+{
+	long str[N];
+	md_calc_strides(N, str, dims, CFL_SIZE);
+
+	wavelet_thresh2(N, lambda, flags, jflags, shifts, dims, str, out, str, in, minsize, flen, filter);
+}
+
 
 void wavelet_coeffs2(unsigned int N, unsigned int flags, long odims[N], const long dims[N], const long min[N], const long flen)
 {
@@ -508,7 +573,7 @@ static void embed(unsigned int N, unsigned int flags, long ostr[N], const long d
 }
 
 
-void fwt2(unsigned int N, unsigned int flags, const long shifts[N], const long odims[N], const long ostr[N], complex float* out, const long idims[N], const long istr[N], const complex float* in, const long minsize[N], long flen, const float filter[2][2][flen])
+static void fwt2_thresh(unsigned int N, unsigned int flags, const long shifts[N], const long odims[N], const long ostr[N], complex float* out, const long idims[N], const long istr[N], const complex float* in, const long minsize[N], long flen, const float filter[2][2][flen], const float* lambda, unsigned int jflags)
 {
 	assert(wavelet_check_dims(N, flags, idims, minsize));
 
@@ -516,7 +581,10 @@ void fwt2(unsigned int N, unsigned int flags, const long shifts[N], const long o
 
 		assert(md_check_compat(N, 0u, odims, idims));
 
-		md_copy2(N, idims, ostr, out, istr, in, CFL_SIZE);
+		if (NULL == lambda)
+			md_copy2(N, idims, ostr, out, istr, in, CFL_SIZE);
+		else
+			md_zsoftthresh2(N, idims, *lambda, jflags, ostr, out, istr, in);
 
 		return;
 	}
@@ -576,7 +644,7 @@ void fwt2(unsigned int N, unsigned int flags, const long shifts[N], const long o
 
 	assert((0 == offset) || (0u != flags2));
 
-	fwtN(N, flags, shifts, idims, ostr2, out + offset, istr, in, flen, filter);
+	fwtN_thresh(N, flags, shifts, idims, ostr2, out + offset, istr, in, flen, filter, lambda, jflags, (0 == flags2));
 
 	if (0 != flags2) {
 
@@ -586,10 +654,15 @@ void fwt2(unsigned int N, unsigned int flags, const long shifts[N], const long o
 		long ostr3[N];
 		embed(N, flags, ostr3, odims3, ostr);
 
-		fwt2(N, flags2, shifts0, odims3, ostr3, out, wdims2, ostr2, out + offset, minsize, flen, filter);
+		fwt2_thresh(N, flags2, shifts0, odims3, ostr3, out, wdims2, ostr2, out + offset, minsize, flen, filter, lambda, jflags);
 	}
 }
 
+void fwt2(unsigned int N, unsigned int flags, const long shifts[N], const long odims[N], const long ostr[N], complex float* out, const long idims[N], const long istr[N], const complex float* in, const long minsize[N], long flen, const float filter[2][2][flen])
+{
+	fwt2_thresh(N, flags, shifts, odims, ostr, out, idims, istr, in, minsize, flen, filter, NULL, 0u);
+}
+
 
 void iwt2(unsigned int N, unsigned int flags, const long shifts[N], const long odims[N], const long ostr[N], complex float* out, const long idims[N], const long istr[N], const complex float* in, const long minsize[N], const long flen, const float filter[2][2][flen])
 {
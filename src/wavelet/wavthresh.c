@@ -29,6 +29,10 @@
 
 #include "wavthresh.h"
 
+#ifndef CFL_SIZE
+#define CFL_SIZE sizeof(complex float)
+#endif
+
 
 struct wavelet_thresh_s {
 
@@ -37,6 +41,7 @@ struct wavelet_thresh_s {
 	unsigned int N;
 	const long* dims;
 	const long* minsize;
+	const long* tdims;
 	unsigned int flags;
 	unsigned int jflags;
 	float lambda;
@@ -86,8 +91,25 @@ static void wavelet_thresh_apply(const operator_data_t* _data, float mu, complex
 		}
 	}
 
-	wavelet_thresh(data->N, data->lambda * mu, data->flags, data->jflags, shift, data->dims,
-		out, in, data->minsize, data->flen, data->filter);
+	// independent tiles along all dimensions which are not transformed
+
+	unsigned int N = data->N;
+
+	long strs[N];
+	md_calc_strides(N, strs, data->dims, CFL_SIZE);
+
+	unsigned long loop_flags = md_nontriv_dims(N, data->dims) & ~md_nontriv_dims(N, data->tdims);
+
+	long pos[N];
+	md_set_dims(N, pos, 0);
+
+	do {
+		long offset = md_calc_offset(N, strs, pos) / (long)CFL_SIZE;
+
+		wavelet_thresh2(N, data->lambda * mu, data->flags, data->jflags, shift, data->tdims,
+			strs, out + offset, strs, in + offset, data->minsize, data->flen, data->filter);
+
+	} while (md_next(N, data->dims, loop_flags, pos));
 }
 
 
@@ -104,6 +126,7 @@ static void wavelet_thresh_del(const operator_data_t* _data)
 	const auto data = CAST_DOWN(wavelet_thresh_s, _data);
 	xfree(data->dims);
 	xfree(data->minsize);
+	xfree(data->tdims);
 	xfree(data);
 }
 
@@ -136,6 +159,32 @@ const struct operator_p_s* prox_wavelet_thresh_create(unsigned int N, const long
 	md_copy_dims(N, (*nminsize), minsize);
 	data->minsize = *nminsize;
 
+	// The transform is applied to tiles of at most max_size elements
+	// (if possible), so that the temporary coefficients do not have
+	// to be allocated for the full array. Tiles extend over all
+	// dimensions of the transform and of the joint thresholding,
+	// i.e. only the remaining dimensions (e.g. maps or time) are
+	// split. Tiling has no effect if all non-singleton dimensions
+	// are transformed, e.g. for a single 2D or 3D image: the
+	// coarse levels span the full image, so spatial tiles would
+	// need halos as large as the image itself.
+
+	long max_size = 1L << 22;
+
+	const char* str = getenv("BART_WAVELET_TILE_SIZE");
+
+	if ((NULL != str) && (0 < atol(str)))
+		max_size = atol(str);
+
+	long (*tdims)[N] = TYPE_ALLOC(long[N]);
+	md_select_dims(N, flags | jflags, (*tdims), dims);
+
+	for (unsigned int i = 0; i < N; i++)
+		if (!MD_IS_SET(flags | jflags, i) && (md_calc_size(N, *tdims) * dims[i] <= max_size))
+			(*tdims)[i] = dims[i];
+
+	data->tdims = *tdims;
+
 	data->flags = flags;
 	data->jflags = jflags;
 	data->lambda = lambda;
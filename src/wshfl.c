@@ -1206,7 +1206,7 @@ int main_wshfl(int argc, char* argv[argc])
 		debug_printf(DP_INFO, "\tAlgorithm: ADMM\n.");
 		debug_printf(DP_INFO, "\tRho:       %.2e\n.", rho);
 
-		it = italgo_config(ALGO_ADMM, nr_penalties, regs, maxiter, step, hgwld, false, admm, 1, false);
+		it = italgo_config(ALGO_ADMM, nr_penalties, regs, maxiter, step, hgwld, false, admm, 1, false, VEC_FP32, false);
 	}
 
 	complex float* init = NULL;
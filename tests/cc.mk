@@ -45,5 +45,19 @@ tests/test-cc-svd-matrix: cc extract fmac transpose nrmse $(TESTS_OUT)/shepploga
 
 
 
+tests/test-cc-stream: cc nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	BART_STREAM=0 $(TOOLDIR)/cc -G -p 4 $(TESTS_OUT)/shepplogan_coil_ksp.ra ksp-cc1.ra	;\
+	BART_STREAM_SLAB_SIZE=16384 $(TOOLDIR)/cc -G -p 4 $(TESTS_OUT)/shepplogan_coil_ksp.ra ksp-cc2.ra	;\
+	$(TOOLDIR)/nrmse -t 0. ksp-cc1.ra ksp-cc2.ra					;\
+	BART_STREAM=0 $(TOOLDIR)/cc -A -S -p 4 $(TESTS_OUT)/shepplogan_coil_ksp.ra ksp-cc3.ra	;\
+	BART_STREAM_SLAB_SIZE=16384 $(TOOLDIR)/cc -A -S -p 4 $(TESTS_OUT)/shepplogan_coil_ksp.ra ksp-cc4.ra	;\
+	$(TOOLDIR)/nrmse -t 0. ksp-cc3.ra ksp-cc4.ra					;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+
 TESTS += tests/test-cc-svd tests/test-cc-geom tests/test-cc-esp tests/test-cc-svd-matrix
+TESTS += tests/test-cc-stream
 
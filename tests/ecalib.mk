@@ -40,6 +40,22 @@ tests/test-ecalib-rotation2: ecalib cc fmac transpose nrmse $(TESTS_OUT)/shepplo
 	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
 	touch $@
 
+tests/test-ecalib-coarse: ecalib pocsense nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra
+	set -e ; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/ecalib -m1 --coarse 2 $(TESTS_OUT)/shepplogan_coil_ksp.ra coils.ra	;\
+	$(TOOLDIR)/pocsense -i1 $(TESTS_OUT)/shepplogan_coil_ksp.ra coils.ra proj.ra	;\
+	$(TOOLDIR)/nrmse -t 0.05 proj.ra $(TESTS_OUT)/shepplogan_coil_ksp.ra		;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+tests/test-ecalib-orthiter-warm: ecalib pocsense nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra
+	set -e ; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/ecalib -m1 --orthiter-warm 3 $(TESTS_OUT)/shepplogan_coil_ksp.ra coils.ra	;\
+	$(TOOLDIR)/pocsense -i1 $(TESTS_OUT)/shepplogan_coil_ksp.ra coils.ra proj.ra	;\
+	$(TOOLDIR)/nrmse -t 0.05 proj.ra $(TESTS_OUT)/shepplogan_coil_ksp.ra		;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
 tests/test-ecalib-gpu: ecalib pocsense nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra
 	set -e ; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
 	$(TOOLDIR)/ecalib    -m1 $(TESTS_OUT)/shepplogan_coil_ksp.ra coils1.ra		;\
@@ -50,5 +66,5 @@ tests/test-ecalib-gpu: ecalib pocsense nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra
 
 
 TESTS += tests/test-ecalib tests/test-ecalib-auto tests/test-ecalib-rotation
-TESTS += tests/test-ecalib-rotation2
+TESTS += tests/test-ecalib-rotation2 tests/test-ecalib-coarse tests/test-ecalib-orthiter-warm
 TESTS_GPU += tests/test-ecalib-gpu
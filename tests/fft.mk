@@ -50,4 +50,15 @@ tests/test-fft-shift: resize fft fftshift nrmse $(TESTS_OUT)/shepplogan_fftu.ra
 
 
 
-TESTS += tests/test-fft-basic tests/test-fft-unitary tests/test-fft-uncentered tests/test-fft-shift
+# streamed FFT
+
+tests/test-fft-stream: fft nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	BART_STREAM=0 $(TOOLDIR)/fft -u -i 7 $(TESTS_OUT)/shepplogan_coil_ksp.ra c1.ra	;\
+	BART_STREAM_SLAB_SIZE=16384 $(TOOLDIR)/fft -u -i 7 $(TESTS_OUT)/shepplogan_coil_ksp.ra c2.ra	;\
+	$(TOOLDIR)/nrmse -t 0. c1.ra c2.ra						;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+TESTS += tests/test-fft-basic tests/test-fft-unitary tests/test-fft-uncentered tests/test-fft-shift tests/test-fft-stream
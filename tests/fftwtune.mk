@@ -0,0 +1,16 @@
+
+
+tests/test-fftwtune: fftwtune pics nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	BART_FFTW_WISDOM=wisdom $(TOOLDIR)/fftwtune $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra	;\
+	test -f wisdom									;\
+	$(TOOLDIR)/pics -S -i5 -r0.01 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra reco1.ra	;\
+	BART_FFTW_WISDOM=wisdom BART_USE_FFTW_WISDOM=1 $(TOOLDIR)/pics -S -i5 -r0.01 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra reco2.ra	;\
+	$(TOOLDIR)/nrmse -t 0.00001 reco1.ra reco2.ra					;\
+	rm *.ra wisdom wisdom.lock ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+
+TESTS += tests/test-fftwtune
+
@@ -20,5 +20,19 @@ tests/test-io2: ones std noise nrmse
 	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
 	touch $@
 
-TESTS += tests/test-io tests/test-io2
+# chained commands with data streamed through pipes
+tests/test-io-pipe: phantom fft scale rss nrmse
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)						;\
+	$(TOOLDIR)/phantom -s4 -k k.ra								;\
+	$(TOOLDIR)/fft -u -i 3 k.ra a.ra							;\
+	$(TOOLDIR)/scale 2. a.ra b.ra								;\
+	$(TOOLDIR)/rss 8 b.ra c.ra								;\
+	$(TOOLDIR)/phantom -s4 -k - | $(TOOLDIR)/fft -u -i 3 - - | $(TOOLDIR)/scale 2. - - | $(TOOLDIR)/rss 8 - d.ra	;\
+	$(TOOLDIR)/nrmse -t 0.000001 c.ra d.ra							;\
+	BART_STREAM_SLAB_SIZE=16384 $(TOOLDIR)/fft -u -i 3 k.ra - | $(TOOLDIR)/scale 2. - e.ra	;\
+	$(TOOLDIR)/nrmse -t 0. b.ra e.ra							;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+TESTS += tests/test-io tests/test-io2 tests/test-io-pipe
 
@@ -11,6 +11,17 @@ tests/test-nlinv: normalize nlinv pocsense nrmse $(TESTS_OUT)/shepplogan_coil_ks
 	touch $@
 
 
+tests/test-nlinv-graph-trace: nlinv nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra
+	set -e ; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/nlinv -i6 $(TESTS_OUT)/shepplogan_coil_ksp.ra r1.ra c1.ra		;\
+	BART_GRAPH_CONCURRENT=1 OMP_NUM_THREADS=4 $(TOOLDIR)/nlinv -i6 --graph-trace trace.json $(TESTS_OUT)/shepplogan_coil_ksp.ra r2.ra c2.ra	;\
+	$(TOOLDIR)/nrmse -t 0.00001 r1.ra r2.ra						;\
+	$(TOOLDIR)/nrmse -t 0.00001 c1.ra c2.ra						;\
+	grep -q "\"critical\": 1" trace.json						;\
+	rm *.ra trace.json ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
 tests/test-nlinv-sms: repmat fft nlinv nrmse scale $(TESTS_OUT)/shepplogan_coil_ksp.ra
 	set -e ; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
 	$(TOOLDIR)/repmat 13 4 $(TESTS_OUT)/shepplogan_coil_ksp.ra ksp.ra		;\
@@ -193,7 +204,7 @@ TESTS += tests/test-nlinv-batch tests/test-nlinv-batch2
 TESTS += tests/test-nlinv-noncart tests/test-nlinv-precomp
 TESTS += tests/test-nlinv-maps-dims tests/test-nlinv-noncart-maps-dims
 TESTS += tests/test-nlinv-pf-vcc
-TESTS += tests/test-nlinv-pics
+TESTS += tests/test-nlinv-pics tests/test-nlinv-graph-trace
 TESTS_GPU += tests/test-nlinv-gpu tests/test-nlinv-sms-gpu
 
 
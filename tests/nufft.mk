@@ -296,6 +296,31 @@ tests/test-nufft-lowmem-adjoint: zeros noise traj nufft nrmse
 	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
 	touch $@
 
+tests/test-nufft-binning-adjoint: zeros noise traj nufft nrmse
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/zeros 4 1 128 128 3 z.ra						;\
+	$(TOOLDIR)/noise -s321 z.ra n2.ra						;\
+	$(TOOLDIR)/traj -r -x128 -y128 traj.ra						;\
+	$(TOOLDIR)/nufft -a traj.ra n2.ra x1.ra						;\
+	$(TOOLDIR)/nufft --binning -a traj.ra n2.ra x2.ra				;\
+	$(TOOLDIR)/nrmse -t 0.000001 x1.ra x2.ra					;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+tests/test-nufft-interp-matrix: zeros noise traj nufft nrmse
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/zeros 4 1 128 128 3 z.ra						;\
+	$(TOOLDIR)/noise -s321 z.ra n2.ra						;\
+	$(TOOLDIR)/traj -r -x128 -y128 traj.ra						;\
+	$(TOOLDIR)/nufft -a traj.ra n2.ra x1.ra						;\
+	$(TOOLDIR)/nufft --interp-matrix -a traj.ra n2.ra x2.ra			;\
+	$(TOOLDIR)/nrmse -t 0.000001 x1.ra x2.ra					;\
+	$(TOOLDIR)/nufft traj.ra x1.ra k1.ra						;\
+	$(TOOLDIR)/nufft --interp-matrix traj.ra x1.ra k2.ra				;\
+	$(TOOLDIR)/nrmse -t 0.000001 k1.ra k2.ra					;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
 tests/test-nufft-no-precomp-adjoint: zeros noise traj nufft nrmse
 	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
 	$(TOOLDIR)/zeros 4 1 128 128 3 z.ra						;\
@@ -341,6 +366,7 @@ TESTS += tests/test-nufft-nudft tests/test-nudft-forward tests/test-nudft-adjoin
 TESTS += tests/test-nufft-batch tests/test-nufft-over
 TESTS += tests/test-nufft-lowmem-adjoint tests/test-nufft-lowmem-inverse tests/test-nufft-no-precomp-adjoint tests/test-nufft-no-precomp-inverse
 TESTS += tests/test-nufft-inverse2 tests/test-nufft-inverse3
+TESTS += tests/test-nufft-binning-adjoint tests/test-nufft-interp-matrix
 
 TESTS_GPU += tests/test-nufft-gpu-inverse tests/test-nufft-gpu-adjoint tests/test-nufft-gpu-forward
 TESTS_GPU += tests/test-nufft-gpu-inverse-lowmem tests/test-nufft-gpu-adjoint-lowmem tests/test-nufft-gpu-forward-lowmem
@@ -13,6 +13,33 @@ tests/test-pics-pi: pics scale nrmse $(TESTS_OUT)/shepplogan.ra $(TESTS_OUT)/she
 
 
 
+tests/test-pics-mixed-precision: pics nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/pics -S -r0.001 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra r1.ra		;\
+	$(TOOLDIR)/pics -S -r0.001 --bf16 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra r2.ra	;\
+	$(TOOLDIR)/nrmse -t 0.01 r1.ra r2.ra						;\
+	$(TOOLDIR)/pics -S -r0.001 --fp16 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra r3.ra	;\
+	$(TOOLDIR)/nrmse -t 0.002 r1.ra r3.ra						;\
+	$(TOOLDIR)/pics -S -RT:3:0:0.01 -i20 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra r4.ra	;\
+	$(TOOLDIR)/pics -S -RT:3:0:0.01 -i20 --bf16 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra r5.ra	;\
+	$(TOOLDIR)/nrmse -t 0.01 r4.ra r5.ra						;\
+	$(TOOLDIR)/pics -S -RT:3:0:0.01 -i20 --fp16 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra r6.ra	;\
+	$(TOOLDIR)/nrmse -t 0.002 r4.ra r6.ra						;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+
+tests/test-pics-cg-pipelined: pics nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/pics -S -r0.001 $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra r1.ra		;\
+	$(TOOLDIR)/pics -S -r0.001 --cg-pipelined $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra r2.ra	;\
+	$(TOOLDIR)/nrmse -t 0.00001 r1.ra r2.ra						;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+
 tests/test-pics-noncart: traj scale phantom ones pics nufft nrmse
 	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
 	$(TOOLDIR)/traj -r -x256 -y64 traj.ra						;\
@@ -146,6 +173,42 @@ tests/test-pics-joint-wavl1: poisson reshape fft fmac ones pics slice nrmse $(TE
 	touch $@
 
 
+tests/test-pics-wavl1-tiled: poisson reshape fft fmac ones pics nrmse $(TESTS_OUT)/shepplogan.ra
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/poisson -Y128 -Z128 -y1.1 -z1.1 -e -v -C24 -T2 p.ra			;\
+	$(TOOLDIR)/reshape 63 128 128 1 1 1 2 p.ra p2.ra				;\
+	$(TOOLDIR)/fft -u 7 $(TESTS_OUT)/shepplogan.ra ksp1.ra				;\
+	$(TOOLDIR)/fmac ksp1.ra p2.ra ksp.ra						;\
+	$(TOOLDIR)/ones 3 128 128 1 o.ra						;\
+	$(TOOLDIR)/pics -S -RW:3:0:0.02 -i50 ksp.ra o.ra reco1.ra			;\
+	BART_WAVELET_TILE_SIZE=16384 $(TOOLDIR)/pics -S -RW:3:0:0.02 -i50 ksp.ra o.ra reco2.ra	;\
+	$(TOOLDIR)/nrmse -t 0.000001 reco1.ra reco2.ra					;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+tests/test-pics-llr-rsvd: phantom index scale zexp fmac fft poisson reshape pics nrmse
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/phantom -x64 -S4 coils.ra						;\
+	$(TOOLDIR)/phantom -x64 img.ra							;\
+	$(TOOLDIR)/index 5 32 t.ra							;\
+	$(TOOLDIR)/scale -- -0.1 t.ra t2.ra						;\
+	$(TOOLDIR)/zexp t2.ra e.ra							;\
+	$(TOOLDIR)/fmac img.ra e.ra img2.ra						;\
+	$(TOOLDIR)/fmac img2.ra coils.ra cimg.ra					;\
+	$(TOOLDIR)/fft -u 7 cimg.ra ksp.ra						;\
+	$(TOOLDIR)/poisson -Y64 -Z64 -y2 -z2 -C10 -e p.ra				;\
+	$(TOOLDIR)/reshape 7 64 64 1 p.ra p2.ra						;\
+	$(TOOLDIR)/fmac ksp.ra p2.ra ksp2.ra						;\
+	$(TOOLDIR)/pics -S -e -n -RL:7:7:0.02 -i30 ksp2.ra coils.ra r1.ra		;\
+	$(TOOLDIR)/pics -S -e -n -RL:7:7:0.02 -i30 --llr-rank 2 ksp2.ra coils.ra r2.ra	;\
+	$(TOOLDIR)/pics -S -e -n -RL:7:7:0.02 -i30 --llr-rank 2 --llr-warmstart ksp2.ra coils.ra r3.ra	;\
+	$(TOOLDIR)/nrmse -t 0.0001 r1.ra r2.ra						;\
+	$(TOOLDIR)/nrmse -t 0.0001 r1.ra r3.ra						;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
 tests/test-pics-pics: traj scale phantom pics nrmse $(TESTS_OUT)/shepplogan.ra $(TESTS_OUT)/coils.ra
 	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
 	$(TOOLDIR)/traj -r -x256 -y32 traj.ra						;\
@@ -206,6 +269,28 @@ tests/test-pics-batch: pics repmat nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra $(T
 
 
 
+tests/test-pics-batch-stream: pics repmat nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/repmat 5 4 $(TESTS_OUT)/shepplogan_coil_ksp.ra kspaces.ra		;\
+	BART_STREAM=0 $(TOOLDIR)/pics -S -i5 -r0.01 -L32 kspaces.ra $(TESTS_OUT)/coils.ra reco1.ra	;\
+	BART_STREAM_SLAB_SIZE=262144 $(TOOLDIR)/pics -S -i5 -r0.01 -L32 kspaces.ra $(TESTS_OUT)/coils.ra reco2.ra	;\
+	$(TOOLDIR)/nrmse -t 0.00001 reco1.ra reco2.ra					;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+
+tests/test-pics-batch-workers: pics repmat nrmse $(TESTS_OUT)/shepplogan_coil_ksp.ra $(TESTS_OUT)/coils.ra
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
+	$(TOOLDIR)/repmat 5 3 $(TESTS_OUT)/shepplogan_coil_ksp.ra kspaces.ra		;\
+	$(TOOLDIR)/pics -S -i5 -r0.01 kspaces.ra $(TESTS_OUT)/coils.ra reco1.ra	;\
+	$(TOOLDIR)/pics -S -i5 -r0.01 -L32 --batch-workers 2 --batch-mem 4 kspaces.ra $(TESTS_OUT)/coils.ra reco2.ra	;\
+	$(TOOLDIR)/nrmse -t 0.00001 reco1.ra reco2.ra					;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+
 tests/test-pics-tedim: phantom fmac fft pics nrmse
 	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)					;\
 	$(TOOLDIR)/phantom -s4 -m coils.ra						;\
@@ -500,11 +585,12 @@ tests/test-pics-noncart-lowmem-stack2: traj slice phantom conj join fft flip pic
 	touch $@
 
 
-TESTS += tests/test-pics-pi tests/test-pics-noncart tests/test-pics-cs tests/test-pics-pics
-TESTS += tests/test-pics-poisson-wavl1 tests/test-pics-joint-wavl1 tests/test-pics-bpwavl1
+TESTS += tests/test-pics-pi tests/test-pics-noncart tests/test-pics-cs tests/test-pics-pics tests/test-pics-mixed-precision
+TESTS += tests/test-pics-cg-pipelined
+TESTS += tests/test-pics-poisson-wavl1 tests/test-pics-joint-wavl1 tests/test-pics-wavl1-tiled tests/test-pics-bpwavl1
 TESTS += tests/test-pics-weights tests/test-pics-noncart-weights
-TESTS += tests/test-pics-warmstart tests/test-pics-batch
-TESTS += tests/test-pics-tedim tests/test-pics-bp-noncart
+TESTS += tests/test-pics-warmstart tests/test-pics-batch tests/test-pics-batch-stream tests/test-pics-batch-workers
+TESTS += tests/test-pics-tedim tests/test-pics-bp-noncart tests/test-pics-llr-rsvd
 TESTS += tests/test-pics-basis tests/test-pics-basis-noncart tests/test-pics-basis-noncart-memory tests/test-pics-basis-noncart2
 #TESTS += tests/test-pics-lowmem
 TESTS += tests/test-pics-noncart-sms tests/test-pics-psf tests/test-pics-tgv tests/test-pics-tgv2
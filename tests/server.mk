@@ -0,0 +1,23 @@
+# commands executed by a server process, passing data in memory
+tests/test-server: bart phantom fft rss nrmse
+	set -e; mkdir $(TESTS_TMP) ; cd $(TESTS_TMP)						;\
+	$(TOOLDIR)/phantom -s4 -k k.ra								;\
+	$(TOOLDIR)/fft -i 3 k.ra x.ra								;\
+	$(TOOLDIR)/rss 8 x.ra r1.ra								;\
+	$(TOOLDIR)/bart --server bart.sock & pid=$$!						;\
+	trap "kill $$pid 2> /dev/null || true" EXIT						;\
+	$(TOOLDIR)/bart --client bart.sock fft -i 3 k.ra x.mem					;\
+	$(TOOLDIR)/bart --client bart.sock rss 8 x.mem r2.ra					;\
+	$(TOOLDIR)/bart --client bart.sock fft -i 3 k.ra x.mem					;\
+	$(TOOLDIR)/bart --client bart.sock rss 8 x.mem r3.ra					;\
+	$(TOOLDIR)/bart --client bart.sock --stats						;\
+	$(TOOLDIR)/bart --client bart.sock --quit						;\
+	wait $$pid										;\
+	$(TOOLDIR)/nrmse -t 0. r1.ra r2.ra							;\
+	$(TOOLDIR)/nrmse -t 0. r1.ra r3.ra							;\
+	rm *.ra ; cd .. ; rmdir $(TESTS_TMP)
+	touch $@
+
+
+TESTS += tests/test-server
+
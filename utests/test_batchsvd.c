@@ -11,6 +11,8 @@
 #include "lowrank/batchsvd.h"
 
 #include "num/flpmath.h"
+#include "num/multind.h"
+#include "num/rand.h"
 
 #include "misc/debug.h"
 #include "misc/misc.h"
@@ -75,3 +77,72 @@ static bool test_batch_svthresh_wide(void)
 UT_REGISTER_TEST(test_batch_svthresh_tall);
 UT_REGISTER_TEST(test_batch_svthresh_wide);
 
+
+static bool test_batch_svthresh_rand(void)
+{
+	enum { B = 4, M = 40, N = 30, R = 3 };
+
+	num_rand_init(123);
+
+	// rank-3 matrices plus noise
+
+	long udims[3] = { M, R, B };
+	long vdims[3] = { R, N, B };
+	long dims[3] = { M, N, B };
+
+	complex float* u = md_alloc(3, udims, CFL_SIZE);
+	complex float* v = md_alloc(3, vdims, CFL_SIZE);
+	complex float* a = md_alloc(3, dims, CFL_SIZE);
+	complex float* ref = md_alloc(3, dims, CFL_SIZE);
+	complex float* out = md_alloc(3, dims, CFL_SIZE);
+
+	md_gaussian_rand(3, udims, u);
+	md_gaussian_rand(3, vdims, v);
+	md_gaussian_rand(3, dims, a);
+	md_zsmul(3, dims, a, a, 0.001);
+
+	for (int b = 0; b < B; b++)
+		for (int j = 0; j < N; j++)
+			for (int r = 0; r < R; r++)
+				for (int i = 0; i < M; i++)
+					a[(b * N + j) * M + i] += u[(b * R + r) * M + i] * v[(b * N + j) * R + r];
+
+	md_copy(3, dims, ref, a, CFL_SIZE);
+	batch_svthresh(M, N, B, 1., *(complex float (*)[B][N][M])ref);
+
+	// start with a too small subspace
+
+	struct batch_svd_conf_s conf = batch_svd_conf_defaults;
+	conf.rank = 1;
+	conf.oversampling = 1;
+	conf.warmstart = true;
+
+	long rank[B] = { 0 };
+	complex float basis[B][N][N];
+
+	md_copy(3, dims, out, a, CFL_SIZE);
+	batch_svthresh_rand(&conf, M, N, B, 1., *(complex float (*)[B][N][M])out, rank, basis);
+
+	bool ok = (md_znrmse(3, dims, ref, out) < 1.E-4);
+
+	for (int b = 0; b < B; b++)
+		ok = ok && (R == rank[b]);
+
+	// warm start
+
+	md_copy(3, dims, out, a, CFL_SIZE);
+	batch_svthresh_rand(&conf, M, N, B, 1., *(complex float (*)[B][N][M])out, rank, basis);
+
+	ok = ok && (md_znrmse(3, dims, ref, out) < 1.E-4);
+
+	md_free(u);
+	md_free(v);
+	md_free(a);
+	md_free(ref);
+	md_free(out);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_batch_svthresh_rand);
+
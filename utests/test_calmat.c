@@ -0,0 +1,72 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ */
+
+#include <complex.h>
+#include <math.h>
+
+#include "calib/calmat.h"
+
+#include "num/flpmath.h"
+#include "num/multind.h"
+#include "num/linalg.h"
+#include "num/rand.h"
+
+#include "misc/misc.h"
+
+#include "utest.h"
+
+
+static bool test_covariance_blocked(void)
+{
+	enum { N = 3 * 3 * 2 * 4 };
+
+	const long kdims[3] = { 3, 3, 2 };
+	const long calreg_dims[4] = { 8, 7, 5, 4 };
+
+	num_rand_init(0);
+
+	complex float* data = md_alloc(4, calreg_dims, CFL_SIZE);
+	md_gaussian_rand(4, calreg_dims, data);
+
+	long calmat_dims[2];
+	complex float* cm = calibration_matrix(calmat_dims, kdims, calreg_dims, data);
+
+	complex float ref[N][N];
+	gram_matrix(N, ref, calmat_dims[0], MD_CAST_ARRAY2(const complex float, 2, calmat_dims, cm, 0, 1));
+
+	md_free(cm);
+
+	bool ok = true;
+
+	// one slab for all, one slab per patch position and in between
+
+	long blocks[3] = { 1 << 22, 1, 2 * 6 * 5 * N };
+
+	for (int b = 0; b < 3; b++) {
+
+		complex float cov[N][N];
+		covariance_function2(kdims, N, cov, calreg_dims, data, blocks[b]);
+
+		float err = 0.;
+
+		for (int i = 0; i < N; i++)
+			for (int j = 0; j < N; j++)
+				err += powf(cabsf(cov[i][j] - ref[i][j]), 2.);
+
+		float nrm = 0.;
+
+		for (int i = 0; i < N; i++)
+			for (int j = 0; j < N; j++)
+				nrm += powf(cabsf(ref[i][j]), 2.);
+
+		ok &= (sqrtf(err / nrm) < 1.E-6);
+	}
+
+	md_free(data);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_covariance_blocked);
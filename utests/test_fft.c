@@ -6,11 +6,13 @@
  */
 
 #include <complex.h>
+#include <math.h>
 
 #include "misc/debug.h"
 #include "num/multind.h"
 #include "num/flpmath.h"
 #include "num/fft.h"
+#include "num/fft-batch.h"
 #include "num/rand.h"
 
 #include "utest.h"
@@ -48,6 +50,116 @@ static bool test_ifftmod3(void) { return test_fftmod_optimize(4, MD_DIMS(16, 17,
 
 
 
+static bool test_fft_pruned_strs(bool inplace)
+{
+	enum { N = 4 };
+	long dims[N] = { 16, 12, 10, 3 };
+	long idims[N] = { 6, 12, 4, 3 };
+	long ipos[N] = { 5, 0, 3, 0 };
+	long odims[N] = { 16, 5, 7, 3 };
+	long opos[N] = { 0, 4, 2, 0 };
+
+	complex float* in = md_alloc(N, dims, CFL_SIZE);
+	complex float* ref = md_alloc(N, dims, CFL_SIZE);
+	complex float* out = md_alloc(N, dims, CFL_SIZE);
+
+	complex float* tmp = md_alloc(N, idims, CFL_SIZE);
+	md_gaussian_rand(N, idims, tmp);
+
+	md_clear(N, dims, in, CFL_SIZE);
+	md_copy_block(N, ipos, dims, in, idims, tmp, CFL_SIZE);
+	md_free(tmp);
+
+	fft(N, dims, 7, ref, in);
+
+	if (inplace) {
+
+		md_copy(N, dims, out, in, CFL_SIZE);
+		fft_pruned(N, dims, 7, ipos, idims, opos, odims, out, out);
+
+	} else {
+
+		fft_pruned(N, dims, 7, ipos, idims, opos, odims, out, in);
+	}
+
+	complex float* ref1 = md_alloc(N, odims, CFL_SIZE);
+	complex float* out1 = md_alloc(N, odims, CFL_SIZE);
+
+	md_copy_block(N, opos, odims, ref1, dims, ref, CFL_SIZE);
+	md_copy_block(N, opos, odims, out1, dims, out, CFL_SIZE);
+
+	float err = md_znrmse(N, odims, ref1, out1);
+
+	md_free(in);
+	md_free(ref);
+	md_free(out);
+	md_free(ref1);
+	md_free(out1);
+
+	UT_ASSERT(err < UT_TOL);
+}
+
+static bool test_fft_pruned(void) { return test_fft_pruned_strs(false); }
+static bool test_fft_pruned_inplace(void) { return test_fft_pruned_strs(true); }
+
+
+static bool test_fft_batch_strs(bool backwards)
+{
+	enum { N = 4 };
+	long dims[N] = { 8, 3, 4, 5 };
+	long tdims[N] = { 5, 4, 3, 8 };
+
+	complex float* in = md_alloc(N, dims, CFL_SIZE);
+	complex float* out = md_alloc(N, tdims, CFL_SIZE);
+	complex float* ref = md_alloc(N, dims, CFL_SIZE);
+
+	md_gaussian_rand(N, dims, in);
+
+	// output is transposed
+
+	long istrs[N];
+	long tstrs[N];
+	md_calc_strides(N, istrs, dims, CFL_SIZE);
+	md_calc_strides(N, tstrs, tdims, CFL_SIZE);
+
+	long ostrs[N] = { tstrs[3], tstrs[2], tstrs[1], tstrs[0] };
+
+	fft_batch2(N, dims, MD_BIT(0) | MD_BIT(2), ostrs, out, istrs, in, backwards);
+
+	double sign = backwards ? 1. : -1.;
+
+	for (long b3 = 0; b3 < dims[3]; b3++)
+	for (long b1 = 0; b1 < dims[1]; b1++)
+	for (long k0 = 0; k0 < dims[0]; k0++)
+	for (long k2 = 0; k2 < dims[2]; k2++) {
+
+		complex double sum = 0.;
+
+		for (long j0 = 0; j0 < dims[0]; j0++)
+			for (long j2 = 0; j2 < dims[2]; j2++)
+				sum += in[((b3 * dims[2] + j2) * dims[1] + b1) * dims[0] + j0]
+					* cexp(sign * 2.i * M_PI * ((double)(j0 * k0) / dims[0] + (double)(j2 * k2) / dims[2]));
+
+		ref[((b3 * dims[2] + k2) * dims[1] + b1) * dims[0] + k0] = sum;
+	}
+
+	complex float* out2 = md_alloc(N, dims, CFL_SIZE);
+	md_copy2(N, dims, istrs, out2, ostrs, out, CFL_SIZE);
+
+	float err = md_znrmse(N, dims, ref, out2);
+
+	md_free(in);
+	md_free(out);
+	md_free(out2);
+	md_free(ref);
+
+	UT_ASSERT(err < UT_TOL);
+}
+
+static bool test_fft_batch(void) { return test_fft_batch_strs(false); }
+static bool test_ifft_batch(void) { return test_fft_batch_strs(true); }
+
+
 
 UT_REGISTER_TEST(test_fftmod1);
 UT_REGISTER_TEST(test_fftmod2);
@@ -57,3 +169,8 @@ UT_REGISTER_TEST(test_ifftmod1);
 UT_REGISTER_TEST(test_ifftmod2);
 UT_REGISTER_TEST(test_ifftmod3);
 
+UT_REGISTER_TEST(test_fft_pruned);
+UT_REGISTER_TEST(test_fft_pruned_inplace);
+
+UT_REGISTER_TEST(test_fft_batch);
+UT_REGISTER_TEST(test_ifft_batch);
@@ -7,17 +7,21 @@
  */
 
 #include <complex.h>
+#include <math.h>
 
 #include "num/multind.h"
 #include "num/flpmath.h"
 #include "num/ops_p.h"
 #include "num/ops.h"
+#include "num/rand.h"
+#include "num/vecfuse.h"
 
 #include "misc/misc.h"
 #include "misc/debug.h"
 #include "misc/types.h"
 
 #include "iter/italgos.h"
+#include "iter/vec.h"
 #include "iter/iter3.h"
 #include "iter/iter4.h"
 #include "iter/lsqr.h"
@@ -345,3 +349,236 @@ static bool test_iter_lsqr_warmstart(void)
 }
 
 UT_REGISTER_TEST(test_iter_lsqr_warmstart);
+
+
+
+static bool test_iter_vec_fuse(void)
+{
+	enum { N = 5001 };	// not a multiple of the block size
+	long dims[1] = { 3 * N };
+
+	float* a = md_alloc(1, dims, FL_SIZE);
+	float* b = md_alloc(1, dims, FL_SIZE);
+
+	md_gaussian_rand(1, MD_DIMS(3 * N / 2), (complex float*)a);
+	md_copy(1, dims, b, a, FL_SIZE);
+
+	const struct vec_iter_s* vops = &cpu_iter_ops;
+
+	float* x1 = a;
+	float* y1 = a + N;
+	float* z1 = a + 2 * N;
+	float* x2 = b;
+	float* y2 = b + N;
+	float* z2 = b + 2 * N;
+
+	// sequential
+
+	vops->axpy(N, x1, 0.3, y1);
+	vops->xpay(N, -1.2, y1, z1);
+	double d1 = vops->dot(N, x1, y1);
+	vops->swap(N, x1, z1);
+	vops->smul(N, 2., y1, x1);
+	vops->sub(N, z1, x1, y1);
+	vops->add(N, x1, x1, z1);
+	double n1 = vops->dot(N, z1, z1);
+
+	// fused
+
+	double d2, n2;
+
+	struct vec_fuse_s f;
+	vec_fuse_init(&f, N);
+
+	vec_fuse_axpy(&f, x2, 0.3, y2);
+	vec_fuse_xpay(&f, -1.2, y2, z2);
+	vec_fuse_dot(&f, &d2, x2, y2);
+	vec_fuse_swap(&f, x2, z2);
+	vec_fuse_smul(&f, 2., y2, x2);
+	vec_fuse_sub(&f, z2, x2, y2);
+	vec_fuse_add(&f, x2, x2, z2);
+	vec_fuse_dot(&f, &n2, z2, z2);
+
+	vec_fuse_exec(vops, &f);
+
+	bool ok = (d1 == d2) && (n1 == n2) && (0 == memcmp(a, b, 3 * N * FL_SIZE));
+
+	md_free(a);
+	md_free(b);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_iter_vec_fuse);
+
+
+
+static bool test_iter_vec_storage(void)
+{
+	enum { N = 5001 };
+
+	float* a = md_alloc(1, MD_DIMS(N + 1), FL_SIZE);
+	float* b = md_alloc(1, MD_DIMS(N + 1), FL_SIZE);
+	float* h = md_alloc(1, MD_DIMS(N + 1), FL_SIZE);
+
+	md_gaussian_rand(1, MD_DIMS((N + 1) / 2), (complex float*)a);
+
+	// exactly representable
+
+	a[0] = 1.;
+	a[1] = -0.5;
+	a[2] = 0.;
+	a[3] = 96.;
+
+	const struct vec_iter_s* vops = &cpu_iter_ops;
+
+	bool ok = true;
+
+	enum vec_storage st[2] = { VEC_BF16, VEC_FP16 };
+	float tol[2] = { 0x1p-8, 0x1p-11 };	// half an ulp
+
+	// large values (out of range for half precision) with scale
+
+	float scale[2] = { 1., 0x1p20 };
+
+	for (int c = 0; c < 2; c++) {
+
+		if (1 == c)
+			for (long i = 0; i < N; i++)
+				a[i] *= scale[c];
+
+		for (int s = 0; s < 2; s++) {
+
+			struct vec_fuse_s f;
+			vec_fuse_init(&f, N);
+			vec_fuse_storage(&f, h, st[s], scale[c]);
+
+			vec_fuse_copy(&f, h, a);
+			vec_fuse_exec(vops, &f);
+
+			vec_fuse_init(&f, N);
+			vec_fuse_storage(&f, h, st[s], scale[c]);
+
+			vec_fuse_copy(&f, b, h);
+			vec_fuse_exec(vops, &f);
+
+			ok &= (a[0] == b[0]) && (a[1] == b[1]) && (a[2] == b[2]) && (a[3] == b[3]);
+
+			for (long i = 0; i < N; i++)
+				ok &= (fabsf(a[i] - b[i]) <= tol[s] * fabsf(a[i]) + 1.E-7 * scale[c]);
+		}
+	}
+
+	md_free(a);
+	md_free(b);
+	md_free(h);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_iter_vec_storage);
+
+
+
+enum { CG_N = 4000 };
+
+static void cg_tridiag(iter_op_data* data, float* dst, const float* src)
+{
+	UNUSED(data);
+
+	for (long i = 0; i < CG_N; i++)
+		dst[i] = 2.2 * src[i] - ((0 < i) ? src[i - 1] : 0.) - ((i < CG_N - 1) ? src[i + 1] : 0.);
+}
+
+static bool test_iter_conjgrad_storage(void)
+{
+	float* b = md_alloc(1, MD_DIMS(CG_N), FL_SIZE);
+	float* x[3];
+
+	md_gaussian_rand(1, MD_DIMS(CG_N / 2), (complex float*)b);
+
+	enum vec_storage st[3] = { VEC_FP32, VEC_BF16, VEC_FP16 };
+	float res[3];
+
+	for (int s = 0; s < 3; s++) {
+
+		x[s] = md_alloc(1, MD_DIMS(CG_N), FL_SIZE);
+		md_clear(1, MD_DIMS(CG_N), x[s], FL_SIZE);
+
+		res[s] = conjgrad2(40, 0., 0., CG_N, &cpu_iter_ops, st[s],
+				(struct iter_op_s){ cg_tridiag, NULL }, x[s], b, NULL);
+	}
+
+	float bn = md_norm(1, MD_DIMS(CG_N), b);
+
+	// convergence of the recursively updated residual
+
+	bool ok = true;
+
+	for (int s = 0; s < 3; s++)
+		ok &= (res[s] < 1.E-5 * bn);
+
+	// agreement with single precision up to the storage precision
+
+	float err1 = md_nrmse(1, MD_DIMS(CG_N), x[0], x[1]);
+	float err2 = md_nrmse(1, MD_DIMS(CG_N), x[0], x[2]);
+
+	debug_printf(DP_DEBUG1, "CG storage: %e %e %e / %e %e\n", res[0] / bn, res[1] / bn, res[2] / bn, err1, err2);
+
+	ok &= (err1 < 1.E-2) && (err2 < 2.E-3);
+
+	for (int s = 0; s < 3; s++)
+		md_free(x[s]);
+
+	md_free(b);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_iter_conjgrad_storage);
+
+
+
+static bool test_iter_conjgrad_pipelined(void)
+{
+	float* b = md_alloc(1, MD_DIMS(CG_N), FL_SIZE);
+	float* x0 = md_alloc(1, MD_DIMS(CG_N), FL_SIZE);
+	float* x1 = md_alloc(1, MD_DIMS(CG_N), FL_SIZE);
+	float* r = md_alloc(1, MD_DIMS(CG_N), FL_SIZE);
+
+	md_gaussian_rand(1, MD_DIMS(CG_N / 2), (complex float*)b);
+	md_gaussian_rand(1, MD_DIMS(CG_N / 2), (complex float*)x0);
+	md_copy(1, MD_DIMS(CG_N), x1, x0, FL_SIZE);
+
+	float lambda = 0.1;
+
+	float res0 = conjgrad(40, lambda, 0., CG_N, &cpu_iter_ops,
+			(struct iter_op_s){ cg_tridiag, NULL }, x0, b, NULL);
+
+	float res1 = conjgrad_pipelined(40, lambda, 0., CG_N, &cpu_iter_ops,
+			(struct iter_op_s){ cg_tridiag, NULL }, x1, b, NULL);
+
+	// true residual of the pipelined solution
+
+	cg_tridiag(NULL, r, x1);
+
+	for (long i = 0; i < CG_N; i++)
+		r[i] += lambda * x1[i] - b[i];
+
+	float bn = md_norm(1, MD_DIMS(CG_N), b);
+	float rn = md_norm(1, MD_DIMS(CG_N), r);
+	float err = md_nrmse(1, MD_DIMS(CG_N), x0, x1);
+
+	debug_printf(DP_DEBUG1, "CG pipelined: %e %e %e / %e\n", res0 / bn, res1 / bn, rn / bn, err);
+
+	bool ok = (res1 < 1.E-5 * bn) && (rn < 1.E-4 * bn) && (err < 1.E-4);
+
+	md_free(b);
+	md_free(x0);
+	md_free(x1);
+	md_free(r);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_iter_conjgrad_pipelined);
@@ -9,6 +9,9 @@
 #include <math.h>
 
 #include "num/linalg.h"
+#include "num/lapack.h"
+#include "num/rand.h"
+#include "num/eig-batch.h"
 
 #include "utest.h"
 
@@ -72,3 +75,66 @@ static bool test_thomas_algorithm(void)
 
 UT_REGISTER_TEST(test_thomas_algorithm);
 
+
+
+
+static bool test_batch_eig(void)
+{
+	enum { B = 20, N = 7 };
+
+	num_rand_init(123);
+
+	complex float A[B][N][N];
+
+	for (int b = 0; b < B; b++) {
+
+		complex float X[N][N];
+		mat_gaussian(N, N, X);
+		gram_matrix(N, A[b], N, X);
+	}
+
+	complex float vec[B][N][N];
+	float val[B][N];
+
+	for (int b = 0; b < B; b++)
+		mat_copy(N, N, vec[b], A[b]);
+
+	batch_eig(N, B, val, vec);
+
+	bool ok = true;
+
+	for (int b = 0; b < B; b++) {
+
+		complex float ref[N][N];
+		float rval[N];
+
+		mat_copy(N, N, ref, A[b]);
+		lapack_eig(N, rval, ref);
+
+		for (int k = 0; k < N; k++) {
+
+			ok &= (fabsf(val[b][k] - rval[k]) < 1.E-4 * fabsf(rval[N - 1]));
+
+			// residual || A z - val z ||, A is stored column-major
+
+			float res = 0.;
+
+			for (int i = 0; i < N; i++) {
+
+				complex float y = -val[b][k] * vec[b][k][i];
+
+				for (int j = 0; j < N; j++)
+					y += A[b][j][i] * vec[b][k][j];
+
+				res += powf(cabsf(y), 2.);
+			}
+
+			ok &= (sqrtf(res) < 1.E-4 * fabsf(rval[N - 1]));
+			ok &= (fabsf(crealf(vec_dot(N, vec[b][k], vec[b][k])) - 1.f) < 1.E-5);
+		}
+	}
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_batch_eig);
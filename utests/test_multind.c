@@ -4,6 +4,8 @@
 #include "num/multind.h"
 #include "num/rand.h"
 #include "num/flpmath.h"
+#include "num/mem.h"
+#include "num/numa.h"
 
 
 #include "utest.h"
@@ -194,3 +196,122 @@ static bool test_compress(void)
 
 UT_REGISTER_TEST(test_compress);
 
+
+
+static bool test_md_alloc_cache(void)
+{
+	enum { N = 3 };
+	long dims[N] = { 64, 64, 8 };
+
+	bool ok = true;
+
+	complex float* a = md_alloc(N, dims, sizeof(complex float));
+
+	md_gaussian_rand(N, dims, a);
+
+	complex float* b = md_alloc(N, dims, sizeof(complex float));
+
+	md_copy(N, dims, b, a, sizeof(complex float));
+
+	md_free(a);
+
+	// freed block is reused for the same size
+
+	complex float* c = md_alloc(N, dims, sizeof(complex float));
+
+	ok &= (c == a);
+
+	md_copy(N, dims, c, b, sizeof(complex float));
+
+	ok &= md_compare(N, dims, b, c, sizeof(complex float));
+
+	md_free(b);
+	md_free(c);
+
+	// small allocations are not cached
+
+	complex float* d = md_alloc(1, dims, sizeof(complex float));
+
+	ok &= !mem_cpu_free(d);
+
+	md_free(d);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_md_alloc_cache);
+
+
+
+static bool test_numa_range(void)
+{
+	for (int T = 1; T <= 8; T++) {
+
+		for (long N = 0; N <= 20; N++) {
+
+			long end = 0;
+
+			for (int t = 0; t < T; t++) {
+
+				long range[2];
+				numa_range(t, T, N, range);
+
+				// contiguous and complete
+
+				if ((range[0] != end) || (range[1] < range[0]))
+					return false;
+
+				end = range[1];
+
+				// item i belongs to the thread which touched it first
+
+				for (long i = range[0]; i < range[1]; i++)
+					if ((N < T) && (t != (i * T) / N))
+						return false;
+			}
+
+			if (N != end)
+				return false;
+		}
+	}
+
+	return true;
+}
+
+UT_REGISTER_TEST(test_numa_range);
+
+
+
+static bool test_md_parallel_numa(void)
+{
+	enum { N = 3 };
+	long dims[N] = { 64, 64, 8 };
+
+	complex float* a = md_alloc(N, dims, sizeof(complex float));
+	complex float* b = md_alloc(N, dims, sizeof(complex float));
+	complex float* c = md_alloc(N, dims, sizeof(complex float));
+
+	md_gaussian_rand(N, dims, a);
+
+	bool old = numa_policy;
+
+	numa_policy = false;
+	md_clear(N, dims, b, sizeof(complex float));
+	md_zaxpy(N, dims, b, 2., a);
+
+	numa_policy = true;
+	md_clear(N, dims, c, sizeof(complex float));
+	md_zaxpy(N, dims, c, 2., a);
+
+	numa_policy = old;
+
+	bool ok = md_compare(N, dims, b, c, sizeof(complex float));
+
+	md_free(a);
+	md_free(b);
+	md_free(c);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_md_parallel_numa);
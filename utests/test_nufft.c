@@ -8,6 +8,7 @@
 
 #include <complex.h>
 #include <assert.h>
+#include <stdlib.h>
 
 #include "num/multind.h"
 #include "num/flpmath.h"
@@ -249,6 +250,259 @@ static bool test_nufft_basis_toeplitz(void)
 
 
 
+static bool test_nufft_binning(bool decomp, bool periodic)
+{
+	enum { S = 300 };
+	long ksp3_dims[N] = { 1, S, 1, 2, 1, 1, 1, 1 };
+	long cim3_dims[N] = { 40, 24, 1, 2, 1, 1, 1, 1 };
+	long trj3_dims[N] = { 3, S, 1, 1, 1, 1, 1, 1 };
+
+	complex float* traj3 = md_alloc(N, trj3_dims, CFL_SIZE);
+
+	md_uniform_rand(N, trj3_dims, traj3);
+
+	for (int i = 0; i < S; i++) {
+
+		// some samples beyond the edge of the grid
+		traj3[3 * i + 0] = 44. * (crealf(traj3[3 * i + 0]) - 0.5);
+		traj3[3 * i + 1] = 26. * (crealf(traj3[3 * i + 1]) - 0.5);
+		traj3[3 * i + 2] = 0.;
+	}
+
+	complex float* ksp = md_alloc(N, ksp3_dims, CFL_SIZE);
+	complex float* img1 = md_alloc(N, cim3_dims, CFL_SIZE);
+	complex float* img2 = md_alloc(N, cim3_dims, CFL_SIZE);
+
+	md_gaussian_rand(N, ksp3_dims, ksp);
+
+	struct nufft_conf_s conf = nufft_conf_defaults;
+	conf.toeplitz = false;
+	conf.decomp = decomp;
+	conf.periodic = periodic;
+
+	struct linop_s* op1 = nufft_create(N, ksp3_dims, cim3_dims, trj3_dims, traj3, NULL, conf);
+	linop_adjoint(op1, N, cim3_dims, img1, N, ksp3_dims, ksp);
+	linop_free(op1);
+
+	conf.binning = true;
+
+	struct linop_s* op2 = nufft_create(N, ksp3_dims, cim3_dims, trj3_dims, traj3, NULL, conf);
+	linop_adjoint(op2, N, cim3_dims, img2, N, ksp3_dims, ksp);
+
+	float diff = linop_test_adjoint(op2);
+
+	linop_free(op2);
+
+	float err = md_znrmse(N, cim3_dims, img1, img2);
+
+	debug_printf(DP_DEBUG1, "binning nrmse: %e, adjoint diff: %e\n", err, diff);
+
+	md_free(traj3);
+	md_free(ksp);
+	md_free(img1);
+	md_free(img2);
+
+	return (err < 1.E-5) && (diff < 1.E-5);
+}
+
+
+static bool test_nufft_binning_decomp(void)
+{
+	return test_nufft_binning(true, false);
+}
+
+static bool test_nufft_binning_over(void)
+{
+	return test_nufft_binning(false, false);
+}
+
+static bool test_nufft_binning_periodic(void)
+{
+	return test_nufft_binning(true, true);
+}
+
+
+static bool test_nufft_interp_matrix(bool decomp, bool periodic)
+{
+	enum { S = 300 };
+	long ksp3_dims[N] = { 1, S, 1, 2, 1, 1, 1, 1 };
+	long cim3_dims[N] = { 40, 24, 1, 2, 1, 1, 1, 1 };
+	long trj3_dims[N] = { 3, S, 1, 1, 1, 1, 1, 1 };
+
+	complex float* traj3 = md_alloc(N, trj3_dims, CFL_SIZE);
+
+	md_uniform_rand(N, trj3_dims, traj3);
+
+	for (int i = 0; i < S; i++) {
+
+		traj3[3 * i + 0] = 44. * (crealf(traj3[3 * i + 0]) - 0.5);
+		traj3[3 * i + 1] = 26. * (crealf(traj3[3 * i + 1]) - 0.5);
+		traj3[3 * i + 2] = 0.;
+	}
+
+	complex float* ksp = md_alloc(N, ksp3_dims, CFL_SIZE);
+	complex float* ksp1 = md_alloc(N, ksp3_dims, CFL_SIZE);
+	complex float* ksp2 = md_alloc(N, ksp3_dims, CFL_SIZE);
+	complex float* img = md_alloc(N, cim3_dims, CFL_SIZE);
+	complex float* img1 = md_alloc(N, cim3_dims, CFL_SIZE);
+	complex float* img2 = md_alloc(N, cim3_dims, CFL_SIZE);
+
+	md_gaussian_rand(N, ksp3_dims, ksp);
+	md_gaussian_rand(N, cim3_dims, img);
+
+	struct nufft_conf_s conf = nufft_conf_defaults;
+	conf.toeplitz = false;
+	conf.decomp = decomp;
+	conf.periodic = periodic;
+
+	struct linop_s* op1 = nufft_create(N, ksp3_dims, cim3_dims, trj3_dims, traj3, NULL, conf);
+	linop_forward(op1, N, ksp3_dims, ksp1, N, cim3_dims, img);
+	linop_adjoint(op1, N, cim3_dims, img1, N, ksp3_dims, ksp);
+	linop_free(op1);
+
+	conf.precomp_interp = true;
+
+	struct linop_s* op2 = nufft_create(N, ksp3_dims, cim3_dims, trj3_dims, traj3, NULL, conf);
+	linop_forward(op2, N, ksp3_dims, ksp2, N, cim3_dims, img);
+	linop_adjoint(op2, N, cim3_dims, img2, N, ksp3_dims, ksp);
+
+	float diff = linop_test_adjoint(op2);
+
+	linop_free(op2);
+
+	float err1 = md_znrmse(N, ksp3_dims, ksp1, ksp2);
+	float err2 = md_znrmse(N, cim3_dims, img1, img2);
+
+	debug_printf(DP_DEBUG1, "interp. matrix nrmse: %e %e, adjoint diff: %e\n", err1, err2, diff);
+
+	md_free(traj3);
+	md_free(ksp);
+	md_free(ksp1);
+	md_free(ksp2);
+	md_free(img);
+	md_free(img1);
+	md_free(img2);
+
+	return (err1 < 1.E-5) && (err2 < 1.E-5) && (diff < 1.E-5);
+}
+
+
+static bool test_nufft_interp_matrix_decomp(void)
+{
+	return test_nufft_interp_matrix(true, false);
+}
+
+static bool test_nufft_interp_matrix_over(void)
+{
+	return test_nufft_interp_matrix(false, false);
+}
+
+static bool test_nufft_interp_matrix_periodic(void)
+{
+	return test_nufft_interp_matrix(true, true);
+}
+
+
+static bool test_nufft_toeplitz_blocks(bool lowmem)
+{
+	long ksp4_dims[N] = { 1, 5, 1, 4, 1, 1, 1, 1 };
+	long cim4_dims[N] = { 8, 8, 1, 4, 1, 1, 1, 1 };
+
+	complex float* src = md_alloc(N, cim4_dims, CFL_SIZE);
+	complex float* dst1 = md_alloc(N, cim4_dims, CFL_SIZE);
+	complex float* dst2 = md_alloc(N, cim4_dims, CFL_SIZE);
+
+	md_gaussian_rand(N, cim4_dims, src);
+
+	struct nufft_conf_s conf = nufft_conf_defaults;
+	conf.lowmem = lowmem;
+
+	struct linop_s* op1 = nufft_create(N, ksp4_dims, cim4_dims, trj_dims, &traj[0][0], NULL, conf);
+	linop_normal(op1, N, cim4_dims, dst1, src);
+	linop_free(op1);
+
+	// force blocks of two coils
+
+	setenv("BART_TOEPLITZ_BLOCK_SIZE", lowmem ? "128" : "512", 1);
+
+	struct linop_s* op2 = nufft_create(N, ksp4_dims, cim4_dims, trj_dims, &traj[0][0], NULL, conf);
+	linop_normal(op2, N, cim4_dims, dst2, src);
+	linop_free(op2);
+
+	unsetenv("BART_TOEPLITZ_BLOCK_SIZE");
+
+	float err = md_znrmse(N, cim4_dims, dst1, dst2);
+
+	md_free(src);
+	md_free(dst1);
+	md_free(dst2);
+
+	return err < 1.E-6;
+}
+
+static bool test_nufft_toeplitz_blocks_default(void)
+{
+	return test_nufft_toeplitz_blocks(false);
+}
+
+static bool test_nufft_toeplitz_blocks_lowmem(void)
+{
+	return test_nufft_toeplitz_blocks(true);
+}
+
+
+static bool test_nufft_cache(void)
+{
+	complex float* traj2 = md_alloc(N, trj_dims, CFL_SIZE);
+
+	md_copy(N, trj_dims, traj2, &traj[0][0], CFL_SIZE);
+
+	complex float* img = md_alloc(N, cim_dims, CFL_SIZE);
+	complex float* ksp1 = md_alloc(N, ksp_dims, CFL_SIZE);
+	complex float* ksp2 = md_alloc(N, ksp_dims, CFL_SIZE);
+
+	md_gaussian_rand(N, cim_dims, img);
+
+	struct nufft_conf_s conf = nufft_conf_defaults;
+	conf.cache = true;
+
+	struct linop_s* op1 = nufft_create(N, ksp_dims, cim_dims, trj_dims, &traj[0][0], NULL, conf);
+	struct linop_s* op2 = nufft_create(N, ksp_dims, cim_dims, trj_dims, traj2, NULL, conf);
+
+	bool ok = (linop_get_data(op1) == linop_get_data(op2));
+
+	traj2[0] += 0.5;
+
+	struct linop_s* op3 = nufft_create(N, ksp_dims, cim_dims, trj_dims, traj2, NULL, conf);
+
+	ok = ok && (linop_get_data(op1) != linop_get_data(op3));
+
+	conf.cache = false;
+
+	struct linop_s* op4 = nufft_create(N, ksp_dims, cim_dims, trj_dims, &traj[0][0], NULL, conf);
+
+	linop_forward(op2, N, ksp_dims, ksp1, N, cim_dims, img);
+	linop_forward(op4, N, ksp_dims, ksp2, N, cim_dims, img);
+
+	float err = md_znrmse(N, ksp_dims, ksp1, ksp2);
+
+	linop_free(op1);
+	linop_free(op2);
+	linop_free(op3);
+	linop_free(op4);
+
+	nufft_cache_clear();
+
+	md_free(traj2);
+	md_free(img);
+	md_free(ksp1);
+	md_free(ksp2);
+
+	return ok && (0. == err);
+}
+
+
+
 
 
 UT_REGISTER_TEST(test_nufft_forward);
@@ -260,5 +514,12 @@ UT_REGISTER_TEST(test_nufft_toeplitz_forward);
 UT_REGISTER_TEST(test_nufft_basis_adjoint);
 UT_REGISTER_TEST(test_nufft_basis_normal);
 UT_REGISTER_TEST(test_nufft_basis_toeplitz);
-
-
+UT_REGISTER_TEST(test_nufft_binning_decomp);
+UT_REGISTER_TEST(test_nufft_binning_over);
+UT_REGISTER_TEST(test_nufft_binning_periodic);
+UT_REGISTER_TEST(test_nufft_interp_matrix_decomp);
+UT_REGISTER_TEST(test_nufft_interp_matrix_over);
+UT_REGISTER_TEST(test_nufft_interp_matrix_periodic);
+UT_REGISTER_TEST(test_nufft_cache);
+UT_REGISTER_TEST(test_nufft_toeplitz_blocks_default);
+UT_REGISTER_TEST(test_nufft_toeplitz_blocks_lowmem);
@@ -8,9 +8,15 @@
 
 #include <complex.h>
 #include <math.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "num/multind.h"
 #include "num/flpmath.h"
+#include "num/rand.h"
 #include "num/iovec.h"
 #include "num/ops.h"
 
@@ -130,3 +136,154 @@ UT_REGISTER_TEST(test_op_combi_inout);
 
 
 
+
+
+static const struct operator_s* create_double(int N, const long dims[N])
+{
+	const auto a = operator_zadd_create(2, N, dims);
+	return operator_dup_create_F(a, 1, 2);
+}
+
+static const struct operator_s* create_triple(int N, const long dims[N])
+{
+	const auto a = operator_zadd_create(3, N, dims);
+	return operator_dup_create_F(operator_dup_create_F(a, 1, 2), 1, 2);
+}
+
+// out = 5 * in with two independent branches
+
+static const struct operator_s* create_diamond(int N, const long dims[N])
+{
+	const auto d = operator_zadd_create(2, N, dims);
+	const auto b = create_double(N, dims);
+	const auto c = create_triple(N, dims);
+
+	auto op = operator_combi_create(3, (const struct operator_s*[3]){ d, b, c });
+
+	operator_free(d);
+	operator_free(b);
+	operator_free(c);
+
+	op = operator_link_create_F(op, 3, 1);
+	op = operator_link_create_F(op, 3, 1);
+
+	return operator_dup_create_F(op, 1, 2);
+}
+
+static const struct operator_s* create_diamonds(int N, const long dims[N])
+{
+	const auto a = create_diamond(N, dims);
+	const auto b = create_diamond(N, dims);
+
+	const auto c = operator_chain(a, b);
+
+	operator_free(a);
+	operator_free(b);
+
+	return graph_optimize_operator_F(c);
+}
+
+static bool test_op_memory_plan(void)
+{
+	enum { N = 2 };
+	long dims[N] = { 16, 8 };
+
+	complex float* in = md_alloc(N, dims, CFL_SIZE);
+	complex float* out = md_alloc(N, dims, CFL_SIZE);
+	complex float* ref = md_alloc(N, dims, CFL_SIZE);
+
+	md_gaussian_rand(N, dims, in);
+
+	setenv("BART_GRAPH_PLAN", "0", 1);
+
+	const auto a = create_diamonds(N, dims);
+
+	unsetenv("BART_GRAPH_PLAN");
+
+	const auto b = create_diamonds(N, dims);
+
+	operator_apply(a, N, dims, ref, N, dims, in);
+	operator_apply(b, N, dims, out, N, dims, in);
+
+	bool ok = true;
+
+	ok &= (0 == operator_plan_arena_size(a, NULL));
+
+	size_t unplanned;
+	size_t arena = operator_plan_arena_size(b, &unplanned);
+
+	// results of the branches of the second diamond can reuse
+	// the memory of the branches of the first
+
+	ok &= (0 < arena);
+	ok &= (arena < unplanned);
+
+	md_zsmul(N, dims, in, in, 25.);
+
+	ok &= (UT_TOL > md_znrmse(N, dims, ref, out));
+	ok &= (UT_TOL > md_znrmse(N, dims, in, out));
+
+	operator_free(a);
+	operator_free(b);
+
+	md_free(in);
+	md_free(out);
+	md_free(ref);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_op_memory_plan);
+
+
+
+static bool test_op_plan_concurrent(void)
+{
+	enum { N = 2 };
+	long dims[N] = { 64, 32 };
+
+	complex float* in = md_alloc(N, dims, CFL_SIZE);
+	complex float* out = md_alloc(N, dims, CFL_SIZE);
+	complex float* ref = md_alloc(N, dims, CFL_SIZE);
+
+	md_gaussian_rand(N, dims, in);
+
+	const auto a = create_diamonds(N, dims);
+
+	setenv("BART_GRAPH_CONCURRENT", "1", 1);
+
+	const auto b = create_diamonds(N, dims);
+
+	unsetenv("BART_GRAPH_CONCURRENT");
+
+#ifdef _OPENMP
+	int threads = omp_get_max_threads();
+	omp_set_num_threads(4);
+#endif
+	operator_apply(a, N, dims, ref, N, dims, in);
+
+	bool ok = true;
+
+	for (int i = 0; i < 10; i++) {
+
+		md_clear(N, dims, out, CFL_SIZE);
+		operator_apply(b, N, dims, out, N, dims, in);
+
+		ok &= (UT_TOL > md_znrmse(N, dims, ref, out));
+	}
+
+#ifdef _OPENMP
+	omp_set_num_threads(threads);
+#endif
+	operator_free(a);
+	operator_free(b);
+
+	md_free(in);
+	md_free(out);
+	md_free(ref);
+
+	return ok;
+}
+
+UT_REGISTER_TEST(test_op_plan_concurrent);
+
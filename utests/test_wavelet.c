@@ -0,0 +1,91 @@
+/* Copyright 2026. Institute of Biomedical Imaging. TU Graz.
+ * All rights reserved. Use of this source code is governed by
+ * a BSD-style license which can be found in the LICENSE file.
+ */
+
+#include <complex.h>
+
+#include "num/flpmath.h"
+#include "num/multind.h"
+#include "num/rand.h"
+
+#include "misc/misc.h"
+#include "misc/debug.h"
+
+#include "wavelet/wavelet.h"
+
+#include "utest.h"
+
+
+/*
+ * Compare the fused forward transform and thresholding of
+ * wavelet_thresh() with separate forward transform, soft-
+ * thresholding of all coefficients, and inverse transform.
+ */
+static bool test_wavelet_thresh_fused(unsigned int flags, unsigned int jflags, const long shifts[4], long flen, const float filter[2][2][flen])
+{
+	enum { N = 4 };
+	long dims[N] = { 48, 40, 1, 3 };
+	long minsize[N] = { 16, 16, 1, 3 };
+
+	float lambda = 0.3;
+
+	complex float* in = md_alloc(N, dims, CFL_SIZE);
+	complex float* out = md_alloc(N, dims, CFL_SIZE);
+	complex float* ref = md_alloc(N, dims, CFL_SIZE);
+
+	md_gaussian_rand(N, dims, in);
+
+	wavelet_thresh(N, lambda, flags, jflags, shifts, dims, out, in, minsize, flen, filter);
+
+	long wdims[N];
+	wavelet_coeffs2(N, flags, wdims, dims, minsize, flen);
+
+	complex float* tmp = md_alloc(N, wdims, CFL_SIZE);
+
+	fwt(N, flags, shifts, wdims, tmp, dims, in, minsize, flen, filter);
+	md_zsoftthresh(N, wdims, lambda, jflags, tmp, tmp);
+	iwt(N, flags, shifts, dims, ref, wdims, tmp, minsize, flen, filter);
+
+	float err = md_znrmse(N, dims, ref, out);
+
+	debug_printf(DP_DEBUG1, "wavelet thresh fused: %e\n", err);
+
+	md_free(tmp);
+	md_free(in);
+	md_free(out);
+	md_free(ref);
+
+	return (err < UT_TOL);
+}
+
+
+static bool test_wavelet_thresh_haar(void)
+{
+	long shifts[4] = { 0 };
+
+	return test_wavelet_thresh_fused(3u, 0u, shifts, 2, wavelet_haar);
+}
+
+UT_REGISTER_TEST(test_wavelet_thresh_haar);
+
+
+static bool test_wavelet_thresh_dau2_joint(void)
+{
+	long shifts[4] = { 3, 5, 0, 0 };
+
+	return test_wavelet_thresh_fused(3u, 8u, shifts, 4, wavelet_dau2);
+}
+
+UT_REGISTER_TEST(test_wavelet_thresh_dau2_joint);
+
+
+static bool test_wavelet_thresh_cdf44(void)
+{
+	long shifts[4] = { 1, 2, 0, 0 };
+
+	return test_wavelet_thresh_fused(1u, 8u, shifts, 10, wavelet_cdf44);
+}
+
+UT_REGISTER_TEST(test_wavelet_thresh_cdf44);
+